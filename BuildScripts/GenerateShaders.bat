@@ -3,7 +3,7 @@ setlocal
 
 set "folder=..\ShadersGLSL"
 
-rem Compile normal shaders (vert, frag)
+rem Compile the shaders of each folder (vert, frag, geom, comp)
 for /d %%F in ("%folder%\*") do (
     if /i not "%%~F"=="%folder%\Include" (
 		if not exist "..\Data\Engine\Shaders\%%~nxF" (
@@ -12,7 +12,10 @@ for /d %%F in ("%folder%\*") do (
 		
 		echo Compiling %%~nxF
 		
-        glslc "%%F\shader.vert" -o "..\Data\Engine\Shaders\%%~nxF\vert.spv"
+		rem The compute only folders have no vertex stage
+		if exist "%%F\shader.vert" (
+			glslc "%%F\shader.vert" -o "..\Data\Engine\Shaders\%%~nxF\vert.spv"
+		)
 		
 		rem All other stages might not exist so I need to check first
 		if exist "%%F\shader.frag" (
@@ -27,6 +30,10 @@ for /d %%F in ("%folder%\*") do (
 			echo Missing geometry stage, skipping stage!
 		)
 		
+		if exist "%%F\shader.comp" (
+			glslc "%%F\shader.comp" -o "..\Data\Engine\Shaders\%%~nxF\comp.spv"
+		)
+		
 		echo ****************
     )
 )
@@ -4,15 +4,17 @@ layout (location = 0) out vec4 fragColor;
 
 layout (location = 0) in vec2 inUV;
 
-layout (set = 0, binding = 1) uniform sampler2DArray depthMap;
+layout (set = 0, binding = 1) uniform sampler2D depthMap;
 
 layout (set = 1, binding = 0) uniform DebugData {
     float nearPlane;
     float farPlane;
     int layer;
+    // Tile of the layer in the shadow atlas, offset (xy) and scale (zw)
+    vec4 atlasRect;
 } debugData;
 
 void main() {
-    float depthValue = texture(depthMap, vec3(inUV, debugData.layer)).r;
+    float depthValue = texture(depthMap, debugData.atlasRect.xy + inUV * debugData.atlasRect.zw).r;
     fragColor = vec4(vec3(depthValue), 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "../Include/InstanceData.glsl"
+
+// Static meshes, the skinned variant lives in DepthPrePassSkinned. Depth only, the position must be computed
+// exactly like the PBR vertex shader since the color pass tests the depth with EQUAL
+
+// Quantized to the mesh bounds, the model matrix maps them back
+layout (location = 0) in vec4 position;
+
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+} camera;
+
+// Dynamic Buffer
+layout(set = 0, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceData;
+
+// Dynamic Buffer, the same visible instances as the color pass
+layout(set = 0, binding = 2) readonly buffer VisibleInstances {
+    uint ids[];
+} visibleInstances;
+
+void main() {
+    Instance instance = instanceData.instances[visibleInstances.ids[gl_InstanceIndex]];
+
+    gl_Position = camera.projection * camera.view * instance.model * vec4(position.xyz, 1.0);
+}
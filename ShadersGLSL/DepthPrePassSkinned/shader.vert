@@ -0,0 +1,64 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "../Include/InstanceData.glsl"
+
+layout (constant_id = 0) const uint MAX_BONES = 100;
+layout (constant_id = 1) const uint MAX_BONE_INFLUENCE = 4;
+
+// Depth only, the skinning must match the PBRSkinned vertex shader since the color pass tests the depth with EQUAL
+layout (location = 0) in vec4 position;
+layout (location = 1) in uvec4 boneIDS;
+// Unused influences have a weight of 0
+layout (location = 2) in vec4 weights;
+
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+} camera;
+
+// Dynamic Buffer, MAX_BONES matrices per animated entity
+layout(set = 1, binding = 0) readonly buffer Animation {
+    mat4 boneMatrices[];
+}animation;
+
+// Dynamic Buffer
+layout(set = 0, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceData;
+
+// Dynamic Buffer, the same visible instances as the color pass
+layout(set = 0, binding = 2) readonly buffer VisibleInstances {
+    uint ids[];
+} visibleInstances;
+
+void main() {
+    Instance instance = instanceData.instances[visibleInstances.ids[gl_InstanceIndex]];
+    uint paletteOffset = instance.bonePalette * MAX_BONES;
+
+    vec4 skinnedPosition = vec4(0.0);
+
+    if(instance.hasAnimation == 1) {
+        for(int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+            if(weights[i] == 0.0) {
+                continue;
+            }
+            if(boneIDS[i] >= MAX_BONES) {
+                skinnedPosition = vec4(position.xyz, 1.0);
+                break;
+            }
+
+            mat4 boneMatrix = animation.boneMatrices[paletteOffset + boneIDS[i]];
+
+            vec4 localPosition = boneMatrix * vec4(position.xyz, 1.0);
+            skinnedPosition += localPosition * weights[i];
+        }
+    }
+    else {
+        skinnedPosition = vec4(position.xyz, 1.0);
+    }
+
+    gl_Position = camera.projection * camera.view * instance.model * skinnedPosition;
+}
@@ -0,0 +1,18 @@
+// Shader side of Rendering/Queue/InstanceData.h
+
+const uint NO_CULLED_DRAW = 0xFFFFFFFFu;
+
+struct Instance {
+    mat4 model;
+    // Normal matrix, w is unused
+    vec4 normal0;
+    vec4 normal1;
+    vec4 normal2;
+    // Slot of the entity's bones in the animation buffer
+    uint bonePalette;
+    uint hasAnimation;
+    // Culled draw the instance belongs to
+    uint culledDraw;
+    // Shadow pass only, the cascade the instance is rendered in
+    uint cascade;
+};
@@ -0,0 +1,18 @@
+// Decoding side of Utilities/VertexPacking.cpp
+
+vec2 SignNotZero(vec2 value) {
+    return vec2(value.x >= 0.0 ? 1.0 : -1.0, value.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 DecodeOctahedral(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0) {
+        direction.xy = (1.0 - abs(direction.yx)) * SignNotZero(direction.xy);
+    }
+    return normalize(direction);
+}
+
+// The bitangent is rebuilt from the normal and the tangent, only its sign is stored
+vec3 DecodeBitangent(vec3 normal, vec3 tangent, float bitangentSign) {
+    return cross(normal, tangent) * (bitangentSign < 0.0 ? -1.0 : 1.0);
+}
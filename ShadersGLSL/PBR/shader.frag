@@ -1,4 +1,5 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout (constant_id = 0) const uint MAX_LIGHTS = 32;
 layout (constant_id = 1) const uint LIGHT_TYPE_DIRECTIONAL = 1 << 0;
@@ -7,12 +8,27 @@ layout (constant_id = 3) const uint LIGHT_TYPE_SPOT = 1 << 2;
 layout (constant_id = 4) const uint MAX_SM = 16;
 
 layout(location = 0) out vec4 fragColor;
-layout(set = 4, binding = 0) uniform sampler2D albedo;
 
-layout(set = 2, binding = 1) uniform sampler2DArrayShadow shadowMap;
+layout(set = 2, binding = 1) uniform sampler2DShadow shadowMap;
 
 // Material Data
+struct Material {
+    vec4 baseColor;
+    // x => specular strength, y => shininess
+    vec4 factors;
+    // x => albedo, indices in the bindless texture array
+    uvec4 textures;
+};
+
+layout(set = 4, binding = 0) readonly buffer Materials {
+    Material materials[];
+} materialData;
 
+// Every material's textures, the slots without a texture are never read
+layout(set = 4, binding = 1) uniform sampler2D textures[];
+
+// The draw's material, read once at the start of main
+Material material;
 // *************
 
 layout(location = 0) in VertexData {
@@ -24,14 +40,11 @@ layout(location = 0) in VertexData {
 } vertexData;
 
 layout(push_constant, std430) uniform SharedConstants {
-    mat4 model;
-    // The col a contains the position of the view
-    vec4 col0;
-    vec4 col1;
-    vec4 col2;
+    // xyz => position of the view
+    vec4 viewPosition;
     int lightsCount;
     float ambientStrength;
-    uint hasAnimation;
+    uint materialIndex;
 } sharedConstants;
 
 struct Light {
@@ -53,18 +66,30 @@ layout(set = 1, binding = 0) readonly buffer LightData {
     Light lights[MAX_LIGHTS];
 } lightData;
 
+// A cluster's range is packed as (offset << CLUSTER_LIGHT_COUNT_BITS) | count
+const uint CLUSTER_LIGHT_COUNT_BITS = 12;
+
+layout(set = 1, binding = 1) readonly buffer ClusterData {
+    // xyz => cluster grid size, w => directional lights count
+    uvec4 grid;
+    // xy => cluster size in pixels, z => depth slice scale, w => depth slice bias
+    vec4 tileAndSlices;
+    // The range of each cluster, then the directional lights, then the clusters' light indices
+    uint items[];
+} clusterData;
+
 layout (set = 2, binding = 0) readonly uniform LightSM {
     mat4 matrices[MAX_SM];
 } lightSM;
 
 layout (set = 2, binding = 2) uniform ShadowData {
     float cascadePlaneDistance[MAX_SM];    
+    // Offset (xy) and scale (zw) of each cascade's tile in the shadow atlas
+    vec4 cascadeAtlasRects[MAX_SM];
     float farPlane;
     int cascadeCount;
 }shadowData;
 
-const float SPECULAR_STR = 0.5;
-
 const float CONSTANT = 1.0;
 const float LINEAR = 0.09f;
 const float QUADRATIC = 0.032;
@@ -102,12 +127,19 @@ float CalculateShadow(vec3 lightDir, vec3 normal) {
         bias *= 1 / (shadowData.cascadePlaneDistance[cascadeIndex] * biasModifier);
     }
 
-    float shadow = 0.0;
+    vec4 atlasRect = shadowData.cascadeAtlasRects[cascadeIndex];
+    vec2 atlasCoords = atlasRect.xy + coords.xy * atlasRect.zw;
+
+    // The filter stays inside the cascade's tile so it doesn't read the neighbouring tiles
     vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+    vec2 tileMin = atlasRect.xy + texelSize * 0.5;
+    vec2 tileMax = atlasRect.xy + atlasRect.zw - texelSize * 0.5;
+
+    float shadow = 0.0;
     for(int x = -1; x <= 1; ++x) {
         for(int y = -1; y <= 1; ++y) {
             vec2 offset = vec2(x, y) * texelSize;
-            shadow += texture(shadowMap, vec4(coords.xy + offset, cascadeIndex, currentDepth - bias));
+            shadow += texture(shadowMap, vec3(clamp(atlasCoords + offset, tileMin, tileMax), currentDepth - bias));
         }
     }
 
@@ -125,8 +157,8 @@ vec3 CalculateSpecular(vec3 viewPosition, vec3 normal, vec3 dir, vec3 lightColor
     vec3 viewDir = normalize(viewPosition - vertexData.fragPosition);
     vec3 halfwayDir = normalize(dir + viewDir);
     vec3 reflectDir = reflect(dir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 16);
-    return SPECULAR_STR * spec * lightColor;
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.factors.y);
+    return material.factors.x * spec * lightColor;
 }
 
 float CalculateAttenuation(vec3 lightPosition, float range) {
@@ -139,11 +171,10 @@ float CalculateAttenuation(vec3 lightPosition, float range) {
     return 1.0 / (CONSTANT + LINEAR * distance + QUADRATIC * (distance * distance));
 }
 
-vec3 CalculateDirectionalLight(Light light, mat3 normalMatrix, vec3 viewPosition, vec3 objectColor) {
+vec3 CalculateDirectionalLight(Light light, vec3 normal, vec3 viewPosition, vec3 objectColor) {
     vec3 lightColor = light.color.xyz;
     float intensity = light.color.a;
 
-    vec3 normal = normalize(normalMatrix * vertexData.normal);
     vec3 dir = -light.direction.xyz;
 
     vec3 diffuse = CalculateDiffuse(normal, dir, lightColor, intensity);
@@ -154,12 +185,11 @@ vec3 CalculateDirectionalLight(Light light, mat3 normalMatrix, vec3 viewPosition
     return (shadow * (diffuse + specular)) * objectColor;
 }
 
-vec3 CalculatePointLight(Light light, mat3 normalMatrix, vec3 viewPosition, vec3 objectColor) {
+vec3 CalculatePointLight(Light light, vec3 normal, vec3 viewPosition, vec3 objectColor) {
     vec3 lightColor = light.color.xyz;
     float intensity = light.color.a;
     float range = light.params.x;
 
-    vec3 normal = normalize(normalMatrix * vertexData.normal);
     vec3 dir = normalize(light.position.xyz - vertexData.fragPosition);
 
     float attenuation = CalculateAttenuation(light.position.xyz, range);
@@ -170,11 +200,10 @@ vec3 CalculatePointLight(Light light, mat3 normalMatrix, vec3 viewPosition, vec3
     return (diffuse + specular) * objectColor;
 }
 
-vec3 CalculateSpotLight(Light light, mat3 normalMatrix, vec3 viewPosition, vec3 objectColor) {
+vec3 CalculateSpotLight(Light light, vec3 normal, vec3 viewPosition, vec3 objectColor) {
     vec3 lightColor = light.color.xyz;
     float intensity = light.color.a;
 
-    vec3 normal = normalize(normalMatrix * vertexData.normal);
     vec3 dir = normalize(light.position.xyz - vertexData.fragPosition);
 
     float cutOff = light.params.y;
@@ -195,22 +224,41 @@ vec3 CalculateSpotLight(Light light, mat3 normalMatrix, vec3 viewPosition, vec3
 }
 
 void main() {
-    vec4 finalColor = texture(albedo, vertexData.uv);
+    // The material is the same for the whole draw, the texture index is dynamically uniform
+    material = materialData.materials[sharedConstants.materialIndex];
+    vec4 finalColor = texture(textures[material.textures.x], vertexData.uv) * material.baseColor;
     vec3 result = finalColor.xyz * sharedConstants.ambientStrength;
 
-    mat3 normalMatrix = mat3(sharedConstants.col0.xyz, sharedConstants.col1.xyz, sharedConstants.col2.xyz);
-    vec3 viewPosition = vec3(sharedConstants.col0.w, sharedConstants.col1.w, sharedConstants.col2.w);;
+    // The vertex stage already moved the normal to world space
+    vec3 normal = normalize(vertexData.normal);
+    vec3 viewPosition = sharedConstants.viewPosition.xyz;
 
-    for(int i = 0; i < sharedConstants.lightsCount; ++i) {
-        uint lightType = floatBitsToUint(lightData.lights[i].position.w);
-        if((lightType & LIGHT_TYPE_DIRECTIONAL) != 0) {
-            result += CalculateDirectionalLight(lightData.lights[i], normalMatrix, viewPosition, finalColor.xyz);
-        }
-        else if ((lightType & LIGHT_TYPE_POINT) != 0) {
-            result += CalculatePointLight(lightData.lights[i], normalMatrix, viewPosition, finalColor.xyz);
+    uvec3 grid = clusterData.grid.xyz;
+    uint clusterCount = grid.x * grid.y * grid.z;
+
+    // The directional lights reach every cluster, they are stored once after the cluster ranges
+    for(uint i = 0; i < clusterData.grid.w; ++i) {
+        uint lightIndex = clusterData.items[clusterCount + i];
+        result += CalculateDirectionalLight(lightData.lights[lightIndex], normal, viewPosition, finalColor.xyz);
+    }
+
+    float viewDepth = (camera.view * vec4(vertexData.fragPosition, 1.0)).z;
+    int slice = int(floor(log(max(viewDepth, 1e-4)) * clusterData.tileAndSlices.z + clusterData.tileAndSlices.w));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterData.tileAndSlices.xy), grid.xy - 1);
+    uint cluster = tile.x + tile.y * grid.x + uint(clamp(slice, 0, int(grid.z) - 1)) * grid.x * grid.y;
+
+    uint range = clusterData.items[cluster];
+    uint offset = range >> CLUSTER_LIGHT_COUNT_BITS;
+    uint count = range & ((1u << CLUSTER_LIGHT_COUNT_BITS) - 1u);
+
+    for(uint i = 0; i < count; ++i) {
+        Light light = lightData.lights[clusterData.items[offset + i]];
+        uint lightType = floatBitsToUint(light.position.w);
+        if ((lightType & LIGHT_TYPE_POINT) != 0) {
+            result += CalculatePointLight(light, normal, viewPosition, finalColor.xyz);
         }
         else if ((lightType & LIGHT_TYPE_SPOT) != 0) {
-            result += CalculateSpotLight(lightData.lights[i], normalMatrix, viewPosition, finalColor.xyz);
+            result += CalculateSpotLight(light, normal, viewPosition, finalColor.xyz);
         }
     }
 
@@ -1,16 +1,16 @@
 #version 460
+#extension GL_GOOGLE_include_directive : require
 
-layout (constant_id = 0) const uint MAX_BONES = 100;
-layout (constant_id = 1) const uint MAX_BONE_INFLUENCE = 4;
+#include "../Include/InstanceData.glsl"
+#include "../Include/VertexPacking.glsl"
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec3 tangent;
-layout (location = 3) in vec3 bitangent;
-layout (location = 4) in vec2 uv;
+// Static meshes, the skinned variant lives in PBRSkinned
 
-layout (location = 5) in ivec4 boneIDS;
-layout (location = 6) in vec4 weights;
+// xyz quantized to the mesh bounds (the model matrix maps them back), w is the bitangent sign
+layout (location = 0) in vec4 position;
+// Octahedral normal (xy) and tangent (zw)
+layout (location = 1) in vec4 normalTangent;
+layout (location = 2) in vec2 uv;
 
 layout(location = 0) out VertexData {
     vec3 normal;
@@ -20,61 +20,37 @@ layout(location = 0) out VertexData {
     vec2 uv;
 } vertexData;
 
+// The depth pre-pass computes the same position, the depth is tested with EQUAL when it runs
+invariant gl_Position;
+
 layout(set = 0, binding = 0) uniform Camera {
     mat4 projection;
     mat4 view;
 } camera;
 
 // Dynamic Buffer
-layout(set = 3, binding = 0) readonly buffer Animation {
-    mat4 boneMatrices[MAX_BONES];
-}animation;
+layout(set = 0, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceData;
 
-layout(push_constant, std430) uniform SharedConstants {
-    mat4 model;
-    // The col a contains the position of the view
-    vec4 col0;
-    vec4 col1;
-    vec4 col2;
-    int lightsCount;
-    float ambientStrength;
-    uint hasAnimation;
-} sharedConstants;
+// Dynamic Buffer, the draws' firstInstance points to their range. The culling compacts the visible instances in it
+layout(set = 0, binding = 2) readonly buffer VisibleInstances {
+    uint ids[];
+} visibleInstances;
 
 void main() {
-    vec4 skinnedPosition = vec4(0.0);
-    vec3 skinnedNormal = vec3(0.0);
-
-    if(sharedConstants.hasAnimation == 1) {
-        for(int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
-            if(boneIDS[i] == -1) {
-                continue;
-            }
-            if(boneIDS[i] >= MAX_BONES) {
-                skinnedPosition = vec4(position, 1.0);
-                skinnedNormal = normal;
-                break;
-            }
-
-            uint boneID = boneIDS[i];
-            mat4 boneMatrix = animation.boneMatrices[boneID];
-
-            vec4 localPosition = boneMatrix * vec4(position, 1.0);
-            skinnedPosition += localPosition * weights[i];
+    Instance instance = instanceData.instances[visibleInstances.ids[gl_InstanceIndex]];
+    mat3 normalMatrix = mat3(instance.normal0.xyz, instance.normal1.xyz, instance.normal2.xyz);
 
-            skinnedNormal += mat3(boneMatrix) * normal;
-        }
-    }
-    else {
-        skinnedPosition = vec4(position, 1.0);
-        skinnedNormal = normal;
-    }
+    vec3 normal = DecodeOctahedral(normalTangent.xy);
+    vec3 tangent = DecodeOctahedral(normalTangent.zw);
 
-    vertexData.normal = skinnedNormal;
-    vertexData.tangent = tangent;
-    vertexData.bitangent = bitangent;
-    vertexData.fragPosition = vec3(sharedConstants.model * skinnedPosition);
+    // World space, the fragment stage doesn't know the instance
+    vertexData.normal = normalMatrix * normal;
+    vertexData.tangent = normalMatrix * tangent;
+    vertexData.bitangent = normalMatrix * DecodeBitangent(normal, tangent, position.w);
+    vertexData.fragPosition = vec3(instance.model * vec4(position.xyz, 1.0));
     vertexData.uv = uv;
 
-    gl_Position = camera.projection * camera.view * sharedConstants.model * skinnedPosition;
-}
\ No newline at end of file
+    gl_Position = camera.projection * camera.view * instance.model * vec4(position.xyz, 1.0);
+}
@@ -0,0 +1,94 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "../Include/InstanceData.glsl"
+#include "../Include/VertexPacking.glsl"
+
+layout (constant_id = 0) const uint MAX_BONES = 100;
+layout (constant_id = 1) const uint MAX_BONE_INFLUENCE = 4;
+
+// Mesh space, w is the bitangent sign
+layout (location = 0) in vec4 position;
+// Octahedral normal (xy) and tangent (zw)
+layout (location = 1) in vec4 normalTangent;
+layout (location = 2) in vec2 uv;
+
+layout (location = 3) in uvec4 boneIDS;
+// Unused influences have a weight of 0
+layout (location = 4) in vec4 weights;
+
+layout(location = 0) out VertexData {
+    vec3 normal;
+    vec3 tangent;
+    vec3 bitangent;
+    vec3 fragPosition;
+    vec2 uv;
+} vertexData;
+
+// The depth pre-pass computes the same position, the depth is tested with EQUAL when it runs
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+} camera;
+
+// Dynamic Buffer, MAX_BONES matrices per animated entity
+layout(set = 3, binding = 0) readonly buffer Animation {
+    mat4 boneMatrices[];
+}animation;
+
+// Dynamic Buffer
+layout(set = 0, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceData;
+
+// Dynamic Buffer, the draws' firstInstance points to their range. The culling compacts the visible instances in it
+layout(set = 0, binding = 2) readonly buffer VisibleInstances {
+    uint ids[];
+} visibleInstances;
+
+void main() {
+    Instance instance = instanceData.instances[visibleInstances.ids[gl_InstanceIndex]];
+    mat3 normalMatrix = mat3(instance.normal0.xyz, instance.normal1.xyz, instance.normal2.xyz);
+    uint paletteOffset = instance.bonePalette * MAX_BONES;
+
+    vec3 normal = DecodeOctahedral(normalTangent.xy);
+    vec3 tangent = DecodeOctahedral(normalTangent.zw);
+
+    vec4 skinnedPosition = vec4(0.0);
+    vec3 skinnedNormal = vec3(0.0);
+
+    if(instance.hasAnimation == 1) {
+        for(int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+            if(weights[i] == 0.0) {
+                continue;
+            }
+            if(boneIDS[i] >= MAX_BONES) {
+                skinnedPosition = vec4(position.xyz, 1.0);
+                skinnedNormal = normal;
+                break;
+            }
+
+            mat4 boneMatrix = animation.boneMatrices[paletteOffset + boneIDS[i]];
+
+            vec4 localPosition = boneMatrix * vec4(position.xyz, 1.0);
+            skinnedPosition += localPosition * weights[i];
+
+            skinnedNormal += mat3(boneMatrix) * normal;
+        }
+    }
+    else {
+        skinnedPosition = vec4(position.xyz, 1.0);
+        skinnedNormal = normal;
+    }
+
+    // World space, the fragment stage doesn't know the instance
+    vertexData.normal = normalMatrix * skinnedNormal;
+    vertexData.tangent = normalMatrix * tangent;
+    vertexData.bitangent = normalMatrix * DecodeBitangent(normal, tangent, position.w);
+    vertexData.fragPosition = vec3(instance.model * skinnedPosition);
+    vertexData.uv = uv;
+
+    gl_Position = camera.projection * camera.view * instance.model * skinnedPosition;
+}
@@ -1,44 +1,23 @@
 #version 460
+#extension GL_GOOGLE_include_directive : require
 
-layout (constant_id = 0) const uint MAX_BONES = 100;
-layout (constant_id = 1) const uint MAX_BONE_INFLUENCE = 4;
+#include "../Include/InstanceData.glsl"
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in ivec4 boneIDS;
-layout (location = 2) in vec4 weights;
+// Static meshes, the skinned variant lives in ShadowMappingSkinned
 
-layout(push_constant, std430) uniform SharedConstants {
-    mat4 model;
-    uint hasAnimation;
-} sharedConstants;
+// Quantized to the mesh bounds, the model matrix maps them back
+layout (location = 0) in vec4 position;
 
-layout(set = 0, binding = 0) readonly buffer Animation {
-    mat4 boneMatrices[MAX_BONES];
-}animation;
+layout (location = 0) flat out uint cascade;
 
-void main() {
-    vec4 skinnedPosition = vec4(0.0);
-
-    if(sharedConstants.hasAnimation == 1) {
-        for(int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
-            if(boneIDS[i] == -1) {
-                continue;
-            }
-            if(boneIDS[i] >= MAX_BONES) {
-                skinnedPosition = vec4(position, 1.0);
-                break;
-            }
+// Dynamic Buffer, a caster has one instance per cascade it is rendered in
+layout(set = 2, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceData;
 
-            uint boneID = boneIDS[i];
-            mat4 boneMatrix = animation.boneMatrices[boneID];
-
-            vec4 localPosition = boneMatrix * vec4(position, 1.0);
-            skinnedPosition += localPosition * weights[i];
-        }
-    }
-    else {
-        skinnedPosition = vec4(position, 1.0);
-    }
+void main() {
+    Instance instance = instanceData.instances[gl_InstanceIndex];
+    cascade = instance.cascade;
 
-    gl_Position = sharedConstants.model * skinnedPosition;
+    gl_Position = instance.model * vec4(position.xyz, 1.0);
 }
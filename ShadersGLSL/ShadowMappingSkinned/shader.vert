@@ -0,0 +1,53 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "../Include/InstanceData.glsl"
+
+layout (constant_id = 0) const uint MAX_BONES = 100;
+layout (constant_id = 1) const uint MAX_BONE_INFLUENCE = 4;
+
+layout (location = 0) in vec4 position;
+layout (location = 1) in uvec4 boneIDS;
+// Unused influences have a weight of 0
+layout (location = 2) in vec4 weights;
+
+layout (location = 0) flat out uint cascade;
+
+// MAX_BONES matrices per animated entity
+layout(set = 0, binding = 0) readonly buffer Animation {
+    mat4 boneMatrices[];
+}animation;
+
+// Dynamic Buffer, a caster has one instance per cascade it is rendered in
+layout(set = 2, binding = 1) readonly buffer Instances {
+    Instance instances[];
+} instanceData;
+
+void main() {
+    Instance instance = instanceData.instances[gl_InstanceIndex];
+    cascade = instance.cascade;
+
+    vec4 skinnedPosition = vec4(0.0);
+
+    if(instance.hasAnimation == 1) {
+        for(int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+            if(weights[i] == 0.0) {
+                continue;
+            }
+            if(boneIDS[i] >= MAX_BONES) {
+                skinnedPosition = vec4(position.xyz, 1.0);
+                break;
+            }
+
+            mat4 boneMatrix = animation.boneMatrices[instance.bonePalette * MAX_BONES + boneIDS[i]];
+
+            vec4 localPosition = boneMatrix * vec4(position.xyz, 1.0);
+            skinnedPosition += localPosition * weights[i];
+        }
+    }
+    else {
+        skinnedPosition = vec4(position.xyz, 1.0);
+    }
+
+    gl_Position = instance.model * skinnedPosition;
+}
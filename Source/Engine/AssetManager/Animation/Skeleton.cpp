@@ -7,6 +7,13 @@ bool Skeleton::LoadAsset(const std::string& path)
 	return true;
 }
 
+bool Skeleton::LoadAssetFromMemory(const std::vector<uint8_t>& data, const std::string& extension)
+{
+	MeshImporter::ImportSkeleton(data, extension, skeletonData);
+	return true;
+}
+
 void Skeleton::UnloadAsset()
 {
+	skeletonData = SkeletonData{};
 }
@@ -7,6 +7,7 @@ class Skeleton : public Asset
 {
 public:
 	virtual bool LoadAsset(const std::string& path) override;
+	virtual bool LoadAssetFromMemory(const std::vector<uint8_t>& data, const std::string& extension) override;
 	virtual void UnloadAsset() override;
 
 	const SkeletonData& GetSkeletonData() const { return skeletonData; }
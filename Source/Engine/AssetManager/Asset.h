@@ -2,6 +2,7 @@
 
 #include "Object.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -11,5 +12,7 @@ public:
     Asset() = default;
     
     virtual bool LoadAsset(const std::string &path) = 0;
+    // Used for cooked assets, the data is the decompressed content of the source file
+    virtual bool LoadAssetFromMemory(const std::vector<uint8_t> &data, const std::string &extension) = 0;
     virtual void UnloadAsset() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "AssetDependencyGraph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <unordered_set>
+
+void AssetDependencyGraph::AddDependency(const std::string& asset, const std::string& dependency)
+{
+	if (asset == dependency)
+	{
+		return;
+	}
+
+	std::vector<std::string>& assetDependencies = dependencies[asset];
+	if (std::find(assetDependencies.begin(), assetDependencies.end(), dependency) == assetDependencies.end())
+	{
+		assetDependencies.push_back(dependency);
+	}
+}
+
+void AssetDependencyGraph::GetClosure(const std::string& root, std::vector<std::string>& outAssets) const
+{
+	std::unordered_set<std::string> visited{ root };
+	std::vector<std::string> stack{ root };
+
+	while (!stack.empty())
+	{
+		const std::string asset = std::move(stack.back());
+		stack.pop_back();
+		outAssets.push_back(asset);
+
+		auto it = dependencies.find(asset);
+		if (it == dependencies.end())
+		{
+			continue;
+		}
+
+		for (const std::string& dependency : it->second)
+		{
+			// Cycles are allowed (a skeleton and its clips can point at each other)
+			if (visited.insert(dependency).second)
+			{
+				stack.push_back(dependency);
+			}
+		}
+	}
+}
+
+bool AssetDependencyGraph::LoadDependencyFile(const std::string& asset, const std::string& dependencyFilePath)
+{
+	std::ifstream file(dependencyFilePath);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		AddDependency(asset, line);
+	}
+
+	return true;
+}
+
+void AssetDependencyGraph::Serialize(std::ostream& file) const
+{
+	auto writeString = [&file](const std::string& value)
+		{
+			const uint16_t length = static_cast<uint16_t>(value.size());
+			file.write(reinterpret_cast<const char*>(&length), sizeof(uint16_t));
+			file.write(value.data(), length);
+		};
+
+	const uint32_t assetCount = static_cast<uint32_t>(dependencies.size());
+	file.write(reinterpret_cast<const char*>(&assetCount), sizeof(uint32_t));
+
+	for (const auto& it : dependencies)
+	{
+		writeString(it.first);
+
+		const uint32_t dependencyCount = static_cast<uint32_t>(it.second.size());
+		file.write(reinterpret_cast<const char*>(&dependencyCount), sizeof(uint32_t));
+
+		for (const std::string& dependency : it.second)
+		{
+			writeString(dependency);
+		}
+	}
+}
+
+bool AssetDependencyGraph::Deserialize(std::istream& file)
+{
+	auto readString = [&file](std::string& outValue)
+		{
+			uint16_t length = 0;
+			if (!file.read(reinterpret_cast<char*>(&length), sizeof(uint16_t)))
+			{
+				return false;
+			}
+			outValue.resize(length);
+			return static_cast<bool>(file.read(outValue.data(), length));
+		};
+
+	uint32_t assetCount = 0;
+	if (!file.read(reinterpret_cast<char*>(&assetCount), sizeof(uint32_t)))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		std::string asset;
+		uint32_t dependencyCount = 0;
+		if (!readString(asset) || !file.read(reinterpret_cast<char*>(&dependencyCount), sizeof(uint32_t)))
+		{
+			return false;
+		}
+
+		for (uint32_t j = 0; j < dependencyCount; ++j)
+		{
+			std::string dependency;
+			if (!readString(dependency))
+			{
+				return false;
+			}
+			AddDependency(asset, dependency);
+		}
+	}
+
+	return true;
+}
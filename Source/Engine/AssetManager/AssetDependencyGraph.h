@@ -0,0 +1,33 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sidecar files next to a source asset (Meshes/Hero.fbx -> Meshes/Hero.deps) listing the asset keys it needs, one per line
+constexpr const char* DEPENDENCY_FILE_EXTENSION = ".deps";
+
+/// <summary>
+/// Which assets an asset needs to be usable (a character model needs its textures, skeleton and clips).
+/// Recorded when the packs are cooked so a single request can fetch the whole closure at once.
+/// </summary>
+class AssetDependencyGraph
+{
+public:
+	void AddDependency(const std::string& asset, const std::string& dependency);
+
+	// The root and everything it depends on, directly or not. Each asset is listed once
+	void GetClosure(const std::string& root, std::vector<std::string>& outAssets) const;
+
+	bool LoadDependencyFile(const std::string& asset, const std::string& dependencyFilePath);
+
+	void Serialize(std::ostream& file) const;
+	bool Deserialize(std::istream& file);
+
+	bool IsEmpty() const { return dependencies.empty(); }
+
+private:
+	std::unordered_map<std::string, std::vector<std::string>> dependencies;
+};
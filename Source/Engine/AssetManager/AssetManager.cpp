@@ -1,10 +1,28 @@
 #include "AssetManager.h"
 #include "AssetPath.h"
+#include "ECS/Systems/MaterialSystem.h"
+#include "Engine.h"
+#include "Rendering/RenderingInterface.h"
+#include "ThreadPool.h"
 #include "Utilities/FileHelper.h"
+#include "Utilities/MeshImporter.h"
 
+#include <algorithm>
+#include <iostream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
+constexpr const char* IMPORT_DIRECTORY = "Data/Import";
+constexpr const char* ENGINE_IMPORT_DIRECTORY = "Data/Engine/Import";
+
+// Sources whose materials are scanned for texture dependencies when cooking
+static const std::unordered_set<std::string> MODEL_EXTENSIONS = { ".fbx", ".obj", ".gltf", ".glb", ".dae" };
+static const std::unordered_set<std::string> TEXTURE_EXTENSIONS = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+// Logs the files picked up by the hot reload
+static bool DEBUG_HOT_RELOAD = 0;
+
 AssetManager& AssetManager::Get()
 {
 	static AssetManager instance;
@@ -16,6 +34,18 @@ void AssetManager::UnInitialize()
 	assets.clear();
 }
 
+bool AssetManager::CookAssetPacks()
+{
+	const bool success = CookAssetPack(IMPORT_DIRECTORY);
+	return CookAssetPack(ENGINE_IMPORT_DIRECTORY) && success;
+}
+
+bool AssetManager::WriteManifests()
+{
+	const bool success = WriteManifest(IMPORT_DIRECTORY, false);
+	return WriteManifest(ENGINE_IMPORT_DIRECTORY, true) && success;
+}
+
 void AssetManager::AddAssetRef(uint32_t handle)
 {
 	const std::string& name = nameRegistry.GetName(handle);
@@ -63,19 +93,330 @@ void AssetManager::ReleaseAsset(uint32_t handle)
 	}
 }
 
+void AssetManager::PrefetchBundle(uint32_t rootHandle, OnBundleReady&& callback)
+{
+	std::shared_ptr<Bundle> bundle = std::make_shared<Bundle>();
+	bundle->rootHandle = rootHandle;
+	bundle->callback = std::move(callback);
+	GatherBundle(rootHandle, *bundle);
+
+	const uint32_t assetCount = static_cast<uint32_t>(bundle->assets.size());
+	if (assetCount == 0)
+	{
+		std::lock_guard<std::mutex> lock(bundlesMutex);
+		completedBundles.push_back(bundle);
+		return;
+	}
+
+	bundle->remaining = assetCount;
+	for (uint32_t i = 0; i < assetCount; ++i)
+	{
+		ThreadPool::Get().Submit([this, bundle, i]()
+			{
+				if (!bundle->assets[i]->ReadData(bundle->data[i]))
+				{
+					bundle->success = false;
+				}
+
+				// The last read hands the bundle to the main thread
+				if (--bundle->remaining == 0)
+				{
+					std::lock_guard<std::mutex> lock(bundlesMutex);
+					completedBundles.push_back(bundle);
+				}
+			});
+	}
+}
+
+bool AssetManager::LoadBundle(uint32_t rootHandle)
+{
+	Bundle bundle{};
+	bundle.rootHandle = rootHandle;
+	GatherBundle(rootHandle, bundle);
+
+	ThreadPool::Get().ParallelFor(static_cast<uint32_t>(bundle.assets.size()), [&bundle](uint32_t i)
+		{
+			if (!bundle.assets[i]->ReadData(bundle.data[i]))
+			{
+				bundle.success = false;
+			}
+		});
+
+	CompleteBundle(bundle);
+	return bundle.success;
+}
+
+void AssetManager::DispatchBundles()
+{
+	std::vector<std::shared_ptr<Bundle>> bundles;
+	{
+		std::lock_guard<std::mutex> lock(bundlesMutex);
+		bundles.swap(completedBundles);
+	}
+
+	for (const std::shared_ptr<Bundle>& bundle : bundles)
+	{
+		CompleteBundle(*bundle);
+		if (bundle->callback)
+		{
+			bundle->callback(bundle->rootHandle, bundle->success);
+		}
+	}
+}
+
+bool AssetManager::ReadAssetData(uint32_t handle, std::vector<uint8_t>& outData, std::string& outExtension)
+{
+	LazyAsset* lazyAsset = FindLazyAsset(handle);
+	if (lazyAsset == nullptr)
+	{
+		return false;
+	}
+
+	outExtension = lazyAsset->path.extension;
+
+	// The prefetched data stays for the asset load, the same file can be both an asset and a clip
+	if (lazyAsset->HasPrefetchedData())
+	{
+		outData = lazyAsset->prefetchedData;
+		return true;
+	}
+
+	return lazyAsset->ReadData(outData);
+}
+
+LazyAsset* AssetManager::FindLazyAsset(uint32_t handle)
+{
+	std::string name;
+	if ((handle & ENGINE_ASSET_FLAG) != 0)
+	{
+		auto it = engineNameRegistry.TryGetName(handle, name) ? engineAssets.find(name) : engineAssets.end();
+		return it != engineAssets.end() ? &it->second : nullptr;
+	}
+
+	auto it = nameRegistry.TryGetName(handle, name) ? assets.find(name) : assets.end();
+	return it != assets.end() ? &it->second : nullptr;
+}
+
+void AssetManager::GatherBundle(uint32_t rootHandle, Bundle& bundle)
+{
+	const bool isEngine = (rootHandle & ENGINE_ASSET_FLAG) != 0;
+	std::unordered_map<std::string, LazyAsset>& storage = isEngine ? engineAssets : assets;
+	const AssetNameRegistry& registry = isEngine ? engineNameRegistry : nameRegistry;
+	const AssetDependencyGraph& graph = isEngine ? engineDependencyGraph : dependencyGraph;
+
+	std::string rootName;
+	if (!registry.TryGetName(rootHandle, rootName))
+	{
+		bundle.success = false;
+		return;
+	}
+
+	std::vector<std::string> closure;
+	graph.GetClosure(rootName, closure);
+
+	for (const std::string& name : closure)
+	{
+		auto it = storage.find(name);
+		if (it == storage.end())
+		{
+			std::cerr << "Failed to find " << name << " needed by " << rootName << "!" << std::endl;
+			bundle.success = false;
+			continue;
+		}
+
+		if (!it->second.IsLoaded() && !it->second.HasPrefetchedData())
+		{
+			bundle.assets.push_back(&it->second);
+		}
+	}
+
+	bundle.data.resize(bundle.assets.size());
+}
+
+void AssetManager::CompleteBundle(Bundle& bundle)
+{
+	for (uint32_t i = 0; i < bundle.assets.size(); ++i)
+	{
+		// Another bundle or a direct load could have gotten there first
+		LazyAsset* lazyAsset = bundle.assets[i];
+		if (!lazyAsset->IsLoaded() && !lazyAsset->HasPrefetchedData() && !bundle.data[i].empty())
+		{
+			lazyAsset->SetPrefetchedData(std::move(bundle.data[i]));
+		}
+	}
+}
+
 void AssetManager::ImportAssets()
 {
-	static uint32_t handle = 0;
-	ImportAssets("Data/Import", assets, nameRegistry, handle);
+	ImportAssets(IMPORT_DIRECTORY, assets, nameRegistry, dependencyGraph, assetHandleTracker);
 }
 
 void AssetManager::ImportEngineAssets()
 {
-	static uint32_t handle = 0;
-	ImportAssets("Data/Engine/Import", engineAssets, engineNameRegistry, handle, true);
+	ImportAssets(ENGINE_IMPORT_DIRECTORY, engineAssets, engineNameRegistry, engineDependencyGraph, engineAssetHandleTracker, true);
+}
+
+void AssetManager::ImportAssets(const std::string& importDirectory, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, AssetDependencyGraph& graph, uint32_t& handle, bool isEngine)
+{
+	std::unique_ptr<AssetPack> pack = std::make_unique<AssetPack>();
+	if (pack->Mount(importDirectory + PACK_FILE_EXTENSION))
+	{
+		const std::vector<PackEntry>& entries = pack->GetEntries();
+		for (uint32_t i = 0; i < entries.size(); ++i)
+		{
+			// The path is only informative for cooked assets, the source file doesn't need to exist
+			const PackEntry& entry = entries[i];
+			AssetPath path{ fs::path(importDirectory) / (entry.name + entry.extension) };
+			path.extension = entry.extension;
+
+			storage.emplace(entry.name, LazyAsset{ path, pack.get(), i });
+			RegisterAsset(entry.name, registry, handle, isEngine);
+		}
+
+		graph = pack->GetDependencies();
+		packs.push_back(std::move(pack));
+		return;
+	}
+
+#if !WITH_EDITOR
+	// Shipping builds trust the manifest, the editor always scans so files added since the last WriteManifests show up
+	if (ImportFromManifest(importDirectory, storage, registry, graph, handle))
+	{
+		return;
+	}
+#endif
+
+	// Without a pack or a manifest the loose files are scanned, slower but every build can still run from the sources
+	std::vector<PackSource> sources;
+	std::vector<PackSource> dependencyFiles;
+	GatherSources(importDirectory, sources, dependencyFiles);
+
+	for (const PackSource& source : sources)
+	{
+		storage.emplace(source.name, LazyAsset{ AssetPath{ source.fullPath } });
+		RegisterAsset(source.name, registry, handle, isEngine);
+	}
+
+	// Loose files only know the explicit dependencies, the model textures are discovered when cooking
+	for (const PackSource& dependencyFile : dependencyFiles)
+	{
+		graph.LoadDependencyFile(dependencyFile.name, dependencyFile.fullPath);
+	}
+}
+
+bool AssetManager::ImportFromManifest(const std::string& importDirectory, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, AssetDependencyGraph& graph, uint32_t& handle)
+{
+	AssetManifest manifest;
+	if (!manifest.Load(importDirectory + MANIFEST_FILE_EXTENSION))
+	{
+		return false;
+	}
+
+	for (const ManifestEntry& entry : manifest.GetEntries())
+	{
+		storage.emplace(entry.name, LazyAsset{ AssetPath{ fs::path(importDirectory) / (entry.name + entry.extension) } });
+		registry.Register(entry.name, entry.handle);
+
+		// Assets added later by the hot reload continue after the cooked handles
+		handle = std::max(handle, (entry.handle & ~ENGINE_ASSET_FLAG) + 1);
+	}
+
+	graph = manifest.GetDependencies();
+	return true;
+}
+
+void AssetManager::RegisterAsset(const std::string& name, AssetNameRegistry& registry, uint32_t& handle, bool isEngine)
+{
+	uint32_t currentHandle = handle++;
+	if (isEngine)
+	{
+		currentHandle |= ENGINE_ASSET_FLAG;
+	}
+	registry.Register(name, currentHandle);
+}
+
+bool AssetManager::CookAssetPack(const std::string& importDirectory)
+{
+	std::vector<PackSource> sources;
+	std::vector<PackSource> dependencyFiles;
+	GatherSources(importDirectory, sources, dependencyFiles);
+
+	AssetDependencyGraph graph;
+	BuildDependencyGraph(sources, dependencyFiles, graph);
+
+	return AssetPack::Build(sources, graph, importDirectory + PACK_FILE_EXTENSION);
+}
+
+bool AssetManager::WriteManifest(const std::string& importDirectory, bool isEngine)
+{
+	std::vector<PackSource> sources;
+	std::vector<PackSource> dependencyFiles;
+	GatherSources(importDirectory, sources, dependencyFiles);
+
+	// Handles are assigned the same way the scan does so they don't depend on which one was used
+	AssetManifest manifest;
+	for (uint32_t i = 0; i < sources.size(); ++i)
+	{
+		manifest.AddEntry(sources[i].name, sources[i].extension, isEngine ? i | ENGINE_ASSET_FLAG : i);
+	}
+
+	AssetDependencyGraph graph;
+	BuildDependencyGraph(sources, dependencyFiles, graph);
+	manifest.SetDependencies(graph);
+
+	return manifest.Write(importDirectory + MANIFEST_FILE_EXTENSION);
+}
+
+void AssetManager::BuildDependencyGraph(const std::vector<PackSource>& sources, const std::vector<PackSource>& dependencyFiles, AssetDependencyGraph& outGraph) const
+{
+	for (const PackSource& dependencyFile : dependencyFiles)
+	{
+		outGraph.LoadDependencyFile(dependencyFile.name, dependencyFile.fullPath);
+	}
+	GatherTextureDependencies(sources, outGraph);
+}
+
+void AssetManager::GatherTextureDependencies(const std::vector<PackSource>& sources, AssetDependencyGraph& graph) const
+{
+	// Materials reference textures by file name, the folder they were authored in doesn't match the import folder
+	auto getFileStem = [](const std::string& path)
+		{
+			const size_t separator = path.find_last_of("/\\");
+			std::string stem = separator == std::string::npos ? path : path.substr(separator + 1);
+			return stem.substr(0, stem.find_last_of('.'));
+		};
+
+	std::unordered_map<std::string, std::string> textureKeys;
+	for (const PackSource& source : sources)
+	{
+		if (TEXTURE_EXTENSIONS.contains(source.extension))
+		{
+			textureKeys.emplace(getFileStem(source.name), source.name);
+		}
+	}
+
+	for (const PackSource& source : sources)
+	{
+		if (!MODEL_EXTENSIONS.contains(source.extension))
+		{
+			continue;
+		}
+
+		std::vector<std::string> textures;
+		MeshImporter::GatherTextureReferences(source.fullPath, textures);
+
+		for (const std::string& texture : textures)
+		{
+			auto it = textureKeys.find(getFileStem(texture));
+			if (it != textureKeys.end())
+			{
+				graph.AddDependency(source.name, it->second);
+			}
+		}
+	}
 }
 
-void AssetManager::ImportAssets(const std::string& importDirectory, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, uint32_t& handle, bool isEngine)
+void AssetManager::GatherSources(const std::string& importDirectory, std::vector<PackSource>& outSources, std::vector<PackSource>& outDependencyFiles) const
 {
 	std::vector<fs::path> files;
 	FileHelper::GetFilesFromDirectory(importDirectory, files, {}, "", true);
@@ -83,21 +424,114 @@ void AssetManager::ImportAssets(const std::string& importDirectory, std::unorder
 	for (int32_t i = 0; i < files.size(); ++i)
 	{
 		AssetPath path{ files[i] };
-		const size_t dirPos = path.fullPath.find(importDirectory);
 
-		if (dirPos != std::string::npos)
+		std::string assetPath;
+		if (!TryGetAssetKey(importDirectory, path, assetPath))
 		{
-			std::string assetPath = path.fullPath;
-			assetPath.erase(dirPos, importDirectory.size() + 1);
-			assetPath.erase(assetPath.size() - path.extension.size(), path.extension.size());
-			storage.emplace(assetPath, LazyAsset{ path });
+			continue;
+		}
 
-			uint32_t currentHandle = handle++;
-			if (isEngine)
+		// The sidecar is named after the asset it describes so it shares its key
+		std::vector<PackSource>& destination = path.extension == DEPENDENCY_FILE_EXTENSION ? outDependencyFiles : outSources;
+		destination.emplace_back(PackSource{ assetPath, path.extension, path.fullPath });
+	}
+}
+
+bool AssetManager::TryGetAssetKey(const std::string& importDirectory, const AssetPath& path, std::string& outKey) const
+{
+	const size_t dirPos = path.fullPath.find(importDirectory);
+	if (dirPos == std::string::npos)
+	{
+		return false;
+	}
+
+	outKey = path.fullPath;
+	outKey.erase(dirPos, importDirectory.size() + 1);
+	outKey.erase(outKey.size() - path.extension.size(), path.extension.size());
+	return true;
+}
+
+#if WITH_EDITOR
+void AssetManager::StartHotReload()
+{
+	if (!fs::exists(std::string(IMPORT_DIRECTORY) + PACK_FILE_EXTENSION))
+	{
+		importWatcher.Start(IMPORT_DIRECTORY);
+	}
+
+	if (!fs::exists(std::string(ENGINE_IMPORT_DIRECTORY) + PACK_FILE_EXTENSION))
+	{
+		engineImportWatcher.Start(ENGINE_IMPORT_DIRECTORY);
+	}
+}
+
+void AssetManager::ProcessHotReload()
+{
+	std::vector<uint32_t> reloadedHandles;
+	ProcessHotReload(importWatcher, assets, nameRegistry, dependencyGraph, assetHandleTracker, false, reloadedHandles);
+	ProcessHotReload(engineImportWatcher, engineAssets, engineNameRegistry, engineDependencyGraph, engineAssetHandleTracker, true, reloadedHandles);
+
+	// Textures are referenced by the material descriptors, they need to point to the new image
+	MaterialSystem* materialSystem = GameEngine->GetRenderingSystem()->GetMaterialSystem();
+	for (uint32_t handle : reloadedHandles)
+	{
+		materialSystem->RefreshTexture(handle);
+	}
+}
+
+void AssetManager::ProcessHotReload(FileWatcher& watcher, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, AssetDependencyGraph& graph, uint32_t& handle, bool isEngine, std::vector<uint32_t>& outReloadedHandles)
+{
+	std::vector<std::string> changedFiles;
+	watcher.PollChanges(changedFiles);
+
+	for (const std::string& file : changedFiles)
+	{
+		AssetPath path{ fs::path(file) };
+
+		std::string key;
+		if (!TryGetAssetKey(watcher.GetDirectory(), path, key))
+		{
+			continue;
+		}
+
+		// Dependencies are only added, removing one from the sidecar takes a restart
+		if (path.extension == DEPENDENCY_FILE_EXTENSION)
+		{
+			graph.LoadDependencyFile(key, file);
+			continue;
+		}
+
+		auto it = storage.find(key);
+		if (it == storage.end())
+		{
+			// New source files become available without a restart
+			storage.emplace(key, LazyAsset{ path });
+			RegisterAsset(key, registry, handle, isEngine);
+			if (DEBUG_HOT_RELOAD)
+			{
+				std::cout << "Hot reload: imported new asset " << key << std::endl;
+			}
+			continue;
+		}
+
+		// Nothing to do for assets that aren't loaded, the next load will read the new file
+		if (!it->second.IsLoaded())
+		{
+			continue;
+		}
+
+		if (it->second.Reload())
+		{
+			outReloadedHandles.push_back(registry.GetHandle(key));
+			if (DEBUG_HOT_RELOAD)
 			{
-				currentHandle |= ENGINE_ASSET_FLAG;
+				std::cout << "Hot reload: reloaded " << key << std::endl;
 			}
-			registry.Register(assetPath, currentHandle);
+		}
+		else
+		{
+			std::cerr << "Failed to hot reload " << key << "!" << std::endl;
 		}
 	}
 }
+#endif
@@ -1,15 +1,26 @@
 #pragma once
 
+#include "AssetDependencyGraph.h"
 #include "LazyAsset.h"
+#include "Pack/AssetManifest.h"
+#include "Pack/AssetPack.h"
+#include "Utilities/FileWatcher.h"
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 constexpr uint32_t ENGINE_ASSET_FLAG = 1u << 31;
 
+// Called on the main thread once every asset of the bundle was read, success is false if any of them failed
+using OnBundleReady = std::function<void(uint32_t rootHandle, bool success)>;
+
 struct AssetNameRegistry
 {
 	std::unordered_map<std::string, uint32_t> nameToHandle;
@@ -53,9 +64,47 @@ public:
 	static AssetManager& Get();
 
 	void UnInitialize();
+
+	/**
+	 * Compresses the content of the import directories into asset packs. Once a pack exists the
+	 * asset manager reads the assets from it instead of the loose files.
+	 */
+	bool CookAssetPacks();
+
+	/**
+	 * Writes the index of the loose import files so the startup doesn't scan the import directories, for builds
+	 * that ship without packs. Editor builds ignore the manifests and always scan, so they can't go stale while iterating.
+	 */
+	bool WriteManifests();
+
+#if WITH_EDITOR
+	// Watches the loose import folders, directories served from a pack are skipped
+	void StartHotReload();
+
+	/**
+	 * Re-imports the loaded assets whose source changed. Must be called between frames, the old GPU resources
+	 * go through the renderer's deferred destroy list so the frames in flight are not affected.
+	 */
+	void ProcessHotReload();
+#endif
 		
 	void ReleaseAsset(uint32_t handle);
 
+	/**
+	 * Reads the asset and everything it depends on in parallel on the worker threads. The data is kept
+	 * until the assets are loaded so the loads don't touch the disk. Assets already loaded are skipped.
+	 */
+	void PrefetchBundle(uint32_t rootHandle, OnBundleReady&& callback);
+
+	// Same as PrefetchBundle but waits for the reads to finish
+	bool LoadBundle(uint32_t rootHandle);
+
+	// Hands the finished prefetches to their assets and calls the bundle callbacks, called once per frame
+	void DispatchBundles();
+
+	// The source data of the asset for the systems that import it themselves (animation clips)
+	bool ReadAssetData(uint32_t handle, std::vector<uint8_t>& outData, std::string& outExtension);
+
 	/*
 	* TODO the asset manager currently has an issue. The same handle can be used for
 	* different asset types. This doesn't sound like a big deal, but it is. When
@@ -83,7 +132,33 @@ private:
 
 	void ImportAssets();
 	void ImportEngineAssets();
-	void ImportAssets(const std::string& importDirectory, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, uint32_t& handle, bool isEngine = false);
+	void ImportAssets(const std::string& importDirectory, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, AssetDependencyGraph& graph, uint32_t& handle, bool isEngine = false);
+	void RegisterAsset(const std::string& name, AssetNameRegistry& registry, uint32_t& handle, bool isEngine);
+	bool ImportFromManifest(const std::string& importDirectory, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, AssetDependencyGraph& graph, uint32_t& handle);
+	bool TryGetAssetKey(const std::string& importDirectory, const AssetPath& path, std::string& outKey) const;
+
+	bool CookAssetPack(const std::string& importDirectory);
+	bool WriteManifest(const std::string& importDirectory, bool isEngine);
+	void BuildDependencyGraph(const std::vector<PackSource>& sources, const std::vector<PackSource>& dependencyFiles, AssetDependencyGraph& outGraph) const;
+	void GatherSources(const std::string& importDirectory, std::vector<PackSource>& outSources, std::vector<PackSource>& outDependencyFiles) const;
+	void GatherTextureDependencies(const std::vector<PackSource>& sources, AssetDependencyGraph& graph) const;
+
+	struct Bundle
+	{
+		uint32_t rootHandle = 0;
+		OnBundleReady callback;
+
+		std::vector<LazyAsset*> assets;
+		std::vector<std::vector<uint8_t>> data;
+
+		std::atomic<uint32_t> remaining = 0;
+		std::atomic<bool> success = true;
+	};
+
+	LazyAsset* FindLazyAsset(uint32_t handle);
+	// The assets of the bundle that still need to be read, LazyAsset pointers are stable since the storages never erase
+	void GatherBundle(uint32_t rootHandle, Bundle& bundle);
+	void CompleteBundle(Bundle& bundle);
 
 	/**
 	 * The key is the asset name with the subfolder. For example:
@@ -95,6 +170,25 @@ private:
 	std::unordered_map<std::string, LazyAsset> engineAssets;
 	AssetNameRegistry engineNameRegistry;
 
+	AssetDependencyGraph dependencyGraph;
+	AssetDependencyGraph engineDependencyGraph;
+
+	// Lazy assets keep a pointer to the pack they were cooked in so the packs live as long as the manager
+	std::vector<std::unique_ptr<AssetPack>> packs;
+
+	uint32_t assetHandleTracker = 0;
+	uint32_t engineAssetHandleTracker = 0;
+
+	std::mutex bundlesMutex;
+	std::vector<std::shared_ptr<Bundle>> completedBundles;
+
+#if WITH_EDITOR
+	void ProcessHotReload(FileWatcher& watcher, std::unordered_map<std::string, LazyAsset>& storage, AssetNameRegistry& registry, AssetDependencyGraph& graph, uint32_t& handle, bool isEngine, std::vector<uint32_t>& outReloadedHandles);
+
+	FileWatcher importWatcher;
+	FileWatcher engineImportWatcher;
+#endif
+
 	friend class Engine;
 };
 
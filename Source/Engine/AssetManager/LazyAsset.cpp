@@ -1,4 +1,7 @@
 #include "LazyAsset.h"
+#include "Utilities/AsyncFileIO.h"
+
+#include <filesystem>
 
 LazyAsset::~LazyAsset()
 {
@@ -10,6 +13,49 @@ LazyAsset::~LazyAsset()
 	}
 }
 
+bool LazyAsset::Reload()
+{
+	if (asset == nullptr || pack != nullptr)
+	{
+		return false;
+	}
+
+	// Unloading hands the GPU resources to the renderer's deferred destroy list so in flight frames can still use them
+	asset->UnloadAsset();
+	return asset->LoadAsset(path.fullPath);
+}
+
+bool LazyAsset::ReadData(std::vector<uint8_t>& outData) const
+{
+	if (pack != nullptr)
+	{
+		return pack->ReadEntry(packEntry, outData);
+	}
+
+	std::error_code error;
+	const uint64_t fileSize = std::filesystem::file_size(path.fullPath, error);
+	if (error)
+	{
+		std::cerr << "Failed to read " << path.fullPath << "!" << std::endl;
+		return false;
+	}
+
+	outData.resize(fileSize);
+
+	IORequest request{};
+	request.path = path.fullPath;
+	request.size = fileSize;
+	request.destination = outData.data();
+
+	return fileSize == 0 || AsyncFileIO::Get().Read(std::move(request)) == EIOStatus::Completed;
+}
+
+void LazyAsset::SetPrefetchedData(std::vector<uint8_t>&& data)
+{
+	prefetchedData = std::move(data);
+	hasPrefetchedData = true;
+}
+
 void LazyAsset::Increment()
 {
 	counter++;
@@ -18,6 +64,12 @@ void LazyAsset::Increment()
 void LazyAsset::Decrement()
 {
 	counter--;
+	if (counter <= 0)
+	{
+		prefetchedData = {};
+		hasPrefetchedData = false;
+	}
+
 	if (counter <= 0 && asset != nullptr)
 	{
 		asset->UnloadAsset();
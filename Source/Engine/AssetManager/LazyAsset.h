@@ -2,10 +2,12 @@
 
 #include "Asset.h"
 #include "AssetPath.h"
+#include "Pack/AssetPack.h"
 
 #include <cassert>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
 // This should only be used in the asset manager
 struct LazyAsset
@@ -16,17 +18,37 @@ private:
 	LazyAsset() = default;
 	LazyAsset(const AssetPath& inPath)
 		: path(inPath) {}
+	LazyAsset(const AssetPath& inPath, const AssetPack* inPack, uint32_t inPackEntry)
+		: path(inPath), pack(inPack), packEntry(inPackEntry) {}
 
 	Asset* asset = nullptr;
 	AssetPath path;
 	uint32_t counter = 0;
 
+	// When the asset was cooked the data is read from the pack instead of the path
+	const AssetPack* pack = nullptr;
+	uint32_t packEntry = 0;
+
+	// Filled by bundle prefetches so the first Get doesn't wait on the disk
+	std::vector<uint8_t> prefetchedData;
+	bool hasPrefetchedData = false;
+
 	template<typename T>
 	T* Get();
 
 	void Increment();
 	void Decrement();
 
+	bool IsLoaded() const { return asset != nullptr; }
+	bool HasPrefetchedData() const { return hasPrefetchedData; }
+
+	// Raw content of the source file, from the pack when cooked. Doesn't touch the lazy state so it's safe from worker threads
+	bool ReadData(std::vector<uint8_t>& outData) const;
+	void SetPrefetchedData(std::vector<uint8_t>&& data);
+
+	// Re-imports the asset in place so pointers handed out by the asset manager stay valid
+	bool Reload();
+
 	friend class AssetManager;
 };
 
@@ -36,7 +58,32 @@ inline T* LazyAsset::Get()
 	if (asset == nullptr)
 	{
 		asset = new T();
-		asset->LoadAsset(path.fullPath);
+
+		// A failed asset is still handed out, its users check if it's ready before using its GPU data
+		bool loaded = false;
+		if (hasPrefetchedData)
+		{
+			loaded = asset->LoadAssetFromMemory(prefetchedData, path.extension);
+			prefetchedData = {};
+			hasPrefetchedData = false;
+		}
+		else if (pack != nullptr)
+		{
+			std::vector<uint8_t> data;
+			if (pack->ReadEntry(packEntry, data))
+			{
+				loaded = asset->LoadAssetFromMemory(data, path.extension);
+			}
+		}
+		else
+		{
+			loaded = asset->LoadAsset(path.fullPath);
+		}
+
+		if (!loaded)
+		{
+			std::cerr << "Failed to load " << path.fullPath << "!" << std::endl;
+		}
 	}
 
 	return reinterpret_cast<T*>(asset);
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <glm/glm.hpp>
+#include <vector>
 
 // How many vertices a bone can influence
 constexpr int32_t MAX_BONE_INFLUENCE = 4;
@@ -18,10 +19,85 @@ struct Vertex
 	glm::vec4 weights = glm::vec4(0.0f);
 };
 
+// The layouts the GPU reads, the importer keeps working with the full float Vertex and packs it on upload.
+// Each mesh gets 2 streams, the depth only passes (shadows) bind the position stream alone
+struct StaticPosition
+{
+	// snorm16 relative to the mesh bounds, the dequantization is folded in the model matrix. w is the bitangent sign
+	int16_t position[4];
+};
+
+struct SkinnedPosition
+{
+	// half floats in mesh space since the bones are applied before the model matrix. w is the bitangent sign
+	uint16_t position[4];
+	uint8_t boneIDs[MAX_BONE_INFLUENCE];
+	// unorm8, unused influences have a weight of 0
+	uint8_t weights[MAX_BONE_INFLUENCE];
+};
+
+// Shading only attributes, the same for static and skinned meshes
+struct VertexAttributes
+{
+	// snorm16 octahedral encoded normal (xy) and tangent (zw)
+	int16_t normalTangent[4];
+	// half floats
+	uint16_t uv[2];
+};
+
+// Simplified index list of a submesh, it indexes the same vertices as the full resolution one
+struct MeshLod
+{
+	std::vector<uint32_t> indices;
+	uint32_t count = 0;
+	uint32_t indexByteOffset = 0;
+	// Mesh space distance the simplification moved the surface by
+	float error = 0.0f;
+};
+
+// Cluster of triangles culled as a unit, a range of its submesh's full resolution indices
+struct Meshlet
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
+
+// Mesh space bounds of the meshlets in SoA so they are culled 4 at a time, padded to a multiple of 4.
+// The same arrays can be uploaded as is once the culling moves to the GPU
+struct MeshletBounds
+{
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+
+	// Normal cone, the meshlet faces away from the camera when it is inside the cone. A cutoff of 1 never culls
+	std::vector<float> coneAxisX;
+	std::vector<float> coneAxisY;
+	std::vector<float> coneAxisZ;
+	std::vector<float> coneCutoff;
+};
+
 struct MeshIndexData
 {
+	// Relative to vertexOffset, uploaded as 16 bit when the submesh has few enough vertices
 	std::vector<uint32_t> indices;
 	uint32_t count;
+
+	// Each submesh owns a contiguous range of the vertex buffer
+	int32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+
+	// Where the submesh's indices start in the index buffer, always 4 bytes aligned
+	uint32_t indexByteOffset = 0;
+	bool use16BitIndices = false;
+
+	// LOD 1 and up, a submesh that couldn't be simplified further reuses its last LOD
+	std::vector<MeshLod> lods;
+
+	// Only built for the full resolution of big static submeshes, empty otherwise
+	std::vector<Meshlet> meshlets;
+	MeshletBounds meshletBounds;
 };
 
 struct Material
@@ -37,7 +113,16 @@ struct MeshData
 	uint32_t meshesCount = 0;
 
 	std::vector<MeshIndexData> meshIndices;
-	std::vector<size_t> offset;
+	// Size of the index buffer, the submeshes mix 16 and 32 bit indices
+	uint32_t indexBufferSize = 0;
+
+	// Largest submesh error of each LOD of the model, LOD 0 is the full resolution with no error
+	std::vector<float> lodErrors;
 	std::vector<Vertex> vertices;
 	std::vector<Material> materials;
+
+	// Skinned meshes use the SkinnedPosition layout and the skinned pipelines
+	bool isSkinned = false;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
 };
\ No newline at end of file
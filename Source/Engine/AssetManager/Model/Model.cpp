@@ -10,12 +10,26 @@ bool Model::LoadAsset(const std::string& path)
 	RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
 
 	renderingInterface->CreateMeshVertexBuffer(meshData, renderData);
-	return true;
+	return IsReady();
+}
+
+bool Model::LoadAssetFromMemory(const std::vector<uint8_t>& data, const std::string& extension)
+{
+	MeshImporter::ImportModel(data, extension, meshData);
+	RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
+
+	renderingInterface->CreateMeshVertexBuffer(meshData, renderData);
+	return IsReady();
 }
 
 void Model::UnloadAsset()
 {
 	RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
-	renderingInterface->DestroyBuffer(renderData.vertex);
-	renderingInterface->DestroyBuffer(renderData.index);
+	if (renderData.state == ERenderDataLoadState::Ready)
+	{
+		renderingInterface->DestroyMeshVertexBuffer(renderData);
+	}
+
+	meshData = MeshData{};
+	renderData = MeshRenderData{};
 }
@@ -10,10 +10,16 @@ class Model : public Asset
 {
 public:
 	virtual bool LoadAsset(const std::string& path) override;
+	virtual bool LoadAssetFromMemory(const std::vector<uint8_t>& data, const std::string& extension) override;
 	virtual void UnloadAsset() override;
 
 	const MeshData& GetMeshData() const { return meshData; }
 	const MeshRenderData& GetRenderData() const { return renderData; }
+	// False when the mesh didn't fit in the geometry pool, it has no range of its own and mustn't be drawn
+	bool IsReady() const { return renderData.state == ERenderDataLoadState::Ready; }
+
+	// The imported materials are shared with every model using the same ones, a model gets its own textures by swapping its material
+	void SetMaterial(uint32_t submesh, const Material& material) { meshData.materials[submesh] = material; }
 
 private:
 	MeshData meshData;
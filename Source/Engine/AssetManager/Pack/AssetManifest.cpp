@@ -0,0 +1,118 @@
+#include "AssetManifest.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	struct ManifestHeader
+	{
+		uint32_t magic = MANIFEST_MAGIC;
+		uint32_t version = MANIFEST_VERSION;
+		uint32_t entryCount = 0;
+	};
+
+	void WriteString(std::ostream& file, const std::string& value)
+	{
+		const uint16_t length = static_cast<uint16_t>(value.size());
+		file.write(reinterpret_cast<const char*>(&length), sizeof(uint16_t));
+		file.write(value.data(), length);
+	}
+
+	bool ReadString(std::istream& file, std::string& outValue)
+	{
+		uint16_t length = 0;
+		if (!file.read(reinterpret_cast<char*>(&length), sizeof(uint16_t)))
+		{
+			return false;
+		}
+
+		outValue.resize(length);
+		return static_cast<bool>(file.read(outValue.data(), length));
+	}
+}
+
+bool AssetManifest::Load(const std::string& manifestPath)
+{
+	std::ifstream file(manifestPath, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	// The whole file is read at once, everything after that is parsed from memory
+	std::string content(static_cast<size_t>(file.tellg()), '\0');
+	file.seekg(0);
+	if (!file.read(content.data(), content.size()))
+	{
+		std::cerr << "Failed to read the manifest " << manifestPath << "!" << std::endl;
+		return false;
+	}
+
+	std::istringstream stream(std::move(content));
+
+	ManifestHeader header{};
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(ManifestHeader)) || header.magic != MANIFEST_MAGIC)
+	{
+		std::cerr << "Failed to load the manifest " << manifestPath << ", the file is not a manifest!" << std::endl;
+		return false;
+	}
+
+	if (header.version != MANIFEST_VERSION)
+	{
+		std::cerr << "Failed to load the manifest " << manifestPath << ", version " << header.version << " is not supported!" << std::endl;
+		return false;
+	}
+
+	entries.resize(header.entryCount);
+	for (ManifestEntry& entry : entries)
+	{
+		if (!ReadString(stream, entry.name) || !ReadString(stream, entry.extension) ||
+			!stream.read(reinterpret_cast<char*>(&entry.handle), sizeof(uint32_t)))
+		{
+			std::cerr << "Failed to read the entries of " << manifestPath << "!" << std::endl;
+			entries.clear();
+			return false;
+		}
+	}
+
+	if (!dependencies.Deserialize(stream))
+	{
+		std::cerr << "Failed to read the dependencies of " << manifestPath << "!" << std::endl;
+		entries.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool AssetManifest::Write(const std::string& manifestPath) const
+{
+	std::ofstream file(manifestPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to create the manifest " << manifestPath << "!" << std::endl;
+		return false;
+	}
+
+	ManifestHeader header{};
+	header.entryCount = static_cast<uint32_t>(entries.size());
+	file.write(reinterpret_cast<const char*>(&header), sizeof(ManifestHeader));
+
+	for (const ManifestEntry& entry : entries)
+	{
+		WriteString(file, entry.name);
+		WriteString(file, entry.extension);
+		file.write(reinterpret_cast<const char*>(&entry.handle), sizeof(uint32_t));
+	}
+
+	dependencies.Serialize(file);
+
+	return static_cast<bool>(file);
+}
+
+void AssetManifest::AddEntry(const std::string& name, const std::string& extension, uint32_t handle)
+{
+	entries.emplace_back(ManifestEntry{ name, extension, handle });
+}
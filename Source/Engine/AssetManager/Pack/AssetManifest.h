@@ -0,0 +1,43 @@
+#pragma once
+
+#include "AssetManager/AssetDependencyGraph.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr uint32_t MANIFEST_MAGIC = 0x464E4D41; // "AMNF"
+constexpr uint32_t MANIFEST_VERSION = 1;
+
+// The manifest of an import directory sits next to it (Data/Import -> Data/Import.manifest)
+constexpr const char* MANIFEST_FILE_EXTENSION = ".manifest";
+
+struct ManifestEntry
+{
+	// Same key format the asset manager uses (Textures\\Floor), the file is importDirectory/name + extension
+	std::string name;
+	std::string extension;
+	uint32_t handle = 0;
+};
+
+/// <summary>
+/// Index of the loose files of an import directory written when cooking. Loading it is a single read
+/// so the startup doesn't have to walk the directory tree. Layout on disk:
+/// [header][entries][dependency graph]
+/// </summary>
+class AssetManifest
+{
+public:
+	bool Load(const std::string& manifestPath);
+	bool Write(const std::string& manifestPath) const;
+
+	void AddEntry(const std::string& name, const std::string& extension, uint32_t handle);
+
+	const std::vector<ManifestEntry>& GetEntries() const { return entries; }
+	const AssetDependencyGraph& GetDependencies() const { return dependencies; }
+	void SetDependencies(const AssetDependencyGraph& inDependencies) { dependencies = inDependencies; }
+
+private:
+	std::vector<ManifestEntry> entries;
+	AssetDependencyGraph dependencies;
+};
@@ -0,0 +1,399 @@
+#include "AssetPack.h"
+#include "ThreadPool.h"
+#include "Utilities/AsyncFileIO.h"
+#include "Utilities/FileHelper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <lz4.h>
+#include <zstd.h>
+
+namespace
+{
+	struct PackHeader
+	{
+		uint32_t magic = PACK_MAGIC;
+		uint32_t version = PACK_VERSION;
+		uint32_t entryCount = 0;
+		uint32_t chunkCount = 0;
+		uint64_t tableOffset = 0;
+	};
+
+	constexpr int32_t ZSTD_LEVEL = 19;
+
+	void WriteString(std::ofstream& file, const std::string& value)
+	{
+		const uint16_t length = static_cast<uint16_t>(value.size());
+		file.write(reinterpret_cast<const char*>(&length), sizeof(uint16_t));
+		file.write(value.data(), length);
+	}
+
+	bool ReadString(std::ifstream& file, std::string& outValue)
+	{
+		uint16_t length = 0;
+		if (!file.read(reinterpret_cast<char*>(&length), sizeof(uint16_t)))
+		{
+			return false;
+		}
+
+		outValue.resize(length);
+		return static_cast<bool>(file.read(outValue.data(), length));
+	}
+}
+
+bool AssetPack::Mount(const std::string& inPackPath)
+{
+	std::ifstream file(inPackPath, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	PackHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(PackHeader)) || header.magic != PACK_MAGIC)
+	{
+		std::cerr << "Failed to mount asset pack " << inPackPath << ", invalid header!" << std::endl;
+		return false;
+	}
+
+	if (header.version != PACK_VERSION)
+	{
+		std::cerr << "Failed to mount asset pack " << inPackPath << ", version " << header.version << " is not supported!" << std::endl;
+		return false;
+	}
+
+	file.seekg(header.tableOffset);
+
+	entries.resize(header.entryCount);
+	for (PackEntry& entry : entries)
+	{
+		bool success = ReadString(file, entry.name) && ReadString(file, entry.extension);
+		success = success && file.read(reinterpret_cast<char*>(&entry.uncompressedSize), sizeof(uint64_t));
+		success = success && file.read(reinterpret_cast<char*>(&entry.firstChunk), sizeof(uint32_t));
+		success = success && file.read(reinterpret_cast<char*>(&entry.chunkCount), sizeof(uint32_t));
+
+		if (!success)
+		{
+			std::cerr << "Failed to read the entry table of asset pack " << inPackPath << "!" << std::endl;
+			entries.clear();
+			return false;
+		}
+	}
+
+	chunks.resize(header.chunkCount);
+	if (!file.read(reinterpret_cast<char*>(chunks.data()), sizeof(PackChunk) * chunks.size()))
+	{
+		std::cerr << "Failed to read the chunk table of asset pack " << inPackPath << "!" << std::endl;
+		entries.clear();
+		chunks.clear();
+		return false;
+	}
+
+	for (const PackEntry& entry : entries)
+	{
+		if (!IsEntryValid(entry))
+		{
+			std::cerr << "Failed to mount asset pack " << inPackPath << ", entry " << entry.name << " doesn't match the chunk table!" << std::endl;
+			entries.clear();
+			chunks.clear();
+			return false;
+		}
+	}
+
+	if (!dependencies.Deserialize(file))
+	{
+		std::cerr << "Failed to read the dependency graph of asset pack " << inPackPath << "!" << std::endl;
+		entries.clear();
+		chunks.clear();
+		return false;
+	}
+
+	packPath = inPackPath;
+	return true;
+}
+
+bool AssetPack::IsEntryValid(const PackEntry& entry) const
+{
+	if (static_cast<uint64_t>(entry.firstChunk) + entry.chunkCount > chunks.size())
+	{
+		return false;
+	}
+
+	uint64_t totalSize = 0;
+	for (uint32_t index = 0; index < entry.chunkCount; ++index)
+	{
+		const PackChunk& chunk = chunks[entry.firstChunk + index];
+		if (chunk.uncompressedSize > PACK_CHUNK_SIZE)
+		{
+			return false;
+		}
+
+		// ReadEntry decompresses chunk i at i * PACK_CHUNK_SIZE, so only the last chunk may be partial
+		if (index + 1 < entry.chunkCount && chunk.uncompressedSize != PACK_CHUNK_SIZE)
+		{
+			return false;
+		}
+
+		// The chunks are fetched with a single read, they have to follow each other in the file
+		if (index > 0)
+		{
+			const PackChunk& previous = chunks[entry.firstChunk + index - 1];
+			if (chunk.offset != previous.offset + previous.compressedSize)
+			{
+				return false;
+			}
+		}
+
+		if (chunk.codec == EPackCodec::Raw && chunk.compressedSize != chunk.uncompressedSize)
+		{
+			return false;
+		}
+
+		totalSize += chunk.uncompressedSize;
+	}
+
+	return totalSize == entry.uncompressedSize;
+}
+
+bool AssetPack::ReadEntry(uint32_t entryIndex, void* destination, size_t destinationSize) const
+{
+	if (entryIndex >= entries.size())
+	{
+		return false;
+	}
+
+	const PackEntry& entry = entries[entryIndex];
+	if (destinationSize < entry.uncompressedSize)
+	{
+		std::cerr << "Failed to read " << entry.name << ", destination is too small!" << std::endl;
+		return false;
+	}
+
+	if (entry.chunkCount == 0)
+	{
+		return true;
+	}
+
+	const PackChunk& firstChunk = chunks[entry.firstChunk];
+	const PackChunk& lastChunk = chunks[entry.firstChunk + entry.chunkCount - 1];
+	const uint64_t compressedSize = lastChunk.offset + lastChunk.compressedSize - firstChunk.offset;
+
+	std::vector<uint8_t> compressed(compressedSize);
+
+	// Goes through the async queue so entries fetched from different threads are batched together
+	IORequest request{};
+	request.path = packPath;
+	request.offset = firstChunk.offset;
+	request.size = compressedSize;
+	request.destination = compressed.data();
+	request.priority = EIOPriority::High;
+
+	if (AsyncFileIO::Get().Read(std::move(request)) != EIOStatus::Completed)
+	{
+		std::cerr << "Failed to read " << entry.name << " from asset pack " << packPath << "!" << std::endl;
+		return false;
+	}
+
+	uint8_t* output = static_cast<uint8_t*>(destination);
+	std::atomic<bool> success = true;
+
+	ThreadPool::Get().ParallelFor(entry.chunkCount, [&](uint32_t index)
+		{
+			const PackChunk& chunk = chunks[entry.firstChunk + index];
+			const uint8_t* source = compressed.data() + (chunk.offset - firstChunk.offset);
+
+			if (!DecompressChunk(source, chunk, output + static_cast<size_t>(index) * PACK_CHUNK_SIZE))
+			{
+				success = false;
+			}
+		});
+
+	if (!success)
+	{
+		std::cerr << "Failed to decompress " << entry.name << " from asset pack " << packPath << "!" << std::endl;
+	}
+
+	return success;
+}
+
+bool AssetPack::ReadEntry(uint32_t entryIndex, std::vector<uint8_t>& outData) const
+{
+	if (entryIndex >= entries.size())
+	{
+		return false;
+	}
+
+	outData.resize(entries[entryIndex].uncompressedSize);
+	return ReadEntry(entryIndex, outData.data(), outData.size());
+}
+
+bool AssetPack::Build(const std::vector<PackSource>& sources, const AssetDependencyGraph& dependencies, const std::string& outPackPath, EPackCodec codec)
+{
+	std::ofstream file(outPackPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to create asset pack " << outPackPath << "!" << std::endl;
+		return false;
+	}
+
+	PackHeader header{};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(PackHeader));
+
+	std::vector<PackEntry> packEntries;
+	std::vector<PackChunk> packChunks;
+	packEntries.reserve(sources.size());
+
+	uint64_t offset = sizeof(PackHeader);
+
+	for (const PackSource& source : sources)
+	{
+		std::vector<char> data;
+		try
+		{
+			data = FileHelper::ReadFile(source.fullPath);
+		}
+		catch (const std::exception&)
+		{
+			std::cerr << "Failed to read " << source.fullPath << ", skipping it from the pack!" << std::endl;
+			continue;
+		}
+
+		PackEntry& entry = packEntries.emplace_back();
+		entry.name = source.name;
+		entry.extension = source.extension;
+		entry.uncompressedSize = data.size();
+		entry.firstChunk = static_cast<uint32_t>(packChunks.size());
+		entry.chunkCount = static_cast<uint32_t>((data.size() + PACK_CHUNK_SIZE - 1) / PACK_CHUNK_SIZE);
+
+		std::vector<std::vector<uint8_t>> compressedChunks(entry.chunkCount);
+		std::vector<EPackCodec> chunkCodecs(entry.chunkCount);
+		std::atomic<bool> success = true;
+
+		ThreadPool::Get().ParallelFor(entry.chunkCount, [&](uint32_t index)
+			{
+				const size_t chunkOffset = static_cast<size_t>(index) * PACK_CHUNK_SIZE;
+				const uint32_t chunkSize = static_cast<uint32_t>(std::min<size_t>(PACK_CHUNK_SIZE, data.size() - chunkOffset));
+				const uint8_t* chunkData = reinterpret_cast<const uint8_t*>(data.data()) + chunkOffset;
+
+				if (!CompressChunk(chunkData, chunkSize, codec, compressedChunks[index], chunkCodecs[index]))
+				{
+					success = false;
+				}
+			});
+
+		if (!success)
+		{
+			std::cerr << "Failed to compress " << source.fullPath << "!" << std::endl;
+			return false;
+		}
+
+		for (uint32_t i = 0; i < entry.chunkCount; ++i)
+		{
+			const size_t chunkOffset = static_cast<size_t>(i) * PACK_CHUNK_SIZE;
+
+			PackChunk chunk{};
+			chunk.offset = offset;
+			chunk.compressedSize = static_cast<uint32_t>(compressedChunks[i].size());
+			chunk.uncompressedSize = static_cast<uint32_t>(std::min<size_t>(PACK_CHUNK_SIZE, data.size() - chunkOffset));
+			chunk.codec = chunkCodecs[i];
+			packChunks.push_back(chunk);
+
+			file.write(reinterpret_cast<const char*>(compressedChunks[i].data()), chunk.compressedSize);
+			offset += chunk.compressedSize;
+		}
+	}
+
+	header.entryCount = static_cast<uint32_t>(packEntries.size());
+	header.chunkCount = static_cast<uint32_t>(packChunks.size());
+	header.tableOffset = offset;
+
+	for (const PackEntry& entry : packEntries)
+	{
+		WriteString(file, entry.name);
+		WriteString(file, entry.extension);
+		file.write(reinterpret_cast<const char*>(&entry.uncompressedSize), sizeof(uint64_t));
+		file.write(reinterpret_cast<const char*>(&entry.firstChunk), sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(&entry.chunkCount), sizeof(uint32_t));
+	}
+
+	file.write(reinterpret_cast<const char*>(packChunks.data()), sizeof(PackChunk) * packChunks.size());
+	dependencies.Serialize(file);
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(PackHeader));
+
+	if (!file.good())
+	{
+		std::cerr << "Failed to write asset pack " << outPackPath << "!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool AssetPack::CompressChunk(const uint8_t* source, uint32_t sourceSize, EPackCodec codec, std::vector<uint8_t>& outData, EPackCodec& outCodec)
+{
+	outCodec = codec;
+
+	switch (codec)
+	{
+	case EPackCodec::LZ4:
+	{
+		outData.resize(LZ4_compressBound(static_cast<int32_t>(sourceSize)));
+		const int32_t size = LZ4_compress_default(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(outData.data()), static_cast<int32_t>(sourceSize), static_cast<int32_t>(outData.size()));
+		if (size <= 0)
+		{
+			return false;
+		}
+		outData.resize(size);
+		break;
+	}
+	case EPackCodec::Zstd:
+	{
+		outData.resize(ZSTD_compressBound(sourceSize));
+		const size_t size = ZSTD_compress(outData.data(), outData.size(), source, sourceSize, ZSTD_LEVEL);
+		if (ZSTD_isError(size))
+		{
+			return false;
+		}
+		outData.resize(size);
+		break;
+	}
+	default:
+		break;
+	}
+
+	// Not worth paying the decompression cost if nothing was saved
+	if (codec == EPackCodec::Raw || outData.size() >= sourceSize)
+	{
+		outCodec = EPackCodec::Raw;
+		outData.assign(source, source + sourceSize);
+	}
+
+	return true;
+}
+
+bool AssetPack::DecompressChunk(const uint8_t* source, const PackChunk& chunk, uint8_t* destination)
+{
+	switch (chunk.codec)
+	{
+	case EPackCodec::Raw:
+		std::memcpy(destination, source, chunk.uncompressedSize);
+		return true;
+	case EPackCodec::LZ4:
+	{
+		const int32_t size = LZ4_decompress_safe(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination), static_cast<int32_t>(chunk.compressedSize), static_cast<int32_t>(chunk.uncompressedSize));
+		return size == static_cast<int32_t>(chunk.uncompressedSize);
+	}
+	case EPackCodec::Zstd:
+	{
+		const size_t size = ZSTD_decompress(destination, chunk.uncompressedSize, source, chunk.compressedSize);
+		return !ZSTD_isError(size) && size == chunk.uncompressedSize;
+	}
+	}
+
+	return false;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "AssetManager/AssetDependencyGraph.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr uint32_t PACK_MAGIC = 0x4B415056; // "VPAK"
+constexpr uint32_t PACK_VERSION = 2;
+
+// The pack of an import directory sits next to it (Data/Import -> Data/Import.pak)
+constexpr const char* PACK_FILE_EXTENSION = ".pak";
+
+// Every asset is split in chunks of this size so they can be decompressed by multiple workers at once
+constexpr uint32_t PACK_CHUNK_SIZE = 256 * 1024;
+
+enum class EPackCodec : uint32_t
+{
+	// Used when compression doesn't save anything (already compressed images, tiny files)
+	Raw,
+	// Fast decompression, default for runtime packs
+	LZ4,
+	// Better ratio, slower to decompress, meant for install size sensitive packs
+	Zstd
+};
+
+struct PackChunk
+{
+	uint64_t offset = 0;
+	uint32_t compressedSize = 0;
+	uint32_t uncompressedSize = 0;
+	EPackCodec codec = EPackCodec::Raw;
+};
+
+struct PackEntry
+{
+	// Same key format the asset manager uses (Textures\\Floor)
+	std::string name;
+	std::string extension;
+	uint64_t uncompressedSize = 0;
+	uint32_t firstChunk = 0;
+	uint32_t chunkCount = 0;
+};
+
+struct PackSource
+{
+	std::string name;
+	std::string extension;
+	std::string fullPath;
+};
+
+/// <summary>
+/// Read only archive of cooked assets. Layout on disk:
+/// [PackHeader][chunk data...][entry table][chunk table][dependency graph]
+/// The chunks of an entry are stored contiguously, so an asset is fetched with one read and then
+/// the chunks are decompressed in parallel directly into the destination memory.
+/// </summary>
+class AssetPack
+{
+public:
+	bool Mount(const std::string& inPackPath);
+
+	const std::vector<PackEntry>& GetEntries() const { return entries; }
+	const std::string& GetPackPath() const { return packPath; }
+	const AssetDependencyGraph& GetDependencies() const { return dependencies; }
+
+	/**
+	 * Decompresses the whole entry into destination. The destination must be at least uncompressedSize bytes
+	 * and can be any CPU visible memory, including a mapped staging buffer.
+	 */
+	bool ReadEntry(uint32_t entryIndex, void* destination, size_t destinationSize) const;
+	bool ReadEntry(uint32_t entryIndex, std::vector<uint8_t>& outData) const;
+
+	static bool Build(const std::vector<PackSource>& sources, const AssetDependencyGraph& dependencies, const std::string& outPackPath, EPackCodec codec = EPackCodec::LZ4);
+
+private:
+	// Checks the entry's chunks exist and decompress to exactly uncompressedSize bytes
+	bool IsEntryValid(const PackEntry& entry) const;
+
+	static bool CompressChunk(const uint8_t* source, uint32_t sourceSize, EPackCodec codec, std::vector<uint8_t>& outData, EPackCodec& outCodec);
+	static bool DecompressChunk(const uint8_t* source, const PackChunk& chunk, uint8_t* destination);
+
+	std::string packPath;
+	std::vector<PackEntry> entries;
+	std::vector<PackChunk> chunks;
+	AssetDependencyGraph dependencies;
+};
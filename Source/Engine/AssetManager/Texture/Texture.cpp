@@ -9,7 +9,16 @@ bool Texture::LoadAsset(const std::string& path)
 	return ImageImporter::ImportTexture(path, data, renderData);
 }
 
+bool Texture::LoadAssetFromMemory(const std::vector<uint8_t>& fileData, const std::string& extension)
+{
+	renderData.state = ERenderDataLoadState::Loading;
+	return ImageImporter::ImportTexture(fileData, data, renderData);
+}
+
 void Texture::UnloadAsset()
 {
 	GameEngine->GetRenderingSystem()->DestroyTexture(renderData.texture);
+
+	data = TextureData{};
+	renderData = TextureRenderData{};
 }
@@ -8,6 +8,7 @@ class Texture : public Asset
 {
 public:
 	virtual bool LoadAsset(const std::string& path) override;
+	virtual bool LoadAssetFromMemory(const std::vector<uint8_t>& data, const std::string& extension) override;
 	virtual void UnloadAsset() override;
 
 	const TextureData& GetData() const { return data; }
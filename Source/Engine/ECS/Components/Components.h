@@ -32,6 +32,8 @@ struct Transform
 struct ModelComponent
 {
 	uint32_t handle = 0;
+	// Picked by the renderer each frame, kept between frames for the hysteresis
+	uint32_t lodIndex = 0;
 };
 
 struct Light
@@ -15,7 +15,7 @@ AnimationSystem::~AnimationSystem()
 	free(buffer);
 }
 
-AnimatorComponent AnimationSystem::CreateAnimator(uint32_t skeletonHandle, const std::vector<std::string>& animations)
+AnimatorComponent AnimationSystem::CreateAnimator(uint32_t skeletonHandle, const std::vector<uint32_t>& animationHandles)
 {
 	uint32_t handle = GenerateHandle();
 
@@ -28,11 +28,18 @@ AnimatorComponent AnimationSystem::CreateAnimator(uint32_t skeletonHandle, const
 	animator->Initialize();
 	animator->SetSkeleton(skeleton);
 
-	for (const std::string& animation : animations)
+	for (uint32_t animationHandle : animationHandles)
 	{
+		std::vector<uint8_t> data;
+		std::string extension;
+		if (!assetManager.ReadAssetData(animationHandle, data, extension))
+		{
+			continue;
+		}
+
 		AnimationInstance instance{};
 		instance.skeleton = skeleton;
-		MeshImporter::ImportAnimation(animation, skeletonData, instance.animationData);
+		MeshImporter::ImportAnimation(data, extension, skeletonData, instance.animationData);
 
 		animator->AddAnimation(instance);
 	}
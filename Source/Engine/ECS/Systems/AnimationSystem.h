@@ -17,7 +17,8 @@ public:
 	//I know I'm not following the rule of 5 here, but this works more like a helper class than an object
 	~AnimationSystem();
 
-	AnimatorComponent CreateAnimator(uint32_t skeletonHandle, const std::vector<std::string>& animations);
+	// The animations are asset handles so the clips can come from the asset packs and bundle prefetches
+	AnimatorComponent CreateAnimator(uint32_t skeletonHandle, const std::vector<uint32_t>& animationHandles);
 
 	void Run(uint32_t handle, float deltaTime);
 	void GatherDrawData(uint32_t handle, uint32_t entityIndex, uint32_t frameIndex);
@@ -6,16 +6,19 @@
 #include "Engine.h"
 #include "Rendering/AbstractData.h"
 #include "Rendering/Descriptors/DescriptorInfo.h"
+#include "Rendering/Descriptors/DescriptorRegistry.h"
 #include "Rendering/Descriptors/Semantics.h"
 #include "Rendering/RenderingInterface.h"
 
+#include <algorithm>
 #include <glm/glm.hpp>
+#include <iostream>
 
 void MaterialSystem::ReleaseResources()
 {
-	for (const auto& it : materialInstances)
+	for (const MaterialInstance& instance : materialInstances)
 	{
-		for (const MaterialDescriptorBindingResource& resource : it.second.key.resources)
+		for (const MaterialDescriptorBindingResource& resource : instance.key.resources)
 		{
 			AssetManager::Get().ReleaseAsset(resource.textureAssetHandle);
 		}
@@ -52,94 +55,169 @@ Material MaterialSystem::CreatePBRMaterial(std::optional<uint32_t> albedo, bool
 		}
 	}
 
-	uint32_t value = materialHandleTracker++;
-	materialHandles[key] = value;
+	// The handle is the material's index in the material buffer
+	if (materialInstances.size() >= MAX_MATERIALS)
+	{
+		std::cerr << "Failed to create material, the material buffer is full!" << std::endl;
+		return Material{ static_cast<uint8_t>(key.pipeline), 0 };
+	}
+
+	// Unique materials can be edited, they are never handed out to other users of the key
+	uint32_t value = static_cast<uint32_t>(materialInstances.size());
+	if (!makeUnique)
+	{
+		materialHandles[key] = value;
+	}
 
-	MaterialInstance instance{};
+	MaterialInstance& instance = materialInstances.emplace_back();
 	instance.key = key;
 	instance.state = ERenderDataLoadState::Ready;
+	materialPipelines.push_back(key.pipeline);
 
-	RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
+	const Texture* texture = assetManager.LoadAsset<Texture>(albedo.value());
+	AcquireTextureIndex(albedo.value(), texture);
+
+	WriteMaterial(value, instance);
+
+	return Material{ static_cast<uint8_t>(key.pipeline), value };
+}
+
+const MaterialInstance* MaterialSystem::TryGetMaterialInstance(uint32_t handle) const
+{
+	return handle < materialInstances.size() ? &materialInstances[handle] : nullptr;
+}
+
+void MaterialSystem::SetParameters(uint32_t handle, const MaterialParameters& parameters)
+{
+	if (handle < materialInstances.size())
+	{
+		materialInstances[handle].parameters = parameters;
+		WriteMaterial(handle, materialInstances[handle]);
+	}
+}
 
-	DescriptorSetLayoutInfo layoutInfo;
-	if (renderingInterface->TryGetDescriptorLayoutForOwner(EPipelineType::PBR, EDescriptorOwner::Material, layoutInfo))
+void MaterialSystem::FlushMaterials(uint32_t frame)
+{
+	// The frame's set isn't read anymore, the reloaded textures' slots can be rewritten
+	for (uint32_t textureHandle : pendingTextureRefreshes[frame])
 	{
-		renderingInterface->CreateDescriptorSet(layoutInfo, instance.descriptorSet);
+		auto it = bindlessTextures.find(textureHandle);
+		if (it != bindlessTextures.end())
+		{
+			WriteTextureSlot(frame, it->second, AssetManager::Get().LoadAsset<Texture>(textureHandle));
+		}
 	}
-	else
+	pendingTextureRefreshes[frame].clear();
+
+	DirtyRange& range = dirtyRanges[frame];
+	if (range.begin >= range.end)
 	{
-		throw std::runtime_error("Could not find descriptor layout, either the pipeline is wrong or the descriptor layout was not created!");
+		return;
 	}
-	// Need to update the texture in the material after creating the sets
 
-	const Texture* texture = assetManager.LoadAsset<Texture>(albedo.value());
-	const TextureRenderData& renderData = texture->GetRenderData();
+	// The frame's fence was waited on, its copy isn't read anymore
+	RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
+	renderingInterface->UpdateBuffer(renderingInterface->GetDescriptorRegistry()->GetMaterialBuffer(),
+		MATERIAL_BUFFER_FRAME_SIZE * frame + sizeof(MaterialBufferLayout) * range.begin,
+		sizeof(MaterialBufferLayout) * (range.end - range.begin),
+		&materialData[range.begin]);
 
-	DescriptorDataProvider albedoProvider{};
-	// TODO maybe have a better way to set the descriptor set index?
-	albedoProvider.descriptorSet = instance.descriptorSet;
-	albedoProvider.providerType = EDescriptorDataProviderType::Texture;
-	albedoProvider.texture = renderData.texture;
+	range = DirtyRange{};
+}
 
-	std::unordered_map<EngineName, DescriptorDataProvider> providers =
+void MaterialSystem::RefreshTexture(uint32_t textureHandle)
+{
+	if (bindlessTextures.find(textureHandle) == bindlessTextures.end())
 	{
-		std::make_pair(Semantics::AlbedoSampler, albedoProvider)
-	};
-	renderingInterface->UpdateDescriptorSet(instance.key.pipeline, providers);
-
-	materialInstances[value] = instance;
+		return;
+	}
 
-	return Material{ static_cast<uint8_t>(key.pipeline), value };
+	// The slot is read by the frames in flight, each frame's set is rewritten once that frame is done
+	for (std::vector<uint32_t>& refreshes : pendingTextureRefreshes)
+	{
+		if (std::find(refreshes.begin(), refreshes.end(), textureHandle) == refreshes.end())
+		{
+			refreshes.push_back(textureHandle);
+		}
+	}
 }
 
-bool MaterialSystem::TryGetMaterialInstance(uint32_t handle, MaterialInstance& outInstance) const
+uint32_t MaterialSystem::AcquireTextureIndex(uint32_t textureHandle, const Texture* texture)
 {
-	auto it = materialInstances.find(handle);
-	if (it != materialInstances.end())
+	auto it = bindlessTextures.find(textureHandle);
+	if (it != bindlessTextures.end())
 	{
-		outInstance = it->second;
-		return true;
+		return it->second;
 	}
-	return false;
+
+	if (textureIndexTracker >= MAX_BINDLESS_TEXTURES)
+	{
+		// Falls back to the first texture registered, the engine's default albedo
+		std::cerr << "Failed to register bindless texture, the texture array is full!" << std::endl;
+		return 0;
+	}
+
+	const uint32_t index = textureIndexTracker++;
+	bindlessTextures[textureHandle] = index;
+
+	// New slots aren't read by the frames in flight, they can be written right away
+	WriteTextureSlot(index, texture);
+
+	return index;
 }
 
-void MaterialSystem::SetTextures(uint32_t handle, const std::vector<MaterialDescriptorBindingResource>& resources)
+void MaterialSystem::WriteMaterial(uint32_t handle, const MaterialInstance& instance)
 {
-	auto it = materialInstances.find(handle);
-	if (it != materialInstances.end())
+	if (handle >= materialData.size())
 	{
-		MaterialInstance& instance = it->second;
-		AssetManager& assetManager = AssetManager::Get();
+		materialData.resize(handle + 1);
+	}
 
-		std::unordered_map<EngineName, DescriptorDataProvider> providers{};
+	MaterialBufferLayout& layout = materialData[handle];
+	layout.baseColor = instance.parameters.baseColor;
+	layout.factors = glm::vec4(instance.parameters.specularStrength, instance.parameters.shininess, 0.0f, 0.0f);
+	layout.textures = glm::uvec4(0);
 
-		for (const MaterialDescriptorBindingResource& resource : resources)
+	for (const MaterialDescriptorBindingResource& resource : instance.key.resources)
+	{
+		auto it = bindlessTextures.find(resource.textureAssetHandle);
+		if (it == bindlessTextures.end())
 		{
-			const Texture* texture = assetManager.LoadAsset<Texture>(resource.textureAssetHandle);
-			const TextureRenderData& renderData = texture->GetRenderData();
-
-			DescriptorDataProvider provider{};
-			// TODO maybe have a better way to set the descriptor set index?
-			provider.descriptorSet = instance.descriptorSet;
-			provider.providerType = EDescriptorDataProviderType::Texture;
-			provider.texture = renderData.texture;
-
-			providers[resource.semantic] = provider;
-
-			// Update the texture ref and release the previous texture
-			// TODO A material can have max 4 - 6 resources, so this for is not that bad, but maybe test with a map?
-			for (MaterialDescriptorBindingResource& currentResource : instance.key.resources)
-			{
-				if (currentResource.semantic == resource.semantic)
-				{
-					assetManager.ReleaseAsset(currentResource.textureAssetHandle);
-					currentResource.textureAssetHandle = resource.textureAssetHandle;
-					break;
-				}
-			}
+			continue;
 		}
 
-		RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
-		renderingInterface->UpdateDescriptorSet(instance.key.pipeline, providers);
+		if (resource.semantic == Semantics::AlbedoSampler)
+		{
+			layout.textures.x = it->second;
+		}
 	}
+
+	for (DirtyRange& range : dirtyRanges)
+	{
+		if (range.begin >= range.end)
+		{
+			range = DirtyRange{ handle, handle + 1 };
+		}
+		else
+		{
+			range.begin = std::min(range.begin, handle);
+			range.end = std::max(range.end, handle + 1);
+		}
+	}
+}
+
+void MaterialSystem::WriteTextureSlot(uint32_t index, const Texture* texture)
+{
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		WriteTextureSlot(i, index, texture);
+	}
+}
+
+void MaterialSystem::WriteTextureSlot(uint32_t frame, uint32_t index, const Texture* texture)
+{
+	RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
+	const DescriptorRegistry* registry = renderingInterface->GetDescriptorRegistry();
+
+	renderingInterface->UpdateBindlessTexture(registry->GetMaterialDescriptorSet(frame), 1, index, texture->GetRenderData().texture);
 }
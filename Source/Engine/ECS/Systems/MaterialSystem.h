@@ -3,9 +3,13 @@
 #include "Rendering/AbstractData.h"
 #include "Rendering/Material/Material.h"
 
+#include <array>
 #include <cstdint>
 #include <optional>
 #include <unordered_map>
+#include <vector>
+
+class Texture;
 
 struct EngineName;
 struct Material;
@@ -17,12 +21,52 @@ public:
 
 	Material CreatePBRMaterial(std::optional<uint32_t> albedo = std::nullopt, bool makeUnique = false);
 
-	bool TryGetMaterialInstance(uint32_t handle, MaterialInstance& outInstance) const;
+	// The pointer is valid until the next material is created, the handle is what should be kept
+	const MaterialInstance* TryGetMaterialInstance(uint32_t handle) const;
+
+	// Hot data read by the renderer for every draw, a material's handle is also its index in the material buffer.
+	// Unknown handles fall back to the PBR pipeline, like TryGetMaterialInstance returns null for them
+	EPipelineType GetPipeline(uint32_t handle) const { return handle < materialPipelines.size() ? materialPipelines[handle] : EPipelineType::PBR; }
+
+	// Affects every user of the material, meant for unique ones. Textures change by swapping in another material
+	void SetParameters(uint32_t handle, const MaterialParameters& parameters);
 
-	void SetTextures(uint32_t handle, const std::vector<MaterialDescriptorBindingResource>& resources);
+	// Uploads the materials changed since the frame's copy of the material buffer was last written.
+	// Called once the frame's fence was waited on, the reloaded textures' slots are rewritten in its set
+	void FlushMaterials(uint32_t frame);
+
+	// Rewrites the texture's bindless slot, used when the texture was reloaded. Each frame's set is rewritten by its next flush
+	void RefreshTexture(uint32_t textureHandle);
 
 private:
-	std::unordered_map<uint32_t, MaterialInstance> materialInstances;
+	// The bindless slots are shared by the materials using the same texture. Materials are never destroyed, neither are
+	// their slots
+	uint32_t AcquireTextureIndex(uint32_t textureHandle, const Texture* texture);
+
+	// Writes the material's entry in the CPU copy of the material buffer, uploaded by the next flush of each frame
+	void WriteMaterial(uint32_t handle, const MaterialInstance& instance);
+	void WriteTextureSlot(uint32_t index, const Texture* texture);
+	void WriteTextureSlot(uint32_t frame, uint32_t index, const Texture* texture);
+
+	// Bindless slot by texture asset handle
+	std::unordered_map<uint32_t, uint32_t> bindlessTextures;
+	uint32_t textureIndexTracker = 0;
+
+	// Reloaded textures whose slot still points to the old image in the frame's set
+	std::array<std::vector<uint32_t>, MAX_FRAMES_IN_FLIGHT> pendingTextureRefreshes;
+
+	struct DirtyRange
+	{
+		uint32_t begin = 0;
+		uint32_t end = 0;
+	};
+
+	std::vector<MaterialBufferLayout> materialData;
+	// Materials each frame's copy is missing, the ranges only grow until the frame flushes them
+	std::array<DirtyRange, MAX_FRAMES_IN_FLIGHT> dirtyRanges;
+
+	// Dense, indexed by the material handle. The pipelines are kept apart from the cold instance data
+	std::vector<MaterialInstance> materialInstances;
+	std::vector<EPipelineType> materialPipelines;
 	std::unordered_map<MaterialInstanceKey, uint32_t> materialHandles;
-	uint32_t materialHandleTracker = 0;
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Rendering/Vulkan/VulkanRendering.h"
 #include "SDLInterface.h"
 #include "TaskManager.h"
+#include "Utilities/AsyncFileIO.h"
 #include "World/World.h"
 
 #include <SDL3/SDL.h>
@@ -36,6 +37,10 @@ bool Engine::Initialize()
 	assetManager.ImportAssets();
 	assetManager.ImportEngineAssets();
 
+#if WITH_EDITOR
+	assetManager.StartHotReload();
+#endif
+
 	InitializeECSSystems();
 
 	const bool success = sdlInterface->Initialize() &&
@@ -94,6 +99,10 @@ void Engine::Run()
 		// Input
 		inputSystem->RunEvents();
 
+		// Async reads that finished since the last frame
+		AsyncFileIO::Get().DispatchCompletions();
+		AssetManager::Get().DispatchBundles();
+
 		//Tick
 		TaskManager::Get().ExecuteTasks(TICK_HANDLE, deltaTime);
 
@@ -101,6 +110,11 @@ void Engine::Run()
 		renderingInterface->DrawFrame();
 		renderingInterface->EndFrame();
 
+#if WITH_EDITOR
+		// Between frames so the swapped resources are never half recorded
+		AssetManager::Get().ProcessHotReload();
+#endif
+
 		const uint64_t frameDuration = SDL_GetTicks() - frameStart;
 
 		// TODO maybe move this to a different thread?
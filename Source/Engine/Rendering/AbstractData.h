@@ -26,7 +26,25 @@ enum class EPipelineType : uint8_t
 	Debug,
 	ShadowMap,
 	ShadowMapDebug,
-	CascadeVisualizer
+	CascadeVisualizer,
+	PBRSkinned,
+	ShadowMapSkinned,
+	DepthPrePass,
+	DepthPrePassSkinned
+};
+
+enum class EVertexLayout : uint8_t
+{
+	Static,
+	Skinned
+};
+
+enum class EShadowQuality : uint8_t
+{
+	Low,
+	Medium,
+	High,
+	Ultra
 };
 
 struct AllocatedBuffer
@@ -43,10 +61,16 @@ struct AllocatedTexture
 	GenericHandle memory;
 };
 
+// Ranges of a mesh in the shared geometry pool. The position (+ skinning) and the normal, tangent and uv streams
+// start at the same vertex of the layout's buffers, the depth only passes bind the position buffer alone
 struct MeshRenderData
 {
-	AllocatedBuffer vertex;
-	AllocatedBuffer index;
+	EVertexLayout layout = EVertexLayout::Static;
+	uint32_t baseVertex = 0;
+	uint32_t vertexCount = 0;
+	// In bytes, the submeshes' index byte offsets are relative to it
+	uint32_t indexOffset = 0;
+	uint32_t indexSize = 0;
 	ERenderDataLoadState state = ERenderDataLoadState::Uninitialized;
 };
 
@@ -0,0 +1,9 @@
+#pragma once
+
+// The culling loops test 4 bounds per SSE instruction, targets without SSE use the scalar fallbacks
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CULLING_USE_SSE 1
+#include <xmmintrin.h>
+#else
+#define CULLING_USE_SSE 0
+#endif
@@ -0,0 +1,35 @@
+#include "Frustum.h"
+
+Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection)
+{
+	const glm::mat4 rows = glm::transpose(viewProjection);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	// The depth goes from 0 to 1
+	frustum.planes[4] = rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+Frustum Frustum::ToLocalSpace(const glm::mat4& model) const
+{
+	const glm::mat4 transposedModel = glm::transpose(model);
+
+	Frustum frustum;
+	for (size_t i = 0; i < planes.size(); ++i)
+	{
+		frustum.planes[i] = transposedModel * planes[i];
+	}
+
+	return frustum;
+}
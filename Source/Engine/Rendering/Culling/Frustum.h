@@ -0,0 +1,17 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+
+/// <summary>
+/// The 6 planes of a view projection, the normals (xyz) point inside and w is the distance.
+/// </summary>
+struct Frustum
+{
+	static Frustum FromViewProjection(const glm::mat4& viewProjection);
+
+	// Moves the planes to a model's local space. The planes aren't renormalized so the distances stay in world units
+	Frustum ToLocalSpace(const glm::mat4& model) const;
+
+	std::array<glm::vec4, 6> planes;
+};
@@ -0,0 +1,111 @@
+#include "FrustumCulling.h"
+#include "CullingSimd.h"
+#include "Frustum.h"
+
+#include <cmath>
+
+void BoundingBoxes::Resize(uint32_t count)
+{
+	const uint32_t paddedCount = (count + 3) & ~3u;
+	centerX.resize(paddedCount);
+	centerY.resize(paddedCount);
+	centerZ.resize(paddedCount);
+	extentX.resize(paddedCount);
+	extentY.resize(paddedCount);
+	extentZ.resize(paddedCount);
+}
+
+void FrustumCulling::ComputeWorldBounds(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& model, BoundingBoxes& boxes, uint32_t index)
+{
+	const glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+	const glm::vec3 localExtent = (localMax - localMin) * 0.5f;
+
+	// The extent of the rotated box is the extent projected on the absolute value of each axis
+	const glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+	const glm::vec3 extent = absolute * localExtent;
+
+	boxes.centerX[index] = center.x;
+	boxes.centerY[index] = center.y;
+	boxes.centerZ[index] = center.z;
+	boxes.extentX[index] = extent.x;
+	boxes.extentY[index] = extent.y;
+	boxes.extentZ[index] = extent.z;
+}
+
+uint32_t FrustumCulling::CullBoxes(const BoundingBoxes& boxes, uint32_t first, uint32_t count, const Frustum& frustum, uint8_t* outVisibility)
+{
+	uint32_t visibleCount = 0;
+
+#if CULLING_USE_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 allVisible = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+
+	for (uint32_t i = 0; i < count; i += 4)
+	{
+		const uint32_t index = first + i;
+		const __m128 centerX = _mm_loadu_ps(&boxes.centerX[index]);
+		const __m128 centerY = _mm_loadu_ps(&boxes.centerY[index]);
+		const __m128 centerZ = _mm_loadu_ps(&boxes.centerZ[index]);
+		const __m128 extentX = _mm_loadu_ps(&boxes.extentX[index]);
+		const __m128 extentY = _mm_loadu_ps(&boxes.extentY[index]);
+		const __m128 extentZ = _mm_loadu_ps(&boxes.extentZ[index]);
+
+		__m128 visible = allVisible;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const __m128 planeX = _mm_set1_ps(plane.x);
+			const __m128 planeY = _mm_set1_ps(plane.y);
+			const __m128 planeZ = _mm_set1_ps(plane.z);
+
+			__m128 distance = _mm_mul_ps(centerX, planeX);
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerY, planeY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, planeZ));
+			distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+
+			// The box's projected radius on the plane normal
+			__m128 radius = _mm_mul_ps(extentX, _mm_andnot_ps(signMask, planeX));
+			radius = _mm_add_ps(radius, _mm_mul_ps(extentY, _mm_andnot_ps(signMask, planeY)));
+			radius = _mm_add_ps(radius, _mm_mul_ps(extentZ, _mm_andnot_ps(signMask, planeZ)));
+
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+		}
+
+		const int32_t mask = _mm_movemask_ps(visible);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			outVisibility[i + lane] = (mask >> lane) & 1;
+		}
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		visibleCount += outVisibility[i];
+	}
+#else
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		outVisibility[i] = IsBoxVisible(boxes, first + i, frustum);
+		visibleCount += outVisibility[i];
+	}
+#endif
+
+	return visibleCount;
+}
+
+bool FrustumCulling::IsBoxVisible(const BoundingBoxes& boxes, uint32_t index, const Frustum& frustum)
+{
+	const glm::vec3 center = glm::vec3(boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]);
+	const glm::vec3 extent = glm::vec3(boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]);
+
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		const glm::vec3 normal = glm::vec3(plane);
+		if (glm::dot(normal, center) + plane.w < -glm::dot(glm::abs(normal), extent))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
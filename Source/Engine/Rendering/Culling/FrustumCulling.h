@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Frustum;
+
+// Entities culled by a single job, a multiple of 4 so the jobs never write to the same SIMD group
+constexpr uint32_t CULLING_CHUNK_SIZE = 1024;
+
+/// <summary>
+/// World space AABBs in SoA, padded to a multiple of 4.
+/// </summary>
+struct BoundingBoxes
+{
+	void Resize(uint32_t count);
+
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+};
+
+/// <summary>
+/// Frustum test of the entities' world bounds, 4 boxes per SSE instruction.
+/// </summary>
+class FrustumCulling
+{
+public:
+	// Transforms a local AABB and stores the AABB enclosing it at index
+	static void ComputeWorldBounds(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& model, BoundingBoxes& boxes, uint32_t index);
+
+	// Tests the boxes [first, first + count), first has to be a multiple of 4. outVisibility is written for the whole
+	// SIMD groups so it needs to be padded like the boxes. Returns how many boxes are visible
+	static uint32_t CullBoxes(const BoundingBoxes& boxes, uint32_t first, uint32_t count, const Frustum& frustum, uint8_t* outVisibility);
+
+private:
+	static bool IsBoxVisible(const BoundingBoxes& boxes, uint32_t index, const Frustum& frustum);
+};
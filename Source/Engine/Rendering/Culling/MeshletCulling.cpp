@@ -0,0 +1,113 @@
+#include "MeshletCulling.h"
+#include "AssetManager/Model/MeshData.h"
+#include "CullingSimd.h"
+#include "Frustum.h"
+
+#include <cmath>
+
+uint32_t MeshletCulling::CullMeshlets(const MeshletBounds& bounds,
+	uint32_t meshletCount,
+	const Frustum& localFrustum,
+	float radiusScale,
+	const glm::vec3& localCameraPosition,
+	bool useConeCulling,
+	std::vector<uint8_t>& outVisibility)
+{
+	// Padded to 4 so the SIMD loop can write whole groups
+	outVisibility.resize((meshletCount + 3) & ~3u);
+
+	uint32_t visibleCount = 0;
+
+#if CULLING_USE_SSE
+	const __m128 scale = _mm_set1_ps(radiusScale);
+	const __m128 cameraX = _mm_set1_ps(localCameraPosition.x);
+	const __m128 cameraY = _mm_set1_ps(localCameraPosition.y);
+	const __m128 cameraZ = _mm_set1_ps(localCameraPosition.z);
+	const __m128 allVisible = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+
+	// The bounds are padded to a multiple of 4
+	for (uint32_t i = 0; i < meshletCount; i += 4)
+	{
+		const __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+		const __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+		const __m128 radius = _mm_loadu_ps(&bounds.radius[i]);
+		const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(radius, scale));
+
+		__m128 visible = allVisible;
+		for (const glm::vec4& plane : localFrustum.planes)
+		{
+			__m128 distance = _mm_mul_ps(centerX, _mm_set1_ps(plane.x));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerY, _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, _mm_set1_ps(plane.z)));
+			distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		if (useConeCulling)
+		{
+			const __m128 toCenterX = _mm_sub_ps(centerX, cameraX);
+			const __m128 toCenterY = _mm_sub_ps(centerY, cameraY);
+			const __m128 toCenterZ = _mm_sub_ps(centerZ, cameraZ);
+
+			__m128 lengthSquared = _mm_mul_ps(toCenterX, toCenterX);
+			lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(toCenterY, toCenterY));
+			lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(toCenterZ, toCenterZ));
+
+			__m128 alongAxis = _mm_mul_ps(toCenterX, _mm_loadu_ps(&bounds.coneAxisX[i]));
+			alongAxis = _mm_add_ps(alongAxis, _mm_mul_ps(toCenterY, _mm_loadu_ps(&bounds.coneAxisY[i])));
+			alongAxis = _mm_add_ps(alongAxis, _mm_mul_ps(toCenterZ, _mm_loadu_ps(&bounds.coneAxisZ[i])));
+
+			// Back facing when dot(center - camera, axis) >= cutoff * |center - camera| + radius
+			const __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&bounds.coneCutoff[i]), _mm_sqrt_ps(lengthSquared)), radius);
+			visible = _mm_and_ps(visible, _mm_cmplt_ps(alongAxis, limit));
+		}
+
+		const int32_t mask = _mm_movemask_ps(visible);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			outVisibility[i + lane] = (mask >> lane) & 1;
+		}
+	}
+
+	for (uint32_t i = 0; i < meshletCount; ++i)
+	{
+		visibleCount += outVisibility[i];
+	}
+#else
+	for (uint32_t i = 0; i < meshletCount; ++i)
+	{
+		outVisibility[i] = IsMeshletVisible(bounds, i, localFrustum, radiusScale, localCameraPosition, useConeCulling);
+		visibleCount += outVisibility[i];
+	}
+#endif
+
+	return visibleCount;
+}
+
+bool MeshletCulling::IsMeshletVisible(const MeshletBounds& bounds, uint32_t index, const Frustum& localFrustum, float radiusScale, const glm::vec3& localCameraPosition, bool useConeCulling)
+{
+	const glm::vec3 center = glm::vec3(bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index]);
+	const float radius = bounds.radius[index];
+
+	for (const glm::vec4& plane : localFrustum.planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * radiusScale)
+		{
+			return false;
+		}
+	}
+
+	if (useConeCulling)
+	{
+		const glm::vec3 toCenter = center - localCameraPosition;
+		const glm::vec3 axis = glm::vec3(bounds.coneAxisX[index], bounds.coneAxisY[index], bounds.coneAxisZ[index]);
+		if (glm::dot(toCenter, axis) >= bounds.coneCutoff[index] * glm::length(toCenter) + radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Frustum;
+struct MeshletBounds;
+
+/// <summary>
+/// CPU culling of the meshlets against the frustum and by their normal cones, 4 meshlets per SSE instruction.
+/// Doesn't touch the renderer so it can run headless.
+/// </summary>
+class MeshletCulling
+{
+public:
+	// The frustum is in the model's local space (Frustum::ToLocalSpace) and radiusScale is the model's largest scale.
+	// The cone test is only valid when the model scales uniformly. Returns how many meshlets are visible
+	static uint32_t CullMeshlets(const MeshletBounds& bounds,
+		uint32_t meshletCount,
+		const Frustum& localFrustum,
+		float radiusScale,
+		const glm::vec3& localCameraPosition,
+		bool useConeCulling,
+		std::vector<uint8_t>& outVisibility);
+
+private:
+	static bool IsMeshletVisible(const MeshletBounds& bounds, uint32_t index, const Frustum& localFrustum, float radiusScale, const glm::vec3& localCameraPosition, bool useConeCulling);
+};
@@ -10,6 +10,7 @@
 constexpr uint32_t MATRICES_DESCRIPTOR_FLAG = 1 << 0;
 constexpr uint32_t LIGHT_DESCRIPTOR_FLAG = 1 << 1;
 constexpr uint32_t ANIMATION_DESCRIPTOR_FLAG = 1 << 2;
+constexpr uint32_t MATERIAL_DESCRIPTOR_FLAG = 1 << 3;
 
 enum class EDescriptorOwner : uint8_t
 {
@@ -27,6 +28,8 @@ struct DescriptorSetLayoutInfo
 	GenericHandle layout;
 	uint32_t setIndex = 0;
 	EDescriptorOwner owner = EDescriptorOwner::None;
+	// The sets are written after being bound and come from their own pool
+	bool updateAfterBind = false;
 };
 
 /// <summary>
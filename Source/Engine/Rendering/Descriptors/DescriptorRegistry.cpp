@@ -1,9 +1,12 @@
 #include "DescriptorRegistry.h"
 #include "AssetManager/Animation/AnimationData.h"
 #include "Camera/CameraMatrices.h"
+#include "Rendering/Light/ClusteredLighting.h"
 #include "Rendering/Light/Light.h"
 #include "Rendering/Light/Shadow.h"
 #include "Rendering/Light/ShadowData.h"
+#include "Rendering/Material/Material.h"
+#include "Rendering/Queue/InstanceData.h"
 #include "Rendering/RenderingInterface.h"
 
 DescriptorRegistry::DescriptorRegistry(RenderingInterface* inRenderingInterface)
@@ -11,47 +14,81 @@ DescriptorRegistry::DescriptorRegistry(RenderingInterface* inRenderingInterface)
 {
 }
 
-void DescriptorRegistry::Initialize()
+bool DescriptorRegistry::Initialize()
 {
-	if (renderingInterface)
+	if (renderingInterface == nullptr)
 	{
-		renderingInterface->CreateGlobalDescriptorLayouts(cameraMatricesLayout, lightLayout, animationLayout, shadowLayout);
+		return false;
+	}
+
+	renderingInterface->CreateGlobalDescriptorLayouts(cameraMatricesLayout, lightLayout, animationLayout, shadowLayout, materialLayout);
 
-		renderingInterface->CreateBuffer(EBufferType::Uniform, sizeof(CameraMatrices) * MAX_FRAMES_IN_FLIGHT, matriceBuffer);
-		renderingInterface->CreateBuffer(EBufferType::Storage, sizeof(LightBufferLayout) * MAX_LIGHTS, lightBuffer);
-		renderingInterface->CreateBuffer(EBufferType::Storage, sizeof(AnimationLayout) * MAX_ANIMATED_ENTITIES * MAX_FRAMES_IN_FLIGHT, animationBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Uniform, sizeof(CameraMatrices) * MAX_FRAMES_IN_FLIGHT, matriceBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Storage, INSTANCE_BUFFER_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT, instanceBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Storage, VISIBLE_INSTANCE_BUFFER_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT, visibleInstanceBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Storage, sizeof(LightBufferLayout) * MAX_LIGHTS, lightBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Storage, CLUSTER_BUFFER_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT, clusterBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Storage, sizeof(AnimationLayout) * MAX_ANIMATED_ENTITIES * MAX_FRAMES_IN_FLIGHT, animationBuffer);
 
-		renderingInterface->CreateBuffer(EBufferType::Uniform, sizeof(glm::mat4) * MAX_SM * MAX_FRAMES_IN_FLIGHT, lightSMBuffer);
-		renderingInterface->CreateBuffer(EBufferType::Uniform, sizeof(ShadowData), shadowDataBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Uniform, sizeof(glm::mat4) * MAX_SM * MAX_FRAMES_IN_FLIGHT, lightSMBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Uniform, sizeof(ShadowData), shadowDataBuffer);
+	renderingInterface->CreateBuffer(EBufferType::Storage, MATERIAL_BUFFER_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT, materialBuffer);
 
-		renderingInterface->CreateDescriptorSet(cameraMatricesLayout, cameraMatricesDescriptorSet);
-		renderingInterface->UpdateDescriptorSet(EDescriptorSetType::Uniform, cameraMatricesDescriptorSet, matriceBuffer);
+	// Every set is allocated before any is written, a set that failed can't be written
+	bool success = renderingInterface->CreateDescriptorSet(cameraMatricesLayout, cameraMatricesDescriptorSet);
+	success &= renderingInterface->CreateDescriptorSet(lightLayout, lightDescriptorSet);
+	success &= renderingInterface->CreateDescriptorSet(animationLayout, animationDescriptorSet);
+	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		success &= renderingInterface->CreateDescriptorSet(shadowLayout, shadowDescriptorSets[i]);
+		success &= renderingInterface->CreateDescriptorSet(materialLayout, materialDescriptorSets[i]);
+	}
+
+	if (!success)
+	{
+		return false;
+	}
 
-		renderingInterface->CreateDescriptorSet(lightLayout, lightDescriptorSet);
-		renderingInterface->UpdateDescriptorSet(EDescriptorSetType::Storage, lightDescriptorSet, lightBuffer);
+	renderingInterface->UpdateDescriptorSet(EDescriptorSetType::Uniform, cameraMatricesDescriptorSet, matriceBuffer);
+	renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::StorageDynamic, cameraMatricesDescriptorSet, instanceBuffer, 1, 0, INSTANCE_BUFFER_FRAME_SIZE);
+	renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::StorageDynamic, cameraMatricesDescriptorSet, visibleInstanceBuffer, 2, 0, VISIBLE_INSTANCE_BUFFER_FRAME_SIZE);
 
-		renderingInterface->CreateDescriptorSet(animationLayout, animationDescriptorSet);
-		renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::StorageDynamic, animationDescriptorSet, animationBuffer, 0, 0, sizeof(AnimationLayout) * MAX_ANIMATED_ENTITIES);
+	renderingInterface->UpdateDescriptorSet(EDescriptorSetType::Storage, lightDescriptorSet, lightBuffer);
+	renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::StorageDynamic, lightDescriptorSet, clusterBuffer, 1, 0, CLUSTER_BUFFER_FRAME_SIZE);
 
-		for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-		{
-			renderingInterface->CreateDescriptorSet(shadowLayout, shadowDescriptorSets[i]);
-			renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::UniformDynamic, shadowDescriptorSets[i], lightSMBuffer, 0, 0, sizeof(glm::mat4) * MAX_SM);
-			renderingInterface->UpdateDescriptorSet(EDescriptorSetType::Uniform, shadowDescriptorSets[i], shadowDataBuffer, 2);
-		}
+	renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::StorageDynamic, animationDescriptorSet, animationBuffer, 0, 0, sizeof(AnimationLayout) * MAX_ANIMATED_ENTITIES);
+
+	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::UniformDynamic, shadowDescriptorSets[i], lightSMBuffer, 0, 0, sizeof(glm::mat4) * MAX_SM);
+		renderingInterface->UpdateDescriptorSet(EDescriptorSetType::Uniform, shadowDescriptorSets[i], shadowDataBuffer, 2);
+	}
+
+	// The textures are written by the material system as the materials reference them.
+	// The set can be updated after bind so its buffer can't be dynamic, each frame gets a set on its copy instead
+	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		renderingInterface->UpdateDynamicDescriptorSet(EDescriptorSetType::Storage, materialDescriptorSets[i], materialBuffer, 0, MATERIAL_BUFFER_FRAME_SIZE * i, MATERIAL_BUFFER_FRAME_SIZE);
 	}
+
+	return true;
 }
 
 void DescriptorRegistry::UnInitialize()
 {
 	renderingInterface->DestroyBuffer(matriceBuffer);
+	renderingInterface->DestroyBuffer(instanceBuffer);
+	renderingInterface->DestroyBuffer(visibleInstanceBuffer);
 	renderingInterface->DestroyBuffer(lightBuffer);
+	renderingInterface->DestroyBuffer(clusterBuffer);
 	renderingInterface->DestroyBuffer(lightSMBuffer);
 	renderingInterface->DestroyBuffer(animationBuffer);
 	renderingInterface->DestroyBuffer(shadowDataBuffer);
+	renderingInterface->DestroyBuffer(materialBuffer);
 
 	renderingInterface->DestroyDescriptorSetLayout(lightLayout);
 	renderingInterface->DestroyDescriptorSetLayout(cameraMatricesLayout);
 	renderingInterface->DestroyDescriptorSetLayout(animationLayout);
 	renderingInterface->DestroyDescriptorSetLayout(shadowLayout);
+	renderingInterface->DestroyDescriptorSetLayout(materialLayout);
 }
@@ -12,24 +12,32 @@ class DescriptorRegistry
 public:
 	DescriptorRegistry(RenderingInterface* inRenderingInterface);
 
-	void Initialize();
+	// False when a set couldn't be allocated
+	bool Initialize();
 	void UnInitialize();
 
 	const DescriptorSetLayoutInfo& GetCameraMatricesLayout() const { return cameraMatricesLayout; }
 	const DescriptorSetLayoutInfo& GetLightLayout() const { return lightLayout; }
 	const DescriptorSetLayoutInfo& GetAnimationLayout() const { return animationLayout; }
 	const DescriptorSetLayoutInfo& GetShadowLayout() const { return shadowLayout; }
+	const DescriptorSetLayoutInfo& GetMaterialLayout() const { return materialLayout; }
 
 	AllocatedBuffer GetMatriceBuffer() const { return matriceBuffer; }
+	AllocatedBuffer GetInstanceBuffer() const { return instanceBuffer; }
+	AllocatedBuffer GetVisibleInstanceBuffer() const { return visibleInstanceBuffer; }
 	AllocatedBuffer GetLightBuffer() const { return lightBuffer; }
+	AllocatedBuffer GetClusterBuffer() const { return clusterBuffer; }
 	AllocatedBuffer GetAnimationBuffer() const { return animationBuffer; }
 	AllocatedBuffer GetLightSMBuffer() const { return lightSMBuffer; }
 	AllocatedBuffer GetShadowDataBuffer() const { return shadowDataBuffer; }
+	AllocatedBuffer GetMaterialBuffer() const { return materialBuffer; }
 
 	GenericHandle GetCameraMatricesDescriptorSet() const { return cameraMatricesDescriptorSet; }
 	GenericHandle GetLightDescriptorSet() const { return lightDescriptorSet; }
 	GenericHandle GetAnimationDescriptorSet() const { return animationDescriptorSet; }
 	GenericHandle GetShadowDescriptorSet(uint32_t index) const { return shadowDescriptorSets[index]; }
+	// Material buffer and bindless textures, shared by every material. One set per frame in flight
+	GenericHandle GetMaterialDescriptorSet(uint32_t index) const { return materialDescriptorSets[index]; }
 
 private:
 	RenderingInterface* renderingInterface = nullptr;
@@ -39,15 +47,21 @@ private:
 	GenericHandle animationDescriptorSet;
 
 	AllocatedBuffer lightBuffer;
+	AllocatedBuffer clusterBuffer;
 	AllocatedBuffer matriceBuffer;
+	AllocatedBuffer instanceBuffer;
+	AllocatedBuffer visibleInstanceBuffer;
 	AllocatedBuffer animationBuffer;
+	AllocatedBuffer materialBuffer;
 
 	AllocatedBuffer lightSMBuffer;
 	AllocatedBuffer shadowDataBuffer;
 	std::array<GenericHandle, MAX_FRAMES_IN_FLIGHT> shadowDescriptorSets;
+	std::array<GenericHandle, MAX_FRAMES_IN_FLIGHT> materialDescriptorSets;
 
 	DescriptorSetLayoutInfo cameraMatricesLayout;
 	DescriptorSetLayoutInfo animationLayout;
 	DescriptorSetLayoutInfo lightLayout;
 	DescriptorSetLayoutInfo shadowLayout;
+	DescriptorSetLayoutInfo materialLayout;
 };
\ No newline at end of file
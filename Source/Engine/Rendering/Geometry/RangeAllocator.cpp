@@ -0,0 +1,88 @@
+#include "RangeAllocator.h"
+
+#include <cassert>
+#include <iterator>
+
+void RangeAllocator::Initialize(uint32_t inCapacity)
+{
+	capacity = inCapacity;
+	used = 0;
+
+	freeRanges.clear();
+	if (capacity > 0)
+	{
+		freeRanges.emplace(0, capacity);
+	}
+}
+
+bool RangeAllocator::Allocate(uint32_t size, uint32_t alignment, uint32_t& outOffset)
+{
+	assert(alignment > 0);
+
+	if (size == 0)
+	{
+		outOffset = 0;
+		return true;
+	}
+
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		const uint64_t rangeStart = it->first;
+		const uint64_t rangeEnd = rangeStart + it->second;
+		const uint64_t alignedStart = (rangeStart + alignment - 1) / alignment * alignment;
+
+		if (alignedStart + size > rangeEnd)
+		{
+			continue;
+		}
+
+		// The padding before the aligned start stays free, the range's tail goes back to the list
+		freeRanges.erase(it);
+		if (alignedStart > rangeStart)
+		{
+			freeRanges.emplace(static_cast<uint32_t>(rangeStart), static_cast<uint32_t>(alignedStart - rangeStart));
+		}
+		if (alignedStart + size < rangeEnd)
+		{
+			freeRanges.emplace(static_cast<uint32_t>(alignedStart + size), static_cast<uint32_t>(rangeEnd - alignedStart - size));
+		}
+
+		used += size;
+		outOffset = static_cast<uint32_t>(alignedStart);
+		return true;
+	}
+
+	return false;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	assert(used >= size);
+	used -= size;
+
+	auto it = freeRanges.emplace(offset, size).first;
+
+	// Merge with the next free range
+	auto next = std::next(it);
+	if (next != freeRanges.end() && it->first + it->second == next->first)
+	{
+		it->second += next->second;
+		freeRanges.erase(next);
+	}
+
+	// And with the previous one
+	if (it != freeRanges.begin())
+	{
+		auto previous = std::prev(it);
+		if (previous->first + previous->second == it->first)
+		{
+			previous->second += it->second;
+			freeRanges.erase(it);
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+/// <summary>
+/// First fit allocator of the ranges of a fixed size buffer, a freed range is merged with its free neighbours.
+/// The unit is up to the owner, the geometry pool counts vertices for the vertex buffers and bytes for the index buffer.
+/// </summary>
+class RangeAllocator
+{
+public:
+	// Frees every range
+	void Initialize(uint32_t inCapacity);
+
+	// The offset is a multiple of alignment. Returns false when no free range is big enough
+	bool Allocate(uint32_t size, uint32_t alignment, uint32_t& outOffset);
+	// Takes back a range returned by Allocate, with the same size
+	void Free(uint32_t offset, uint32_t size);
+
+	uint32_t GetCapacity() const { return capacity; }
+	uint32_t GetUsed() const { return used; }
+
+private:
+	// Size of each free range, by offset
+	std::map<uint32_t, uint32_t> freeRanges;
+	uint32_t capacity = 0;
+	uint32_t used = 0;
+};
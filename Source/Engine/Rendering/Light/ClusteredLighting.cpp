@@ -0,0 +1,304 @@
+#include "ClusteredLighting.h"
+#include "Light.h"
+#include "Rendering/Culling/CullingSimd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <limits>
+
+constexpr uint32_t CLUSTER_TILE_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y;
+
+void ClusteredLighting::BeginLights()
+{
+	directionalLights.clear();
+	lightSpheres.clear();
+	lightHandles.clear();
+}
+
+void ClusteredLighting::AddLight(uint32_t handle, const LightInstance& light)
+{
+	if (light.type == static_cast<uint32_t>(ELightType::Directional))
+	{
+		directionalLights.push_back(handle);
+		return;
+	}
+
+	glm::vec4 sphere = glm::vec4(light.position, light.range);
+
+	// Bounding sphere of the cone, the same outer cone the shader fades the light with
+	const float outerAngle = glm::radians(light.angle + SPOT_LIGHT_OUTER_CUTOFF);
+	if (light.type == static_cast<uint32_t>(ELightType::Spot) && outerAngle < glm::half_pi<float>())
+	{
+		const glm::vec3 direction = glm::quat(glm::radians(light.eulers)) * WORLD_FORWARD;
+		const float cosAngle = std::cos(outerAngle);
+
+		if (outerAngle > glm::quarter_pi<float>())
+		{
+			sphere = glm::vec4(light.position + direction * light.range * cosAngle, light.range * std::sin(outerAngle));
+		}
+		else
+		{
+			const float radius = light.range / (2.0f * cosAngle);
+			sphere = glm::vec4(light.position + direction * radius, radius);
+		}
+	}
+
+	lightSpheres.push_back(sphere);
+	lightHandles.push_back(handle);
+}
+
+void ClusteredLighting::Build(const glm::mat4& projection, const glm::mat4& view, float nearView, float farView, uint32_t width, uint32_t height)
+{
+	if (projection != cachedProjection || width != cachedWidth || height != cachedHeight)
+	{
+		BuildClusterBounds(projection, nearView, farView, width, height);
+	}
+
+	// The padding never overlaps a slice since the slices start past the near plane
+	const uint32_t lightCount = static_cast<uint32_t>(lightSpheres.size());
+	const uint32_t paddedCount = (lightCount + 3) & ~3u;
+	centerX.assign(paddedCount, 0.0f);
+	centerY.assign(paddedCount, 0.0f);
+	centerZ.assign(paddedCount, 0.0f);
+	radius.assign(paddedCount, -1.0f);
+
+	for (uint32_t i = 0; i < lightCount; ++i)
+	{
+		const glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lightSpheres[i]), 1.0f));
+		centerX[i] = center.x;
+		centerY[i] = center.y;
+		centerZ[i] = center.z;
+		radius[i] = lightSpheres[i].w;
+	}
+
+	ThreadPool::Get().ParallelFor(CLUSTER_GRID_Z, [this](uint32_t slice)
+		{
+			BinSlice(slice);
+		});
+
+	const uint32_t directionalCount = static_cast<uint32_t>(std::min<size_t>(directionalLights.size(), CLUSTER_MAX_LIGHT_INDICES));
+	header.grid = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, directionalCount);
+
+	items.resize(CLUSTER_COUNT);
+	items.insert(items.end(), directionalLights.begin(), directionalLights.begin() + directionalCount);
+
+	// The slices are compacted in order so a cluster's lights are contiguous
+	constexpr uint32_t maxItems = CLUSTER_COUNT + CLUSTER_MAX_LIGHT_INDICES;
+	for (uint32_t slice = 0; slice < CLUSTER_GRID_Z; ++slice)
+	{
+		const SliceBins& bins = sliceBins[slice];
+
+		uint32_t read = 0;
+		for (uint32_t tile = 0; tile < CLUSTER_TILE_COUNT; ++tile)
+		{
+			const uint32_t count = bins.counts[tile];
+			const uint32_t offset = static_cast<uint32_t>(items.size());
+			const uint32_t stored = std::min(count, maxItems - offset);
+
+			items.insert(items.end(), bins.lights.begin() + read, bins.lights.begin() + read + stored);
+			items[slice * CLUSTER_TILE_COUNT + tile] = (offset << CLUSTER_LIGHT_COUNT_BITS) | stored;
+			read += count;
+		}
+	}
+}
+
+void ClusteredLighting::BuildClusterBounds(const glm::mat4& projection, float nearView, float farView, uint32_t width, uint32_t height)
+{
+	cachedProjection = projection;
+	cachedWidth = width;
+	cachedHeight = height;
+
+	const float tileWidth = std::ceil(static_cast<float>(width) / CLUSTER_GRID_X);
+	const float tileHeight = std::ceil(static_cast<float>(height) / CLUSTER_GRID_Y);
+
+	// slice = log(depth) * scale + bias, each slice covers the same depth ratio
+	const float logDepthRatio = std::log(farView / nearView);
+	const float sliceScale = CLUSTER_GRID_Z / logDepthRatio;
+	const float sliceBias = -CLUSTER_GRID_Z * std::log(nearView) / logDepthRatio;
+	header.tileAndSlices = glm::vec4(tileWidth, tileHeight, sliceScale, sliceBias);
+
+	for (uint32_t i = 0; i <= CLUSTER_GRID_Z; ++i)
+	{
+		sliceDepths[i] = nearView * std::pow(farView / nearView, static_cast<float>(i) / CLUSTER_GRID_Z);
+	}
+
+	const glm::mat4 inverseProjection = glm::inverse(projection);
+	auto Unproject = [&inverseProjection](float x, float y, float z)
+		{
+			const glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+			return glm::vec3(point) / point.w;
+		};
+
+	clusterBounds.resize(CLUSTER_COUNT);
+
+	const float screenWidth = static_cast<float>(width);
+	const float screenHeight = static_cast<float>(height);
+	for (uint32_t y = 0; y < CLUSTER_GRID_Y; ++y)
+	{
+		// gl_FragCoord counts the rows from the top and the viewport is flipped, so the first row is at NDC y = 1
+		const float top = 1.0f - std::min(y * tileHeight, screenHeight) / screenHeight * 2.0f;
+		const float bottom = 1.0f - std::min((y + 1) * tileHeight, screenHeight) / screenHeight * 2.0f;
+
+		for (uint32_t x = 0; x < CLUSTER_GRID_X; ++x)
+		{
+			const float left = std::min(x * tileWidth, screenWidth) / screenWidth * 2.0f - 1.0f;
+			const float right = std::min((x + 1) * tileWidth, screenWidth) / screenWidth * 2.0f - 1.0f;
+
+			// The tile's edges from the near to the far plane
+			const std::array<glm::vec3, 4> nearCorners =
+			{
+				Unproject(left, top, 0.0f), Unproject(right, top, 0.0f), Unproject(left, bottom, 0.0f), Unproject(right, bottom, 0.0f)
+			};
+			const std::array<glm::vec3, 4> farCorners =
+			{
+				Unproject(left, top, 1.0f), Unproject(right, top, 1.0f), Unproject(left, bottom, 1.0f), Unproject(right, bottom, 1.0f)
+			};
+
+			for (uint32_t z = 0; z < CLUSTER_GRID_Z; ++z)
+			{
+				ClusterBounds& bounds = clusterBounds[z * CLUSTER_TILE_COUNT + y * CLUSTER_GRID_X + x];
+				bounds.min = glm::vec3(std::numeric_limits<float>::max());
+				bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+
+				for (uint32_t i = 0; i < nearCorners.size(); ++i)
+				{
+					const glm::vec3 edge = farCorners[i] - nearCorners[i];
+					for (const float depth : { sliceDepths[z], sliceDepths[z + 1] })
+					{
+						const glm::vec3 corner = nearCorners[i] + edge * ((depth - nearCorners[i].z) / edge.z);
+						bounds.min = glm::min(bounds.min, corner);
+						bounds.max = glm::max(bounds.max, corner);
+					}
+				}
+			}
+		}
+	}
+}
+
+void ClusteredLighting::BinSlice(uint32_t slice)
+{
+	SliceBins& bins = sliceBins[slice];
+	bins.lights.clear();
+	bins.counts.fill(0);
+	bins.centerX.clear();
+	bins.centerY.clear();
+	bins.centerZ.clear();
+	bins.radiusSq.clear();
+	bins.handles.clear();
+
+	auto AddSliceLight = [&](uint32_t index)
+		{
+			bins.centerX.push_back(centerX[index]);
+			bins.centerY.push_back(centerY[index]);
+			bins.centerZ.push_back(centerZ[index]);
+			bins.radiusSq.push_back(radius[index] * radius[index]);
+			bins.handles.push_back(lightHandles[index]);
+		};
+
+	const float sliceNear = sliceDepths[slice];
+	const float sliceFar = sliceDepths[slice + 1];
+	const uint32_t paddedCount = static_cast<uint32_t>(centerZ.size());
+
+	// Only the lights overlapping the slice's depth range are tested against its clusters
+#if CULLING_USE_SSE
+	const __m128 nearDepth = _mm_set1_ps(sliceNear);
+	const __m128 farDepth = _mm_set1_ps(sliceFar);
+	for (uint32_t i = 0; i < paddedCount; i += 4)
+	{
+		const __m128 lightZ = _mm_loadu_ps(&centerZ[i]);
+		const __m128 lightRadius = _mm_loadu_ps(&radius[i]);
+
+		const __m128 overlaps = _mm_and_ps(
+			_mm_cmpge_ps(_mm_add_ps(lightZ, lightRadius), nearDepth),
+			_mm_cmple_ps(_mm_sub_ps(lightZ, lightRadius), farDepth));
+
+		const int32_t mask = _mm_movemask_ps(overlaps);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			if ((mask >> lane) & 1)
+			{
+				AddSliceLight(i + lane);
+			}
+		}
+	}
+#else
+	for (uint32_t i = 0; i < paddedCount; ++i)
+	{
+		if (centerZ[i] + radius[i] >= sliceNear && centerZ[i] - radius[i] <= sliceFar)
+		{
+			AddSliceLight(i);
+		}
+	}
+#endif
+
+	// A negative squared radius never overlaps a cluster
+	while (bins.handles.size() % 4 != 0)
+	{
+		bins.centerX.push_back(0.0f);
+		bins.centerY.push_back(0.0f);
+		bins.centerZ.push_back(0.0f);
+		bins.radiusSq.push_back(-1.0f);
+		bins.handles.push_back(0);
+	}
+
+	const uint32_t sliceLightCount = static_cast<uint32_t>(bins.handles.size());
+	if (sliceLightCount == 0)
+	{
+		return;
+	}
+
+	for (uint32_t tile = 0; tile < CLUSTER_TILE_COUNT; ++tile)
+	{
+		const ClusterBounds& bounds = clusterBounds[slice * CLUSTER_TILE_COUNT + tile];
+		const size_t first = bins.lights.size();
+
+#if CULLING_USE_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 minX = _mm_set1_ps(bounds.min.x);
+		const __m128 minY = _mm_set1_ps(bounds.min.y);
+		const __m128 minZ = _mm_set1_ps(bounds.min.z);
+		const __m128 maxX = _mm_set1_ps(bounds.max.x);
+		const __m128 maxY = _mm_set1_ps(bounds.max.y);
+		const __m128 maxZ = _mm_set1_ps(bounds.max.z);
+
+		for (uint32_t i = 0; i < sliceLightCount; i += 4)
+		{
+			const __m128 lightX = _mm_loadu_ps(&bins.centerX[i]);
+			const __m128 lightY = _mm_loadu_ps(&bins.centerY[i]);
+			const __m128 lightZ = _mm_loadu_ps(&bins.centerZ[i]);
+
+			// Distance from the sphere's center to the box on each axis, 0 when the center is inside on that axis
+			const __m128 distanceX = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, lightX), _mm_sub_ps(lightX, maxX)), zero);
+			const __m128 distanceY = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, lightY), _mm_sub_ps(lightY, maxY)), zero);
+			const __m128 distanceZ = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, lightZ), _mm_sub_ps(lightZ, maxZ)), zero);
+
+			__m128 distanceSq = _mm_mul_ps(distanceX, distanceX);
+			distanceSq = _mm_add_ps(distanceSq, _mm_mul_ps(distanceY, distanceY));
+			distanceSq = _mm_add_ps(distanceSq, _mm_mul_ps(distanceZ, distanceZ));
+
+			const int32_t mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(&bins.radiusSq[i])));
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if ((mask >> lane) & 1)
+				{
+					bins.lights.push_back(bins.handles[i + lane]);
+				}
+			}
+		}
+#else
+		for (uint32_t i = 0; i < sliceLightCount; ++i)
+		{
+			const glm::vec3 center = glm::vec3(bins.centerX[i], bins.centerY[i], bins.centerZ[i]);
+			const glm::vec3 distance = glm::max(glm::max(bounds.min - center, center - bounds.max), glm::vec3(0.0f));
+			if (glm::dot(distance, distance) <= bins.radiusSq[i])
+			{
+				bins.lights.push_back(bins.handles[i]);
+			}
+		}
+#endif
+
+		bins.counts[tile] = static_cast<uint32_t>(bins.lights.size() - first);
+	}
+}
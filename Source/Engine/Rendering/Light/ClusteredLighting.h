@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct LightInstance;
+
+// The view frustum is split in screen tiles and exponential depth slices
+constexpr uint32_t CLUSTER_GRID_X = 16;
+constexpr uint32_t CLUSTER_GRID_Y = 9;
+constexpr uint32_t CLUSTER_GRID_Z = 24;
+constexpr uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// Light indices shared by all the clusters, the lights past it are dropped from the clusters that overflow
+constexpr uint32_t CLUSTER_MAX_LIGHT_INDICES = 1 << 17;
+// A cluster's range is packed as (offset << CLUSTER_LIGHT_COUNT_BITS) | count
+constexpr uint32_t CLUSTER_LIGHT_COUNT_BITS = 12;
+
+/// <summary>
+/// Start of the cluster buffer, the shader needs it to find the cluster of a fragment.
+/// </summary>
+struct ClusterGridHeader
+{
+	// xyz => cluster grid size, w => directional lights count
+	alignas(16) glm::uvec4 grid = glm::uvec4(0);
+	// xy => cluster size in pixels, z => depth slice scale, w => depth slice bias
+	alignas(16) glm::vec4 tileAndSlices = glm::vec4(0.0f);
+};
+
+// The header is followed by the packed range of each cluster, the directional lights and the clusters' light indices.
+// Each frame in flight owns a copy, aligned for the dynamic offsets
+constexpr uint32_t CLUSTER_BUFFER_FRAME_SIZE = (sizeof(ClusterGridHeader) + sizeof(uint32_t) * (CLUSTER_COUNT + CLUSTER_MAX_LIGHT_INDICES) + 255) & ~255u;
+
+/// <summary>
+/// Bins the point and spot lights into the view frustum's clusters so the fragment shader only walks the lights
+/// that can reach its cluster. The depth slices are binned in parallel, 4 lights per SSE instruction.
+/// </summary>
+class ClusteredLighting
+{
+public:
+	void BeginLights();
+	void AddLight(uint32_t handle, const LightInstance& light);
+
+	// The cluster bounds are only rebuilt when the projection or the screen size changes
+	void Build(const glm::mat4& projection, const glm::mat4& view, float nearView, float farView, uint32_t width, uint32_t height);
+
+	const ClusterGridHeader& GetHeader() const { return header; }
+	// Cluster ranges, directional lights then light indices, uploaded right after the header
+	std::vector<uint32_t>& GetItems() { return items; }
+
+private:
+	void BuildClusterBounds(const glm::mat4& projection, float nearView, float farView, uint32_t width, uint32_t height);
+	void BinSlice(uint32_t slice);
+
+	struct ClusterBounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// Lights binned into the clusters of a depth slice
+	struct SliceBins
+	{
+		std::vector<uint32_t> lights;
+		std::array<uint32_t, CLUSTER_GRID_X * CLUSTER_GRID_Y> counts;
+
+		// Scratch for the lights overlapping the slice's depth range, padded to a multiple of 4
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radiusSq;
+		std::vector<uint32_t> handles;
+	};
+
+	ClusterGridHeader header;
+	std::vector<uint32_t> items;
+
+	std::vector<uint32_t> directionalLights;
+
+	// World space bounding spheres of the point and spot lights
+	std::vector<glm::vec4> lightSpheres;
+	std::vector<uint32_t> lightHandles;
+
+	// View space bounding spheres in SoA, padded to a multiple of 4
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+
+	std::vector<ClusterBounds> clusterBounds;
+	std::array<float, CLUSTER_GRID_Z + 1> sliceDepths;
+	std::array<SliceBins, CLUSTER_GRID_Z> sliceBins;
+
+	glm::mat4 cachedProjection = glm::mat4(0.0f);
+	uint32_t cachedWidth = 0;
+	uint32_t cachedHeight = 0;
+};
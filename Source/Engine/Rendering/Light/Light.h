@@ -10,7 +10,10 @@
 
 #include <iostream>
 
-constexpr uint32_t MAX_LIGHTS = 50;
+// The lights are binned in clusters, the fragments only shade the ones of their cluster
+constexpr uint32_t MAX_LIGHTS = 1024;
+// Degrees added to a spot light's angle where its light fades out
+constexpr float SPOT_LIGHT_OUTER_CUTOFF = 5.0f;
 
 enum class ELightType : uint32_t
 {
@@ -67,8 +70,7 @@ struct LightInstance
 
 		bufferLayout.direction = glm::vec4(dir, 0.0f);
 		bufferLayout.color = glm::vec4(color, intensity);
-		constexpr float OUT_CUTOFF = 5.0f;
-		const float outerCutOff = angle + OUT_CUTOFF;
+		const float outerCutOff = angle + SPOT_LIGHT_OUTER_CUTOFF;
 		bufferLayout.params = glm::vec4(range, glm::cos(glm::radians(angle)), glm::cos(glm::radians(outerCutOff)), 0.0f);
 
 		return bufferLayout;
@@ -2,15 +2,17 @@
 
 #include "Camera/Camera.h"
 #include "Engine.h"
+#include "Rendering/Light/Shadow.h"
 #include "Rendering/RenderingInterface.h"
 
+#include <algorithm>
+#include <cmath>
 #include <glm/glm.hpp>
-#include <limits>
 #include <vector>
 
 namespace LightUtilities
 {
-	static glm::mat4 GetLightSpaceMatrix(const Camera& camera, const glm::vec3& lightEulers, float nearView, float farView)
+	static glm::mat4 GetLightSpaceMatrix(const Camera& camera, const glm::vec3& lightEulers, float nearView, float farView, uint32_t resolution)
 	{
 		const float aspectRatio = GameEngine->GetRenderingSystem()->GetAspectRatio();
 
@@ -19,72 +21,60 @@ namespace LightUtilities
 		const auto corners = Camera::GetWorldSpaceFrustumCorners(projection, camera.data.view);
 		const glm::vec3 center = Camera::GetWorldSpaceFrustumCenter(corners);
 
-		const glm::quat rot = glm::quat(glm::radians(lightEulers));
-		glm::vec3 dir = rot * WORLD_FORWARD;
-
-		const glm::vec3 eye = center - dir;
-		const glm::mat4 lightView = glm::lookAtLH(eye, center, WORLD_UP);
-
-		float minX = std::numeric_limits<float>::max();
-		float maxX = std::numeric_limits<float>::lowest();
-		float minY = std::numeric_limits<float>::max();
-		float maxY = std::numeric_limits<float>::lowest();
-		float minZ = std::numeric_limits<float>::max();
-		float maxZ = std::numeric_limits<float>::lowest();
+		// A sphere instead of a box so the cascade keeps its size when the camera rotates
+		float radius = 0.0f;
 		for (const auto& v : corners)
 		{
-			const auto trf = lightView * v;
-			minX = std::min(minX, trf.x);
-			maxX = std::max(maxX, trf.x);
-			minY = std::min(minY, trf.y);
-			maxY = std::max(maxY, trf.y);
-
-			minZ = std::min(minZ, trf.z);
-			maxZ = std::max(maxZ, trf.z);
+			radius = std::max(radius, glm::length(glm::vec3(v) - center));
 		}
 
-		constexpr float zMult = 5.0f;
-		if (minZ < 0)
-		{
-			minZ *= zMult;
-		}
-		else
-		{
-			minZ /= zMult;
-		}
-		if (maxZ < 0)
-		{
-			maxZ /= zMult;
-		}
-		else
-		{
-			maxZ *= zMult;
-		}
+		// Rounded so the float noise doesn't resize the cascade from one frame to the other
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+		radius *= 1.0f + SHADOW_CASCADE_GUARD_BAND;
 
-		const glm::mat4 lightProjection = glm::ortho(minX, maxX, minY, maxY, minZ, maxZ);
+		const glm::quat rot = glm::quat(glm::radians(lightEulers));
+		glm::vec3 dir = rot * WORLD_FORWARD;
+
+		// Only depends on the light's direction, the cascade follows the camera in light space
+		const glm::mat4 lightView = glm::lookAtLH(glm::vec3(0.0f), dir, WORLD_UP);
+
+		// Snapped to whole texels so the shadow edges don't shimmer and the cascade only changes when the camera moved by a texel
+		const float texelSize = 2.0f * radius / static_cast<float>(std::max(resolution, 1u));
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		lightCenter = glm::floor(lightCenter / texelSize) * texelSize;
+
+		const glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius,
+			lightCenter.x + radius,
+			lightCenter.y - radius,
+			lightCenter.y + radius,
+			lightCenter.z - radius * SHADOW_CASCADE_DEPTH_EXTENSION,
+			lightCenter.z + radius);
 
 		return lightProjection * lightView;
 	}
 
-	static std::vector<glm::mat4> GetLightSpaceMatrices(const Camera& camera, const glm::vec3& lightEulers)
+	// One resolution per cascade, the size of its shadow atlas tile
+	static std::vector<glm::mat4> GetLightSpaceMatrices(const Camera& camera, const glm::vec3& lightEulers, const std::vector<uint32_t>& resolutions)
 	{
 		const std::vector<float> shadowCascadeLevels = camera.shadowCascadeLevels;
 		const int32_t shadowCascadeLevelsCount = camera.shadowCascadeLevels.size();
 
+		const int32_t cascadeCount = std::min(shadowCascadeLevelsCount + 1, static_cast<int32_t>(resolutions.size()));
+
 		std::vector<glm::mat4> matrices;
-		for (int32_t i = 0; i < shadowCascadeLevelsCount + 1; ++i)
+		for (int32_t i = 0; i < cascadeCount; ++i)
 		{
 			if (i == 0)
 			{
-				matrices.push_back(GetLightSpaceMatrix(camera, lightEulers, camera.data.nearView, shadowCascadeLevels[i]));
+				matrices.push_back(GetLightSpaceMatrix(camera, lightEulers, camera.data.nearView, shadowCascadeLevels[i], resolutions[i]));
 			}
 			else if (i < shadowCascadeLevels.size())
 			{
-				matrices.push_back(GetLightSpaceMatrix(camera, lightEulers, shadowCascadeLevels[i - 1], shadowCascadeLevels[i]));
+				matrices.push_back(GetLightSpaceMatrix(camera, lightEulers, shadowCascadeLevels[i - 1], shadowCascadeLevels[i], resolutions[i]));
 			}
 			else
 			{
-				matrices.push_back(GetLightSpaceMatrix(camera, lightEulers, shadowCascadeLevels[i - 1], camera.data.farView));
+				matrices.push_back(GetLightSpaceMatrix(camera, lightEulers, shadowCascadeLevels[i - 1], camera.data.farView, resolutions[i]));
 			}
 		}
 
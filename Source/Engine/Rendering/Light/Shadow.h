@@ -5,6 +5,11 @@
 
 constexpr uint32_t MAX_SM = 16;
 
+// Border added around each cascade so a cascade cached for a few frames still covers its part of the view
+constexpr float SHADOW_CASCADE_GUARD_BAND = 0.1f;
+// How far towards the light the casters of a cascade are rendered, in cascade radii
+constexpr float SHADOW_CASCADE_DEPTH_EXTENSION = 5.0f;
+
 struct ShadowLayout
 {
 	alignas(16) glm::mat4 lightMatrix[MAX_SM];
@@ -0,0 +1,118 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+ShadowQualitySettings ShadowAtlas::GetQualitySettings(EShadowQuality quality)
+{
+	static constexpr std::array<ShadowQualitySettings, 4> settings =
+	{
+		ShadowQualitySettings{ 2048, 1024, 256 },	// Low
+		ShadowQualitySettings{ 4096, 2048, 512 },	// Medium
+		ShadowQualitySettings{ 4096, 2048, 1024 },	// High
+		ShadowQualitySettings{ 8192, 4096, 1024 }	// Ultra
+	};
+
+	return settings[static_cast<uint8_t>(quality)];
+}
+
+void ShadowAtlas::Initialize(uint32_t inSize)
+{
+	size = inSize;
+
+	const uint32_t levelCount = size > SHADOW_ATLAS_MIN_TILE_SIZE ? std::countr_zero(size) - std::countr_zero(SHADOW_ATLAS_MIN_TILE_SIZE) + 1 : 1;
+
+	freeTiles.clear();
+	freeTiles.resize(levelCount);
+	freeTiles[0].push_back({ 0, 0, size });
+}
+
+bool ShadowAtlas::Allocate(uint32_t tileSize, ShadowAtlasTile& outTile)
+{
+	if (freeTiles.empty())
+	{
+		return false;
+	}
+
+	const uint32_t level = GetLevel(tileSize);
+
+	// The smallest free tile that is big enough
+	int32_t sourceLevel = static_cast<int32_t>(level);
+	while (sourceLevel >= 0 && freeTiles[sourceLevel].empty())
+	{
+		--sourceLevel;
+	}
+
+	if (sourceLevel < 0)
+	{
+		return false;
+	}
+
+	ShadowAtlasTile tile = freeTiles[sourceLevel].back();
+	freeTiles[sourceLevel].pop_back();
+
+	// Split down to the requested size, the top left quarter is kept and the 3 others are freed
+	for (uint32_t i = static_cast<uint32_t>(sourceLevel); i < level; ++i)
+	{
+		const uint32_t half = tile.size / 2;
+		freeTiles[i + 1].push_back({ tile.x + half, tile.y + half, half });
+		freeTiles[i + 1].push_back({ tile.x, tile.y + half, half });
+		freeTiles[i + 1].push_back({ tile.x + half, tile.y, half });
+		tile.size = half;
+	}
+
+	outTile = tile;
+	return true;
+}
+
+void ShadowAtlas::Free(const ShadowAtlasTile& tile)
+{
+	if (tile.size == 0 || freeTiles.empty())
+	{
+		return;
+	}
+
+	ShadowAtlasTile current = tile;
+	uint32_t level = GetLevel(tile.size);
+
+	// Merge the tile back with its 3 siblings for as long as they are all free
+	while (level > 0)
+	{
+		const uint32_t parentSize = current.size * 2;
+		const uint32_t parentX = current.x - current.x % parentSize;
+		const uint32_t parentY = current.y - current.y % parentSize;
+
+		std::vector<ShadowAtlasTile>& tiles = freeTiles[level];
+		auto isSibling = [&](const ShadowAtlasTile& other)
+			{
+				return other.x - other.x % parentSize == parentX && other.y - other.y % parentSize == parentY;
+			};
+
+		if (std::count_if(tiles.begin(), tiles.end(), isSibling) != 3)
+		{
+			break;
+		}
+
+		tiles.erase(std::remove_if(tiles.begin(), tiles.end(), isSibling), tiles.end());
+
+		current = { parentX, parentY, parentSize };
+		--level;
+	}
+
+	freeTiles[level].push_back(current);
+}
+
+glm::vec4 ShadowAtlas::GetUVRect(const ShadowAtlasTile& tile) const
+{
+	const float atlasSize = static_cast<float>(size);
+	return glm::vec4(tile.x / atlasSize, tile.y / atlasSize, tile.size / atlasSize, tile.size / atlasSize);
+}
+
+uint32_t ShadowAtlas::GetLevel(uint32_t tileSize) const
+{
+	tileSize = std::clamp(std::bit_ceil(tileSize), SHADOW_ATLAS_MIN_TILE_SIZE, size);
+
+	const uint32_t level = std::countr_zero(size) - std::countr_zero(tileSize);
+	return std::min<uint32_t>(level, static_cast<uint32_t>(freeTiles.size()) - 1);
+}
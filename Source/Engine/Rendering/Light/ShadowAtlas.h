@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Rendering/AbstractData.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Smallest tile the atlas hands out
+constexpr uint32_t SHADOW_ATLAS_MIN_TILE_SIZE = 256;
+
+/// <summary>
+/// Resolutions used by a shadow quality tier. Cascade i gets nearCascadeSize >> i, never less than farCascadeSize.
+/// </summary>
+struct ShadowQualitySettings
+{
+	uint32_t atlasSize;
+	uint32_t nearCascadeSize;
+	uint32_t farCascadeSize;
+};
+
+/// <summary>
+/// Square region of the atlas in texels, a size of 0 is an empty tile.
+/// </summary>
+struct ShadowAtlasTile
+{
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t size = 0;
+};
+
+/// <summary>
+/// Quadtree allocator of the shadow atlas, every tile is a power of 2 square aligned to its size.
+/// The cascades, and later the point and spot lights, all take their shadow maps from the same atlas.
+/// </summary>
+class ShadowAtlas
+{
+public:
+	static ShadowQualitySettings GetQualitySettings(EShadowQuality quality);
+
+	// Frees every tile, the size has to be a power of 2
+	void Initialize(uint32_t inSize);
+
+	// The size is rounded up to a power of 2 and clamped to the atlas. Returns false when no tile of that size is left
+	bool Allocate(uint32_t tileSize, ShadowAtlasTile& outTile);
+	void Free(const ShadowAtlasTile& tile);
+
+	// Offset (xy) and scale (zw) of the tile in the atlas' uv space
+	glm::vec4 GetUVRect(const ShadowAtlasTile& tile) const;
+
+	uint32_t GetSize() const { return size; }
+
+private:
+	uint32_t GetLevel(uint32_t tileSize) const;
+
+	// Free tiles of each level, level 0 is the whole atlas and each level halves the tile size
+	std::vector<std::vector<ShadowAtlasTile>> freeTiles;
+	uint32_t size = 0;
+};
@@ -0,0 +1,102 @@
+#include "ShadowCascadeCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t ShadowCascadeCache::Update(const std::vector<ShadowCascadeState>& states, std::vector<glm::mat4>& outMatrices)
+{
+	const uint32_t cascadeCount = static_cast<uint32_t>(std::min<size_t>(states.size(), MAX_SM));
+
+	uint32_t updateMask = 0;
+	uint32_t pendingMask = 0;
+	for (uint32_t i = 0; i < cascadeCount; ++i)
+	{
+		const ShadowCascadeState& state = states[i];
+		const CachedCascade& cached = cascades[i];
+
+		const bool isStale = !cached.isValid ||
+			state.hasAnimatedCasters ||
+			cached.casterSignature != state.casterSignature ||
+			cached.matrix != state.matrix;
+
+		if (!isStale)
+		{
+			continue;
+		}
+
+		// A far cascade that no longer covers the view can't wait for its turn
+		if (i < SHADOW_CASCADES_UPDATED_EVERY_FRAME || !cached.isValid || !IsCovering(cached.matrix, state.matrix))
+		{
+			updateMask |= 1u << i;
+		}
+		else
+		{
+			pendingMask |= 1u << i;
+		}
+	}
+
+	// Round-robin over the far cascades, starting after the last one refreshed
+	if (pendingMask != 0)
+	{
+		for (uint32_t i = 0; i < cascadeCount; ++i)
+		{
+			const uint32_t cascade = (nextFarCascade + i) % cascadeCount;
+			if ((pendingMask & (1u << cascade)) != 0)
+			{
+				updateMask |= 1u << cascade;
+				nextFarCascade = cascade + 1;
+				break;
+			}
+		}
+	}
+
+	outMatrices.resize(cascadeCount);
+	for (uint32_t i = 0; i < cascadeCount; ++i)
+	{
+		CachedCascade& cached = cascades[i];
+		if ((updateMask & (1u << i)) != 0)
+		{
+			cached.matrix = states[i].matrix;
+			cached.casterSignature = states[i].casterSignature;
+			cached.isValid = true;
+		}
+
+		outMatrices[i] = cached.matrix;
+	}
+
+	// The layers above the cascade count weren't kept up to date
+	for (uint32_t i = cascadeCount; i < MAX_SM; ++i)
+	{
+		cascades[i].isValid = false;
+	}
+
+	return updateMask;
+}
+
+void ShadowCascadeCache::Invalidate()
+{
+	for (CachedCascade& cascade : cascades)
+	{
+		cascade.isValid = false;
+	}
+}
+
+void ShadowCascadeCache::AddToSignature(uint64_t& signature, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		signature ^= bytes[i];
+		signature *= 1099511628211ull;
+	}
+}
+
+bool ShadowCascadeCache::IsCovering(const glm::mat4& cachedMatrix, const glm::mat4& matrix)
+{
+	// The cascades are fitted with the guard band around the camera's sphere, the sphere stays inside the cached
+	// cascade as long as its center moved by less than the guard band
+	const float maxOffset = SHADOW_CASCADE_GUARD_BAND / (1.0f + SHADOW_CASCADE_GUARD_BAND);
+
+	const glm::vec4 center = cachedMatrix * glm::inverse(matrix) * glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
+	return std::abs(center.x) <= maxOffset && std::abs(center.y) <= maxOffset && center.z >= 0.0f && center.z <= 1.0f;
+}
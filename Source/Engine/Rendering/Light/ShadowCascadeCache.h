@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Rendering/Light/Shadow.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// The first cascades are re-rendered as soon as they change, the farther ones wait for their turn
+constexpr uint32_t SHADOW_CASCADES_UPDATED_EVERY_FRAME = 1;
+
+/// <summary>
+/// What a cascade would be rendered with this frame.
+/// </summary>
+struct ShadowCascadeState
+{
+	glm::mat4 matrix = glm::mat4(1.0f);
+	// Hash of the casters overlapping the cascade and their transforms
+	uint64_t casterSignature = 0;
+	// Skinned casters move every frame without their transform changing
+	bool hasAnimatedCasters = false;
+};
+
+/// <summary>
+/// Keeps track of what each cascade of a shadow map was last rendered with so unchanged cascades are reused.
+/// At most one far cascade is refreshed per frame, in a round-robin order.
+/// </summary>
+class ShadowCascadeCache
+{
+public:
+	// Returns the mask of the cascades to re-render and writes the matrices each cascade has to be sampled with
+	uint32_t Update(const std::vector<ShadowCascadeState>& states, std::vector<glm::mat4>& outMatrices);
+	// Every cascade is re-rendered on the next update, used when the cascades move in the atlas
+	void Invalidate();
+
+	// FNV-1a, used to build the caster signatures
+	static void AddToSignature(uint64_t& signature, const void* data, size_t size);
+
+	static constexpr uint64_t EMPTY_SIGNATURE = 14695981039346656037ull;
+
+private:
+	// Whether the cascade cached with the old matrix still contains the whole cascade fitted with the new one
+	static bool IsCovering(const glm::mat4& cachedMatrix, const glm::mat4& matrix);
+
+	struct CachedCascade
+	{
+		glm::mat4 matrix = glm::mat4(1.0f);
+		uint64_t casterSignature = 0;
+		bool isValid = false;
+	};
+
+	std::array<CachedCascade, MAX_SM> cascades;
+	uint32_t nextFarCascade = 0;
+};
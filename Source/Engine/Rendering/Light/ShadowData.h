@@ -4,6 +4,7 @@
 
 #include <array>
 #include <cstdint>
+#include <glm/glm.hpp>
 
 struct alignas(16) ShadowData
 {
@@ -16,6 +17,8 @@ struct alignas(16) ShadowData
 	};
 
 	alignas(16) PaddedFloat cascadePlaneDistance[MAX_SM];
+	// Offset (xy) and scale (zw) of each cascade's tile in the shadow atlas
+	alignas(16) glm::vec4 cascadeAtlasRects[MAX_SM];
 	float farPlane = 0.0f;
 	int32_t cascadeCount = 0;
 };
@@ -25,4 +28,5 @@ struct alignas(16) ShadowDebugData
 	float nearPlane;
 	float farPlane;
 	int32_t layer;
+	alignas(16) glm::vec4 atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 };
@@ -0,0 +1,62 @@
+#include "LodSelection.h"
+#include "AssetManager/Model/MeshData.h"
+#include "Camera/Camera.h"
+#include "ECS/Components/Components.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t LodSelection::SelectLod(const MeshData& meshData, const Transform& transform, const CameraData& camera, float viewportHeight, uint32_t currentLod)
+{
+	if (meshData.lodErrors.size() < 2)
+	{
+		return 0;
+	}
+
+	const uint32_t lastLod = static_cast<uint32_t>(meshData.lodErrors.size()) - 1;
+	currentLod = std::min(currentLod, lastLod);
+
+	const float pixelsPerUnit = GetPixelsPerUnit(meshData, transform, camera, viewportHeight);
+
+	// The errors only grow with the LOD index, so the coarsest LOD under the threshold is searched from the end
+	auto findCoarsestLod = [&](float threshold)
+		{
+			for (uint32_t lod = lastLod; lod > 0; --lod)
+			{
+				if (meshData.lodErrors[lod] * pixelsPerUnit <= threshold)
+				{
+					return lod;
+				}
+			}
+
+			return 0u;
+		};
+
+	if (meshData.lodErrors[currentLod] * pixelsPerUnit > LOD_PIXEL_ERROR)
+	{
+		return findCoarsestLod(LOD_PIXEL_ERROR);
+	}
+
+	return std::max(currentLod, findCoarsestLod(LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS)));
+}
+
+float LodSelection::GetPixelsPerUnit(const MeshData& meshData, const Transform& transform, const CameraData& camera, float viewportHeight)
+{
+	const float maxScale = std::max({ std::abs(transform.scale.x), std::abs(transform.scale.y), std::abs(transform.scale.z) });
+
+	// projection[1][1] is the cotangent of half the field of view (or 1 / half the height for orthographic)
+	const float pixelsPerWorldUnit = std::abs(camera.projection[1][1]) * 0.5f * viewportHeight;
+
+	if (camera.cameraType == Orthographic)
+	{
+		return pixelsPerWorldUnit * maxScale;
+	}
+
+	const glm::vec3 localCenter = (meshData.boundsMin + meshData.boundsMax) * 0.5f;
+	const glm::vec3 center = glm::vec3(transform.ComputeModel() * glm::vec4(localCenter, 1.0f));
+	const float radius = glm::length(meshData.boundsMax - localCenter) * maxScale;
+
+	// Measured from the closest point of the bounds, the camera inside the bounds gets the full resolution
+	const float distance = std::max(glm::length(center - camera.position) - radius, camera.nearView);
+	return pixelsPerWorldUnit * maxScale / distance;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+struct CameraData;
+struct MeshData;
+struct Transform;
+
+// Largest error on screen a LOD may have, in pixels
+constexpr float LOD_PIXEL_ERROR = 1.0f;
+// Switching to a coarser LOD needs its error 25% under the threshold so the LODs don't flicker at the boundary
+constexpr float LOD_HYSTERESIS = 0.25f;
+
+/// <summary>
+/// Picks the LOD of a model from the size its simplification error projects to on screen.
+/// </summary>
+class LodSelection
+{
+public:
+	static uint32_t SelectLod(const MeshData& meshData, const Transform& transform, const CameraData& camera, float viewportHeight, uint32_t currentLod);
+
+private:
+	// Pixels per mesh space unit at the closest point of the model's bounds
+	static float GetPixelsPerUnit(const MeshData& meshData, const Transform& transform, const CameraData& camera, float viewportHeight);
+};
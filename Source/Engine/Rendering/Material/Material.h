@@ -8,6 +8,11 @@
 #include <glm/glm.hpp>
 #include <vector>
 
+// The textures of every material live in one array, the materials reference them by their index in it
+constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+// Size of the material buffer, a material's handle is its index in it
+constexpr uint32_t MAX_MATERIALS = 4096;
+
 template <typename T>
 inline void HashCombine(std::size_t& seed, const T& v)
 {
@@ -75,9 +80,32 @@ struct std::hash<MaterialInstanceKey>
 	}
 };
 
+// Factors applied on top of the material's textures
+struct MaterialParameters
+{
+	glm::vec4 baseColor = glm::vec4(1.0f);
+	float specularStrength = 0.5f;
+	float shininess = 16.0f;
+};
+
 struct MaterialInstance
 {
 	MaterialInstanceKey key;
-	GenericHandle descriptorSet;
+	MaterialParameters parameters;
 	ERenderDataLoadState state;
-};
\ No newline at end of file
+};
+
+/// <summary>
+/// What the shaders read of a material, the draws push the material's index
+/// </summary>
+struct MaterialBufferLayout
+{
+	alignas(16) glm::vec4 baseColor = glm::vec4(1.0f);
+	// x => specular strength, y => shininess
+	alignas(16) glm::vec4 factors = glm::vec4(0.0f);
+	// x => albedo, indices in the bindless texture array
+	alignas(16) glm::uvec4 textures = glm::uvec4(0);
+};
+
+// Each frame in flight owns a copy of the material buffer, aligned for the storage buffer offsets
+constexpr uint32_t MATERIAL_BUFFER_FRAME_SIZE = (sizeof(MaterialBufferLayout) * MAX_MATERIALS + 255) & ~255u;
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Utilities/AlignedVectors.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Instances the main and the shadow passes can draw in a frame, the draws past it are dropped
+constexpr uint32_t MAX_DRAW_INSTANCES = 16384;
+
+// Instance groups of the main pass culled on the GPU in a frame, the groups past it are drawn without culling
+constexpr uint32_t MAX_CULLED_DRAWS = 4096;
+// Culled draws sharing a pipeline, a material and an index type are submitted together
+constexpr uint32_t MAX_CULLED_BATCHES = 256;
+// The instances drawn as they are, the meshlet culled ones and the shadow casters
+constexpr uint32_t NO_CULLED_DRAW = ~0u;
+
+// Draws of the shadow casters in a frame, one per caster submesh
+constexpr uint32_t MAX_SHADOW_DRAWS = 8192;
+
+/// <summary>
+/// Per instance data of the main and the shadow passes, read by the vertex shaders.
+/// </summary>
+struct InstanceLayout
+{
+	// The dequantization of the positions is folded in
+	alignas(16) glm::mat4 model = glm::mat4(1.0f);
+	// w is unused
+	alignas(16) AlignedMatrix3 normalMatrix;
+	// Slot of the entity's bones in the animation buffer
+	uint32_t bonePalette = 0;
+	uint32_t hasAnimation = 0;
+	// Culled draw the instance belongs to
+	uint32_t culledDraw = NO_CULLED_DRAW;
+	// Shadow pass only, the cascade the instance is rendered in
+	uint32_t cascade = 0;
+};
+
+/// <summary>
+/// An instance group of the main pass culled on the GPU. The visible instances are compacted at the start of the
+/// group and the draws that kept instances are compacted at the start of their batch.
+/// </summary>
+struct CulledDrawLayout
+{
+	// Bounds in the space the instances' model matrices take, w is unused
+	alignas(16) glm::vec4 boundsCenter = glm::vec4(0.0f);
+	alignas(16) glm::vec4 boundsExtent = glm::vec4(0.0f);
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+	int32_t vertexOffset = 0;
+	uint32_t firstInstance = 0;
+	uint32_t batch = 0;
+	// First draw of the batch, its compacted draws are written from there
+	uint32_t batchFirstDraw = 0;
+};
+
+// Each frame in flight owns a copy, aligned for the dynamic offsets
+constexpr uint32_t INSTANCE_BUFFER_FRAME_SIZE = (sizeof(InstanceLayout) * MAX_DRAW_INSTANCES + 255) & ~255u;
+// The vertex shaders read their instance through this indirection, the culling compacts the visible instances in it
+constexpr uint32_t VISIBLE_INSTANCE_BUFFER_FRAME_SIZE = (sizeof(uint32_t) * MAX_DRAW_INSTANCES + 255) & ~255u;
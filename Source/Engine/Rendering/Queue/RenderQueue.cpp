@@ -0,0 +1,97 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+
+constexpr uint32_t DRAW_KEY_DEPTH_SHIFT = 0;
+constexpr uint32_t DRAW_KEY_MESH_SHIFT = DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS;
+constexpr uint32_t DRAW_KEY_MATERIAL_SHIFT = DRAW_KEY_MESH_SHIFT + DRAW_KEY_MESH_BITS;
+constexpr uint32_t DRAW_KEY_PIPELINE_SHIFT = DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS;
+constexpr uint32_t DRAW_KEY_PASS_SHIFT = DRAW_KEY_PIPELINE_SHIFT + DRAW_KEY_PIPELINE_BITS;
+static_assert(DRAW_KEY_PASS_SHIFT + DRAW_KEY_PASS_BITS == 64, "The draw key fields have to fill the 64 bits");
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX_BUCKETS = 1 << RADIX_BITS;
+constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+namespace
+{
+	uint64_t KeyField(uint64_t value, uint32_t bits, uint32_t shift)
+	{
+		return (value & ((1ull << bits) - 1)) << shift;
+	}
+}
+
+uint64_t RenderQueue::MakeKey(ERenderPass pass, EPipelineType pipeline, uint32_t material, uint32_t mesh, float normalizedDepth)
+{
+	constexpr float maxDepth = static_cast<float>((1u << DRAW_KEY_DEPTH_BITS) - 1);
+	const uint32_t depth = static_cast<uint32_t>(std::clamp(normalizedDepth, 0.0f, 1.0f) * maxDepth);
+
+	return KeyField(static_cast<uint64_t>(pass), DRAW_KEY_PASS_BITS, DRAW_KEY_PASS_SHIFT) |
+		KeyField(static_cast<uint64_t>(pipeline), DRAW_KEY_PIPELINE_BITS, DRAW_KEY_PIPELINE_SHIFT) |
+		KeyField(material, DRAW_KEY_MATERIAL_BITS, DRAW_KEY_MATERIAL_SHIFT) |
+		KeyField(mesh, DRAW_KEY_MESH_BITS, DRAW_KEY_MESH_SHIFT) |
+		KeyField(depth, DRAW_KEY_DEPTH_BITS, DRAW_KEY_DEPTH_SHIFT);
+}
+
+EPipelineType RenderQueue::GetPipeline(uint64_t key)
+{
+	return static_cast<EPipelineType>((key >> DRAW_KEY_PIPELINE_SHIFT) & ((1ull << DRAW_KEY_PIPELINE_BITS) - 1));
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+void RenderQueue::Add(const DrawPacket& packet)
+{
+	packets.push_back(packet);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t packetCount = packets.size();
+	if (packetCount < 2)
+	{
+		return;
+	}
+
+	// Every digit is counted in a single read of the keys
+	std::array<std::array<uint32_t, RADIX_BUCKETS>, RADIX_PASSES> histograms{};
+	for (const DrawPacket& packet : packets)
+	{
+		for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+		{
+			histograms[pass][(packet.key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+		}
+	}
+
+	sortScratch.resize(packetCount);
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		std::array<uint32_t, RADIX_BUCKETS>& histogram = histograms[pass];
+
+		// Most digits are the same for every packet (the pass, the pipeline), these passes wouldn't move anything
+		const uint32_t shift = pass * RADIX_BITS;
+		if (histogram[(packets[0].key >> shift) & (RADIX_BUCKETS - 1)] == packetCount)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram)
+		{
+			const uint32_t count = bucket;
+			bucket = offset;
+			offset += count;
+		}
+
+		for (const DrawPacket& packet : packets)
+		{
+			sortScratch[histogram[(packet.key >> shift) & (RADIX_BUCKETS - 1)]++] = packet;
+		}
+
+		packets.swap(sortScratch);
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Rendering/AbstractData.h"
+
+#include <cstdint>
+#include <entt/entity/fwd.hpp>
+#include <vector>
+
+class Model;
+
+enum class ERenderPass : uint8_t
+{
+	Opaque
+};
+
+// Bits of each field of a draw key from the most significant, the state that costs the most to change sorts first
+constexpr uint32_t DRAW_KEY_PASS_BITS = 4;
+constexpr uint32_t DRAW_KEY_PIPELINE_BITS = 8;
+constexpr uint32_t DRAW_KEY_MATERIAL_BITS = 20;
+constexpr uint32_t DRAW_KEY_MESH_BITS = 16;
+constexpr uint32_t DRAW_KEY_DEPTH_BITS = 16;
+
+/// <summary>
+/// A single submesh to draw, sorted by its key.
+/// </summary>
+struct DrawPacket
+{
+	uint64_t key = 0;
+	const Model* model = nullptr;
+	entt::entity entity;
+	uint32_t submesh = 0;
+	uint32_t lodIndex = 0;
+};
+
+/// <summary>
+/// Draws of a pass sorted so the ones sharing a pipeline, a material and a mesh are next to each other
+/// and the binds between them can be skipped. Opaque draws are sorted front to back inside a group.
+/// </summary>
+class RenderQueue
+{
+public:
+	// The material and the mesh only keep their low bits, two of them sharing a key only costs a bind
+	static uint64_t MakeKey(ERenderPass pass, EPipelineType pipeline, uint32_t material, uint32_t mesh, float normalizedDepth);
+	static EPipelineType GetPipeline(uint64_t key);
+
+	void Clear();
+	void Add(const DrawPacket& packet);
+
+	// LSD radix sort on the keys, 8 bits per pass. Stable, packets with the same key keep their submission order
+	void Sort();
+
+	const std::vector<DrawPacket>& GetPackets() const { return packets; }
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> sortScratch;
+};
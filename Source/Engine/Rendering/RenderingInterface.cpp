@@ -43,8 +43,8 @@ void RenderingInterface::HandleWindowResized()
 	onWindowResizeParams.Invoke(static_cast<float>(width), static_cast<float>(height));
 }
 
-void RenderingInterface::CreateDescriptorRegistry()
+bool RenderingInterface::CreateDescriptorRegistry()
 {
 	descriptorRegistry = new DescriptorRegistry(this);
-	descriptorRegistry->Initialize();
+	return descriptorRegistry->Initialize();
 }
@@ -28,12 +28,12 @@ struct View;
 DECLARE_DELEGATE(OnRenderFrameReset);
 DECLARE_DELEGATE_TwoParams(OnWindowResizeParams, float, float);
 
-constexpr uint32_t SHADOW_MAP_SIZE = 4096; // ULTRA
-
 enum class EBufferType
 {
 	Uniform,
-	Storage
+	Storage,
+	// Draw commands written by the CPU
+	Indirect
 };
 
 enum class EDescriptorSetType
@@ -53,6 +53,9 @@ public:
 	virtual void DrawFrame() = 0;
 	virtual void EndFrame() = 0;	
 
+	// Blocks until the GPU is done with every submitted frame, only meant for rare events (asset hot reload)
+	virtual void WaitForFramesInFlight() = 0;
+
 	// Descriptor Sets
 	virtual bool TryGetDescriptorLayoutForOwner(EPipelineType pipeline, EDescriptorOwner owner, DescriptorSetLayoutInfo& outLayoutInfo) = 0;
 	virtual void UpdateDescriptorSet(EPipelineType pipeline, const std::unordered_map<EngineName, DescriptorDataProvider>& dataProviders) = 0;
@@ -60,16 +63,21 @@ public:
 
 	/// Global descriptors
 	virtual void CreateBuffer(EBufferType bufferType, uint32_t size, AllocatedBuffer& outBuffer) = 0;
-	virtual void CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cameraMatricesLayout, DescriptorSetLayoutInfo& lightLayout, DescriptorSetLayoutInfo& animationLayout, DescriptorSetLayoutInfo& shadowLayout) = 0;
-	virtual void CreateDescriptorSet(const DescriptorSetLayoutInfo& layoutInfo, GenericHandle& outDescriptorSet) = 0;
+	virtual void CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cameraMatricesLayout, DescriptorSetLayoutInfo& lightLayout, DescriptorSetLayoutInfo& animationLayout, DescriptorSetLayoutInfo& shadowLayout, DescriptorSetLayoutInfo& materialLayout) = 0;
+	virtual bool CreateDescriptorSet(const DescriptorSetLayoutInfo& layoutInfo, GenericHandle& outDescriptorSet) = 0;
 
 	virtual void UpdateDescriptorSet(EDescriptorSetType type, GenericHandle descriptorSet, AllocatedBuffer buffer, uint32_t binding = 0) = 0;
 	virtual void UpdateDynamicDescriptorSet(EDescriptorSetType type, GenericHandle descriptorSet, AllocatedBuffer buffer, uint32_t binding, uint32_t offset, uint32_t range) = 0;
 	virtual void DestroyDescriptorSetLayout(const DescriptorSetLayoutInfo& layoutInfo) = 0;
+	// Writes a texture in a bindless array, the slot must not be read by a frame in flight
+	virtual void UpdateBindlessTexture(GenericHandle descriptorSet, uint32_t binding, uint32_t arrayIndex, const AllocatedTexture& texture) = 0;
 	// *******************
 
 	// Buffer manips
+	// The mesh's vertices and indices are sub-allocated from the geometry pool
 	virtual void CreateMeshVertexBuffer(const MeshData& meshData, MeshRenderData& outRenderData) = 0;
+	// Gives the mesh's ranges back once the frames in flight are done with them
+	virtual void DestroyMeshVertexBuffer(const MeshRenderData& renderData) = 0;
 	virtual void CreateTextureBuffer(const TextureData& textureData, void* pixels, TextureRenderData& renderData) = 0;
 
 	virtual void UpdateBuffer(AllocatedBuffer buffer, uint32_t offset, uint32_t range, void* dataToCopy) = 0;
@@ -78,6 +86,10 @@ public:
 	virtual void DestroyTexture(AllocatedTexture texture) = 0;
 	// ************
 
+	// Resizes the shadow atlas and the cascades' tiles at the start of the next frame
+	virtual void SetShadowQuality(EShadowQuality quality) = 0;
+	EShadowQuality GetShadowQuality() const { return shadowQuality; }
+
 	SDL_Window* GetWindow() const { return window; }
 	int32_t GetWindowWidth() const { return width; }
 	int32_t GetWindowHeight() const { return height; }
@@ -100,13 +112,15 @@ protected:
 
 	virtual void HandleWindowResized();
 	virtual void HandleWindowMinimized() = 0;
-	void CreateDescriptorRegistry();
+	bool CreateDescriptorRegistry();
 
 	int32_t width = 960;
 	int32_t height = 540;
 
 	float aspectRatio = 1.0f;
 
+	EShadowQuality shadowQuality = EShadowQuality::Ultra;
+
 	SDL_Window* window = nullptr;
 	const std::string applicationName = "Tech Showcase";
 
@@ -0,0 +1,50 @@
+#include "DescriptorBindState.h"
+
+#include <algorithm>
+#include <cassert>
+
+void DescriptorBindState::Begin(VkCommandBuffer inCmdBuffer)
+{
+	cmdBuffer = inCmdBuffer;
+	stats = DescriptorBindStats{};
+	Invalidate();
+}
+
+void DescriptorBindState::Bind(VkPipelineLayout layout, uint32_t setIndex, VkDescriptorSet set, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+{
+	assert(setIndex < MAX_TRACKED_DESCRIPTOR_SETS && dynamicOffsetCount <= MAX_TRACKED_DYNAMIC_OFFSETS);
+
+	if (layout != boundLayout)
+	{
+		Invalidate();
+		boundLayout = layout;
+	}
+
+	BoundSet& bound = boundSets[setIndex];
+	if (bound.set == set && bound.dynamicOffsetCount == dynamicOffsetCount && std::equal(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets.begin()))
+	{
+		++stats.skipped;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(cmdBuffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		layout,
+		setIndex,
+		1,
+		&set,
+		dynamicOffsetCount,
+		dynamicOffsets);
+
+	bound.set = set;
+	bound.dynamicOffsetCount = dynamicOffsetCount;
+	std::copy(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets.begin());
+
+	++stats.binds;
+}
+
+void DescriptorBindState::Invalidate()
+{
+	boundLayout = VK_NULL_HANDLE;
+	boundSets.fill(BoundSet{});
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <volk.h>
+
+// Highest set index of the pipeline layouts + 1
+constexpr uint32_t MAX_TRACKED_DESCRIPTOR_SETS = 8;
+constexpr uint32_t MAX_TRACKED_DYNAMIC_OFFSETS = 4;
+
+struct DescriptorBindStats
+{
+	// vkCmdBindDescriptorSets calls recorded
+	uint32_t binds = 0;
+	// Binds skipped because the set and its dynamic offsets were already bound
+	uint32_t skipped = 0;
+};
+
+/// <summary>
+/// Remembers the descriptor sets bound on a command buffer so a set that is already bound with the same dynamic offsets
+/// isn't bound again. The pipeline layouts don't share their set layouts, binding with another layout forgets every set.
+/// </summary>
+class DescriptorBindState
+{
+public:
+	// Starts tracking a command buffer that was just begun, the stats restart from 0
+	void Begin(VkCommandBuffer inCmdBuffer);
+
+	void Bind(VkPipelineLayout layout, uint32_t setIndex, VkDescriptorSet set, uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr);
+
+	// For the code that binds sets without the tracker (the editor UI)
+	void Invalidate();
+
+	const DescriptorBindStats& GetStats() const { return stats; }
+
+private:
+	struct BoundSet
+	{
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		uint32_t dynamicOffsetCount = 0;
+		std::array<uint32_t, MAX_TRACKED_DYNAMIC_OFFSETS> dynamicOffsets{};
+	};
+
+	VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+	VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+	std::array<BoundSet, MAX_TRACKED_DESCRIPTOR_SETS> boundSets;
+
+	DescriptorBindStats stats;
+};
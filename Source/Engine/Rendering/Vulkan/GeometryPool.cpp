@@ -0,0 +1,144 @@
+#include "GeometryPool.h"
+#include "AssetManager/Model/MeshData.h"
+
+#include <iostream>
+
+namespace
+{
+	bool CreatePoolBuffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& outBuffer, VmaAllocation& outMemory)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocInfo{};
+		// The pools are big and live as long as the renderer, they get their own memory blocks
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+		if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &outBuffer, &outMemory, nullptr) != VK_SUCCESS)
+		{
+			std::cerr << "Failed to create geometry pool buffer!" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+}
+
+bool GeometryPool::Initialize(VmaAllocator allocator)
+{
+	const std::array<uint32_t, 2> capacities = { STATIC_VERTEX_POOL_CAPACITY, SKINNED_VERTEX_POOL_CAPACITY };
+
+	bool success = true;
+	for (size_t i = 0; i < vertexPools.size(); ++i)
+	{
+		VertexPool& pool = vertexPools[i];
+		const EVertexLayout layout = static_cast<EVertexLayout>(i);
+
+		success &= CreatePoolBuffer(allocator, VkDeviceSize(capacities[i]) * GetPositionStride(layout), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pool.positionBuffer, pool.positionMemory);
+		success &= CreatePoolBuffer(allocator, VkDeviceSize(capacities[i]) * sizeof(VertexAttributes), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pool.attributeBuffer, pool.attributeMemory);
+		pool.vertices.Initialize(capacities[i]);
+	}
+
+	success &= CreatePoolBuffer(allocator, INDEX_POOL_CAPACITY, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexMemory);
+	indices.Initialize(INDEX_POOL_CAPACITY);
+
+	return success;
+}
+
+void GeometryPool::Destroy(VmaAllocator allocator)
+{
+	for (VertexPool& pool : vertexPools)
+	{
+		vmaDestroyBuffer(allocator, pool.positionBuffer, pool.positionMemory);
+		vmaDestroyBuffer(allocator, pool.attributeBuffer, pool.attributeMemory);
+		pool = VertexPool{};
+	}
+
+	vmaDestroyBuffer(allocator, indexBuffer, indexMemory);
+	indexBuffer = VK_NULL_HANDLE;
+	indexMemory = VK_NULL_HANDLE;
+}
+
+bool GeometryPool::Allocate(EVertexLayout layout, uint32_t vertexCount, uint32_t indexSize, MeshRenderData& outRenderData)
+{
+	RangeAllocator& vertices = vertexPools[static_cast<uint8_t>(layout)].vertices;
+
+	uint32_t baseVertex = 0;
+	if (!vertices.Allocate(vertexCount, 1, baseVertex))
+	{
+		std::cerr << "Failed to allocate mesh vertices, the geometry pool is full!" << std::endl;
+		return false;
+	}
+
+	// 4 bytes aligned so the first index of both index types is a whole number
+	uint32_t indexOffset = 0;
+	if (!indices.Allocate(indexSize, sizeof(uint32_t), indexOffset))
+	{
+		std::cerr << "Failed to allocate mesh indices, the geometry pool is full!" << std::endl;
+		vertices.Free(baseVertex, vertexCount);
+		return false;
+	}
+
+	outRenderData.layout = layout;
+	outRenderData.baseVertex = baseVertex;
+	outRenderData.vertexCount = vertexCount;
+	outRenderData.indexOffset = indexOffset;
+	outRenderData.indexSize = indexSize;
+
+	return true;
+}
+
+void GeometryPool::Free(const MeshRenderData& renderData)
+{
+	vertexPools[static_cast<uint8_t>(renderData.layout)].vertices.Free(renderData.baseVertex, renderData.vertexCount);
+	indices.Free(renderData.indexOffset, renderData.indexSize);
+}
+
+uint32_t GeometryPool::GetPositionStride(EVertexLayout layout)
+{
+	return layout == EVertexLayout::Skinned ? sizeof(SkinnedPosition) : sizeof(StaticPosition);
+}
+
+void GeometryPool::Begin(VkCommandBuffer inCmdBuffer)
+{
+	cmdBuffer = inCmdBuffer;
+	Invalidate();
+}
+
+void GeometryPool::BindVertexBuffers(EVertexLayout layout, bool withAttributes)
+{
+	const VertexPool& pool = vertexPools[static_cast<uint8_t>(layout)];
+	if (boundPositionBuffer == pool.positionBuffer && (areAttributesBound || !withAttributes))
+	{
+		return;
+	}
+
+	const std::array<VkBuffer, 2> buffers = { pool.positionBuffer, pool.attributeBuffer };
+	const std::array<VkDeviceSize, 2> zeroOffsets = { 0, 0 };
+	vkCmdBindVertexBuffers(cmdBuffer, 0, withAttributes ? 2 : 1, buffers.data(), zeroOffsets.data());
+
+	areAttributesBound = withAttributes;
+	boundPositionBuffer = pool.positionBuffer;
+}
+
+void GeometryPool::BindIndexBuffer(VkIndexType indexType)
+{
+	if (indexType == boundIndexType)
+	{
+		return;
+	}
+
+	vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, indexType);
+	boundIndexType = indexType;
+}
+
+void GeometryPool::Invalidate()
+{
+	boundPositionBuffer = VK_NULL_HANDLE;
+	areAttributesBound = false;
+	boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+}
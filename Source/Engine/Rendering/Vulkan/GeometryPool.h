@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Rendering/AbstractData.h"
+#include "Rendering/Geometry/RangeAllocator.h"
+
+#include <array>
+#include <cstdint>
+#include <vma/vk_mem_alloc.h>
+#include <volk.h>
+
+// Vertices each layout's buffers can hold, a static vertex takes 20 bytes and a skinned one 28
+constexpr uint32_t STATIC_VERTEX_POOL_CAPACITY = 1 << 21;
+constexpr uint32_t SKINNED_VERTEX_POOL_CAPACITY = 1 << 19;
+// Bytes of the index buffer shared by both layouts
+constexpr uint32_t INDEX_POOL_CAPACITY = 64 << 20;
+
+/// <summary>
+/// Vertex and index buffers shared by every mesh, each mesh gets a range of vertices and a range of indices in them.
+/// The static and skinned layouts have their own vertex buffers since their positions don't have the same stride,
+/// so the buffers are only rebound when the pipeline changes layout instead of for each model.
+/// </summary>
+class GeometryPool
+{
+public:
+	bool Initialize(VmaAllocator allocator);
+	void Destroy(VmaAllocator allocator);
+
+	// Fills the ranges of the render data. Returns false when the pool is full
+	bool Allocate(EVertexLayout layout, uint32_t vertexCount, uint32_t indexSize, MeshRenderData& outRenderData);
+	// The ranges must not be read by a frame in flight anymore
+	void Free(const MeshRenderData& renderData);
+
+	static uint32_t GetPositionStride(EVertexLayout layout);
+
+	VkBuffer GetPositionBuffer(EVertexLayout layout) const { return vertexPools[static_cast<uint8_t>(layout)].positionBuffer; }
+	VkBuffer GetAttributeBuffer(EVertexLayout layout) const { return vertexPools[static_cast<uint8_t>(layout)].attributeBuffer; }
+	VkBuffer GetIndexBuffer() const { return indexBuffer; }
+
+	// Starts tracking the buffers bound on a command buffer that was just begun
+	void Begin(VkCommandBuffer inCmdBuffer);
+	// The depth only passes skip the shading attributes
+	void BindVertexBuffers(EVertexLayout layout, bool withAttributes);
+	// The submeshes mix 16 and 32 bit indices, the buffer is rebound when the index type changes
+	void BindIndexBuffer(VkIndexType indexType);
+	// For the code binding its own vertex or index buffers
+	void Invalidate();
+
+private:
+	struct VertexPool
+	{
+		VkBuffer positionBuffer = VK_NULL_HANDLE;
+		VmaAllocation positionMemory = VK_NULL_HANDLE;
+		VkBuffer attributeBuffer = VK_NULL_HANDLE;
+		VmaAllocation attributeMemory = VK_NULL_HANDLE;
+
+		RangeAllocator vertices;
+	};
+
+	std::array<VertexPool, 2> vertexPools;
+
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	VmaAllocation indexMemory = VK_NULL_HANDLE;
+	RangeAllocator indices;
+
+	VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+	VkBuffer boundPositionBuffer = VK_NULL_HANDLE;
+	bool areAttributesBound = false;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+};
@@ -0,0 +1,380 @@
+#include "GpuCulling.h"
+#include "Rendering/Culling/Frustum.h"
+#include "Utilities/FileHelper.h"
+#include "VkContext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// Each frame in flight owns a copy of the buffers, aligned for the storage buffer offsets
+	constexpr uint32_t DRAW_BUFFER_FRAME_SIZE = (sizeof(CulledDrawLayout) * MAX_CULLED_DRAWS + 255) & ~255u;
+	constexpr uint32_t COMMAND_BUFFER_FRAME_SIZE = (sizeof(VkDrawIndexedIndirectCommand) * MAX_CULLED_DRAWS + 255) & ~255u;
+	// Visible instances of each draw then the compacted draws of each batch
+	constexpr uint32_t COUNT_BUFFER_FRAME_SIZE = (sizeof(uint32_t) * (MAX_CULLED_DRAWS + MAX_CULLED_BATCHES) + 255) & ~255u;
+	constexpr uint32_t VIEW_BUFFER_FRAME_SIZE = (sizeof(CullViewLayout) + 255) & ~255u;
+
+	constexpr uint32_t CULLING_GROUP_SIZE = 64;
+
+	enum ECullingPhase : uint32_t
+	{
+		Instances = 0,
+		Draws = 1
+	};
+
+	struct CullConstants
+	{
+		uint32_t instanceCount = 0;
+		uint32_t drawCount = 0;
+		uint32_t phase = ECullingPhase::Instances;
+	};
+
+	bool CreateCullingBuffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags, VkBuffer& outBuffer, VmaAllocation& outMemory, void** outMapped)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = memoryUsage;
+		allocInfo.flags = flags;
+
+		VmaAllocationInfo allocationInfo{};
+		if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &outBuffer, &outMemory, &allocationInfo) != VK_SUCCESS)
+		{
+			std::cerr << "Failed to create culling buffer!" << std::endl;
+			return false;
+		}
+
+		if (outMapped != nullptr)
+		{
+			*outMapped = allocationInfo.pMappedData;
+		}
+
+		return true;
+	}
+}
+
+bool GpuCulling::Initialize(const VkContext& context)
+{
+	bool success = CreateCullingBuffer(context.allocator,
+		VkDeviceSize(DRAW_BUFFER_FRAME_SIZE) * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		drawBuffer,
+		drawMemory,
+		&mappedDraws);
+
+	// Only ever written by the culling
+	success &= CreateCullingBuffer(context.allocator,
+		VkDeviceSize(COMMAND_BUFFER_FRAME_SIZE) * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+		0,
+		commandBuffer,
+		commandMemory,
+		nullptr);
+
+	success &= CreateCullingBuffer(context.allocator,
+		VkDeviceSize(COUNT_BUFFER_FRAME_SIZE) * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_AUTO,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		countBuffer,
+		countMemory,
+		&mappedCounts);
+
+	success &= CreateCullingBuffer(context.allocator,
+		VkDeviceSize(VIEW_BUFFER_FRAME_SIZE) * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		viewBuffer,
+		viewMemory,
+		&mappedViews);
+
+	return success && CreatePipeline(context);
+}
+
+bool GpuCulling::CreatePipeline(const VkContext& context)
+{
+	// Instances, culled draws, visible instances, indirect commands and counts then the view and the Hi-Z pyramid
+	std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindings.size();
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(context.device, &layoutInfo, nullptr, &descriptorLayout) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create descriptor set layout for the culling!" << std::endl;
+		return false;
+	}
+
+	std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+	layouts.fill(descriptorLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = context.descriptorPool;
+	allocInfo.descriptorSetCount = layouts.size();
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(context.device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to allocate the culling descriptor sets!" << std::endl;
+		return false;
+	}
+
+	VkPushConstantRange pushConstant{};
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(CullConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+
+	if (vkCreatePipelineLayout(context.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create pipeline layout!" << std::endl;
+		return false;
+	}
+
+	const std::vector<char> shaderCode = FileHelper::ReadFile(shaderPath + "/comp.spv");
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = shaderCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(context.device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create shader module!" << std::endl;
+		return false;
+	}
+
+	const uint32_t maxCulledDraws = MAX_CULLED_DRAWS;
+
+	VkSpecializationMapEntry specializationEntry{};
+	specializationEntry.constantID = 0;
+	specializationEntry.offset = 0;
+	specializationEntry.size = sizeof(uint32_t);
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(uint32_t);
+	specializationInfo.pData = &maxCulledDraws;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+	pipelineInfo.layout = pipelineLayout;
+
+	const bool success = vkCreateComputePipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) == VK_SUCCESS;
+	if (!success)
+	{
+		std::cerr << "Failed to create culling pipeline!" << std::endl;
+	}
+
+	vkDestroyShaderModule(context.device, shaderModule, nullptr);
+
+	return success;
+}
+
+void GpuCulling::Destroy(const VkContext& context)
+{
+	vkDestroyPipeline(context.device, pipeline, nullptr);
+	vkDestroyPipelineLayout(context.device, pipelineLayout, nullptr);
+	vkFreeDescriptorSets(context.device, context.descriptorPool, descriptorSets.size(), descriptorSets.data());
+	vkDestroyDescriptorSetLayout(context.device, descriptorLayout, nullptr);
+
+	vmaDestroyBuffer(context.allocator, drawBuffer, drawMemory);
+	vmaDestroyBuffer(context.allocator, commandBuffer, commandMemory);
+	vmaDestroyBuffer(context.allocator, countBuffer, countMemory);
+	vmaDestroyBuffer(context.allocator, viewBuffer, viewMemory);
+
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorLayout = VK_NULL_HANDLE;
+	descriptorSets.fill(VK_NULL_HANDLE);
+	drawBuffer = VK_NULL_HANDLE;
+	commandBuffer = VK_NULL_HANDLE;
+	countBuffer = VK_NULL_HANDLE;
+	viewBuffer = VK_NULL_HANDLE;
+	mappedDraws = nullptr;
+	mappedCounts = nullptr;
+	mappedViews = nullptr;
+}
+
+void GpuCulling::SetInstanceBuffers(const VkContext& context, VkBuffer instanceBuffer, VkBuffer visibleInstanceBuffer)
+{
+	for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame)
+	{
+		const std::array<VkDescriptorBufferInfo, 5> bufferInfos =
+		{
+			VkDescriptorBufferInfo{ instanceBuffer, VkDeviceSize(INSTANCE_BUFFER_FRAME_SIZE) * frame, INSTANCE_BUFFER_FRAME_SIZE },
+			VkDescriptorBufferInfo{ drawBuffer, VkDeviceSize(DRAW_BUFFER_FRAME_SIZE) * frame, DRAW_BUFFER_FRAME_SIZE },
+			VkDescriptorBufferInfo{ visibleInstanceBuffer, VkDeviceSize(VISIBLE_INSTANCE_BUFFER_FRAME_SIZE) * frame, VISIBLE_INSTANCE_BUFFER_FRAME_SIZE },
+			VkDescriptorBufferInfo{ commandBuffer, VkDeviceSize(COMMAND_BUFFER_FRAME_SIZE) * frame, COMMAND_BUFFER_FRAME_SIZE },
+			VkDescriptorBufferInfo{ countBuffer, VkDeviceSize(COUNT_BUFFER_FRAME_SIZE) * frame, COUNT_BUFFER_FRAME_SIZE }
+		};
+
+		const VkDescriptorBufferInfo viewInfo{ viewBuffer, VkDeviceSize(VIEW_BUFFER_FRAME_SIZE) * frame, sizeof(CullViewLayout) };
+
+		std::array<VkWriteDescriptorSet, 6> writes{};
+		for (uint32_t i = 0; i < writes.size(); ++i)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSets[frame];
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+		}
+
+		for (uint32_t i = 0; i < bufferInfos.size(); ++i)
+		{
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		writes[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		writes[5].pBufferInfo = &viewInfo;
+
+		vkUpdateDescriptorSets(context.device, writes.size(), writes.data(), 0, nullptr);
+	}
+}
+
+void GpuCulling::SetOcclusionPyramid(const VkContext& context, VkImageView pyramidView, VkSampler sampler)
+{
+	// Kept in the general layout, it is written by the pyramid's build and sampled here
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+	imageInfo.imageView = pyramidView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	std::array<VkWriteDescriptorSet, MAX_FRAMES_IN_FLIGHT> writes{};
+	for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame)
+	{
+		writes[frame].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[frame].dstSet = descriptorSets[frame];
+		writes[frame].dstBinding = 6;
+		writes[frame].descriptorCount = 1;
+		writes[frame].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[frame].pImageInfo = &imageInfo;
+	}
+
+	vkUpdateDescriptorSets(context.device, writes.size(), writes.data(), 0, nullptr);
+}
+
+void GpuCulling::Dispatch(VkCommandBuffer cmdBuffer, uint32_t frame, const Frustum& frustum, const glm::mat4& occlusionViewProjection, bool testOcclusion, uint32_t instanceCount, const std::vector<CulledDrawLayout>& draws)
+{
+	const uint32_t drawCount = static_cast<uint32_t>(std::min<size_t>(draws.size(), MAX_CULLED_DRAWS));
+	dispatchedDraws[frame] = drawCount;
+
+	// This frame's copy isn't read anymore, its fence was waited on before recording
+	memcpy(static_cast<char*>(mappedDraws) + DRAW_BUFFER_FRAME_SIZE * frame, draws.data(), sizeof(CulledDrawLayout) * drawCount);
+
+	CullViewLayout cullView{};
+	memcpy(cullView.planes, frustum.planes.data(), sizeof(cullView.planes));
+	cullView.occlusionViewProjection = occlusionViewProjection;
+	cullView.testOcclusion = testOcclusion ? 1 : 0;
+	memcpy(static_cast<char*>(mappedViews) + VIEW_BUFFER_FRAME_SIZE * frame, &cullView, sizeof(CullViewLayout));
+
+	vkCmdFillBuffer(cmdBuffer, countBuffer, VkDeviceSize(COUNT_BUFFER_FRAME_SIZE) * frame, COUNT_BUFFER_FRAME_SIZE, 0);
+
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	// Each frame culls into its own copy of the buffers, only the cleared counts need to be waited on
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+
+	CullConstants constants{};
+	constants.instanceCount = instanceCount;
+	constants.drawCount = drawCount;
+
+	constants.phase = ECullingPhase::Instances;
+	vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+	vkCmdDispatch(cmdBuffer, (instanceCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+	// The draws read the instance counts of phase 0
+	VkMemoryBarrier phaseBarrier{};
+	phaseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	phaseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	phaseBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &phaseBarrier, 0, nullptr, 0, nullptr);
+
+	constants.phase = ECullingPhase::Draws;
+	vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+	vkCmdDispatch(cmdBuffer, (drawCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier drawBarrier{};
+	drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCulling::DrawBatch(VkCommandBuffer cmdBuffer, uint32_t frame, uint32_t batch, uint32_t firstDraw, uint32_t drawCapacity) const
+{
+	const VkDeviceSize commandOffset = VkDeviceSize(COMMAND_BUFFER_FRAME_SIZE) * frame + sizeof(VkDrawIndexedIndirectCommand) * firstDraw;
+	const VkDeviceSize countOffset = VkDeviceSize(COUNT_BUFFER_FRAME_SIZE) * frame + sizeof(uint32_t) * (MAX_CULLED_DRAWS + batch);
+
+	vkCmdDrawIndexedIndirectCount(cmdBuffer,
+		commandBuffer,
+		commandOffset,
+		countBuffer,
+		countOffset,
+		drawCapacity,
+		sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuCulling::GetVisibleInstances(const VkContext& context, uint32_t frame, const uint32_t* visibleIds, std::vector<uint32_t>& outInstances) const
+{
+	vmaInvalidateAllocation(context.allocator, countMemory, VkDeviceSize(COUNT_BUFFER_FRAME_SIZE) * frame, COUNT_BUFFER_FRAME_SIZE);
+
+	const uint32_t* counts = reinterpret_cast<const uint32_t*>(static_cast<const char*>(mappedCounts) + COUNT_BUFFER_FRAME_SIZE * frame);
+	const CulledDrawLayout* draws = reinterpret_cast<const CulledDrawLayout*>(static_cast<const char*>(mappedDraws) + DRAW_BUFFER_FRAME_SIZE * frame);
+
+	// Each draw's visible instances were compacted at the start of its range
+	outInstances.clear();
+	for (uint32_t i = 0; i < dispatchedDraws[frame]; ++i)
+	{
+		outInstances.insert(outInstances.end(), visibleIds + draws[i].firstInstance, visibleIds + draws[i].firstInstance + counts[i]);
+	}
+
+	std::sort(outInstances.begin(), outInstances.end());
+}
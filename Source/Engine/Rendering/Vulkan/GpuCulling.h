@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Rendering/AbstractData.h"
+#include "Rendering/Queue/InstanceData.h"
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <vma/vk_mem_alloc.h>
+#include <volk.h>
+
+struct Frustum;
+struct VkContext;
+
+// Uniform data of a frame's culling, laid out like the shader's std140 block
+struct CullViewLayout
+{
+	glm::vec4 planes[6];
+	glm::mat4 occlusionViewProjection = glm::mat4(1.0f);
+	uint32_t testOcclusion = 0;
+};
+
+/// <summary>
+/// Frustum and occlusion culls the main pass' instances on the GPU. Each culled draw is an instance group, its visible
+/// instances are compacted at the start of its range of the visible instance buffer and the draws that kept instances
+/// are compacted into indirect commands at the start of their batch, so a batch is a single vkCmdDrawIndexedIndirectCount.
+/// The occlusion is tested against the Hi-Z pyramid of the previous frame's depth.
+/// </summary>
+class GpuCulling
+{
+public:
+	bool Initialize(const VkContext& context);
+	void Destroy(const VkContext& context);
+
+	// The buffers holding a copy per frame in flight of the instances and of the ids the vertex shaders read
+	void SetInstanceBuffers(const VkContext& context, VkBuffer instanceBuffer, VkBuffer visibleInstanceBuffer);
+	// Must be set before the first dispatch and again when the pyramid is recreated, even when occlusion isn't tested
+	void SetOcclusionPyramid(const VkContext& context, VkImageView pyramidView, VkSampler sampler);
+
+	// Uploads the frame's draws and records the culling outside of a render pass, the batches can be drawn after it.
+	// The occlusion is tested with the view projection the pyramid was built with
+	void Dispatch(VkCommandBuffer cmdBuffer, uint32_t frame, const Frustum& frustum, const glm::mat4& occlusionViewProjection, bool testOcclusion, uint32_t instanceCount, const std::vector<CulledDrawLayout>& draws);
+	// Draws the batch's compacted commands, the batch owns the commands [firstDraw, firstDraw + drawCapacity)
+	void DrawBatch(VkCommandBuffer cmdBuffer, uint32_t frame, uint32_t batch, uint32_t firstDraw, uint32_t drawCapacity) const;
+
+	// Instances the frame's last culling kept, sorted. Only valid once the frame's fence was signaled, visibleIds is the
+	// frame's mapped copy of the visible instance buffer
+	void GetVisibleInstances(const VkContext& context, uint32_t frame, const uint32_t* visibleIds, std::vector<uint32_t>& outInstances) const;
+
+private:
+	bool CreatePipeline(const VkContext& context);
+
+	const std::string shaderPath = "Data/Engine/Shaders/Culling";
+
+	VkDescriptorSetLayout descriptorLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+
+	// Written by the CPU each frame, persistently mapped
+	VkBuffer drawBuffer = VK_NULL_HANDLE;
+	VmaAllocation drawMemory = VK_NULL_HANDLE;
+	void* mappedDraws = nullptr;
+
+	VkBuffer commandBuffer = VK_NULL_HANDLE;
+	VmaAllocation commandMemory = VK_NULL_HANDLE;
+
+	// Read back for the debug output
+	VkBuffer countBuffer = VK_NULL_HANDLE;
+	VmaAllocation countMemory = VK_NULL_HANDLE;
+	void* mappedCounts = nullptr;
+
+	VkBuffer viewBuffer = VK_NULL_HANDLE;
+	VmaAllocation viewMemory = VK_NULL_HANDLE;
+	void* mappedViews = nullptr;
+
+	std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> dispatchedDraws{};
+};
@@ -0,0 +1,350 @@
+#include "HiZPyramid.h"
+#include "Utilities/FileHelper.h"
+#include "VkContext.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iostream>
+
+namespace
+{
+	constexpr uint32_t HIZ_GROUP_SIZE = 8;
+	constexpr VkFormat HIZ_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+	uint32_t GetGroupCount(uint32_t size)
+	{
+		return (size + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE;
+	}
+}
+
+bool HiZPyramid::Initialize(const VkContext& context)
+{
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+	for (VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindings.size();
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(context.device, &layoutInfo, nullptr, &descriptorLayout) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create descriptor set layout for the Hi-Z pyramid!" << std::endl;
+		return false;
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorLayout;
+
+	if (vkCreatePipelineLayout(context.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create pipeline layout!" << std::endl;
+		return false;
+	}
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(context.device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create Hi-Z sampler!" << std::endl;
+		return false;
+	}
+
+	bool success = CreatePipeline(context, depthShaderPath, depthPipeline);
+	success &= CreatePipeline(context, reduceShaderPath, reducePipeline);
+
+	return success;
+}
+
+bool HiZPyramid::CreatePipeline(const VkContext& context, const std::string& shaderPath, VkPipeline& outPipeline)
+{
+	const std::vector<char> shaderCode = FileHelper::ReadFile(shaderPath + "/comp.spv");
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = shaderCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(context.device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create shader module!" << std::endl;
+		return false;
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	const bool success = vkCreateComputePipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &outPipeline) == VK_SUCCESS;
+	if (!success)
+	{
+		std::cerr << "Failed to create Hi-Z pipeline!" << std::endl;
+	}
+
+	vkDestroyShaderModule(context.device, shaderModule, nullptr);
+
+	return success;
+}
+
+void HiZPyramid::Destroy(const VkContext& context)
+{
+	DestroyPyramid(context);
+
+	vkDestroyPipeline(context.device, depthPipeline, nullptr);
+	vkDestroyPipeline(context.device, reducePipeline, nullptr);
+	vkDestroyPipelineLayout(context.device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, descriptorLayout, nullptr);
+	vkDestroySampler(context.device, sampler, nullptr);
+
+	depthPipeline = VK_NULL_HANDLE;
+	reducePipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorLayout = VK_NULL_HANDLE;
+	sampler = VK_NULL_HANDLE;
+}
+
+bool HiZPyramid::CreatePyramid(const VkContext& context, const std::vector<VkImageView>& depthViews)
+{
+	const VkExtent2D extent = context.swapChainExtent;
+	const uint32_t levelCount = std::bit_width(std::max(extent.width, extent.height));
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent = { extent.width, extent.height, 1 };
+	imageInfo.mipLevels = levelCount;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = HIZ_FORMAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+	if (vmaCreateImage(context.allocator, &imageInfo, &allocInfo, &image, &memory, nullptr) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create Hi-Z pyramid!" << std::endl;
+		return false;
+	}
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = HIZ_FORMAT;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = levelCount;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(context.device, &viewInfo, nullptr, &pyramidView) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create Hi-Z pyramid view!" << std::endl;
+		return false;
+	}
+
+	// The storage images are bound one level at a time
+	levelViews.resize(levelCount, VK_NULL_HANDLE);
+	levelExtents.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+
+		if (vkCreateImageView(context.device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+		{
+			std::cerr << "Failed to create Hi-Z level view!" << std::endl;
+			return false;
+		}
+
+		levelExtents[level] = { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+	}
+
+	// The first level reads the multisampled depth, without MSAA the pyramid is never built and the occlusion isn't tested
+	const uint32_t depthSetCount = context.msaaSamples != VK_SAMPLE_COUNT_1_BIT ? static_cast<uint32_t>(depthViews.size()) : 0;
+	depthSets.resize(depthSetCount, VK_NULL_HANDLE);
+	levelSets.resize(levelCount - 1, VK_NULL_HANDLE);
+
+	std::vector<VkDescriptorSetLayout> layouts(depthSets.size() + levelSets.size(), descriptorLayout);
+	std::vector<VkDescriptorSet> sets(layouts.size(), VK_NULL_HANDLE);
+
+	if (!sets.empty())
+	{
+		VkDescriptorSetAllocateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = context.descriptorPool;
+		setInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+		setInfo.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(context.device, &setInfo, sets.data()) != VK_SUCCESS)
+		{
+			std::cerr << "Failed to allocate the Hi-Z descriptor sets!" << std::endl;
+			return false;
+		}
+	}
+
+	std::copy(sets.begin(), sets.begin() + depthSets.size(), depthSets.begin());
+	std::copy(sets.begin() + depthSets.size(), sets.end(), levelSets.begin());
+
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	imageInfos.reserve((depthSets.size() + levelSets.size()) * 2);
+
+	std::vector<VkWriteDescriptorSet> writes;
+	writes.reserve(imageInfos.capacity());
+
+	auto addWrite = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view, VkImageLayout layout)
+		{
+			imageInfos.push_back(VkDescriptorImageInfo{ type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ? sampler : VK_NULL_HANDLE, view, layout });
+
+			VkWriteDescriptorSet& write = writes.emplace_back();
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.descriptorCount = 1;
+			write.descriptorType = type;
+			write.pImageInfo = &imageInfos.back();
+		};
+
+	for (uint32_t i = 0; i < depthSets.size(); ++i)
+	{
+		addWrite(depthSets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		addWrite(depthSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL);
+	}
+
+	for (uint32_t level = 1; level < levelCount; ++level)
+	{
+		addWrite(levelSets[level - 1], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+		addWrite(levelSets[level - 1], 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+	}
+
+	vkUpdateDescriptorSets(context.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	isLayoutInitialized = false;
+	isBuilt = false;
+
+	return true;
+}
+
+void HiZPyramid::DestroyPyramid(const VkContext& context)
+{
+	std::vector<VkDescriptorSet> sets = depthSets;
+	sets.insert(sets.end(), levelSets.begin(), levelSets.end());
+	std::erase(sets, VK_NULL_HANDLE);
+
+	if (!sets.empty())
+	{
+		vkFreeDescriptorSets(context.device, context.descriptorPool, static_cast<uint32_t>(sets.size()), sets.data());
+	}
+
+	for (VkImageView view : levelViews)
+	{
+		vkDestroyImageView(context.device, view, nullptr);
+	}
+
+	vkDestroyImageView(context.device, pyramidView, nullptr);
+	vmaDestroyImage(context.allocator, image, memory);
+
+	depthSets.clear();
+	levelSets.clear();
+	levelViews.clear();
+	levelExtents.clear();
+	pyramidView = VK_NULL_HANDLE;
+	image = VK_NULL_HANDLE;
+	memory = VK_NULL_HANDLE;
+	isLayoutInitialized = false;
+	isBuilt = false;
+}
+
+void HiZPyramid::InitializeLayout(VkCommandBuffer cmdBuffer)
+{
+	if (isLayoutInitialized)
+	{
+		return;
+	}
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = static_cast<uint32_t>(levelViews.size());
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	isLayoutInitialized = true;
+}
+
+void HiZPyramid::Build(VkCommandBuffer cmdBuffer, uint32_t depthIndex)
+{
+	if (depthIndex >= depthSets.size())
+	{
+		return;
+	}
+
+	// The culling read the previous pyramid earlier in the frame, overwriting it only needs an execution dependency
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &depthSets[depthIndex], 0, nullptr);
+	vkCmdDispatch(cmdBuffer, GetGroupCount(levelExtents[0].width), GetGroupCount(levelExtents[0].height), 1);
+
+	VkMemoryBarrier levelBarrier{};
+	levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+	for (uint32_t level = 1; level < levelViews.size(); ++level)
+	{
+		// Each level reads the one written just before
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &levelSets[level - 1], 0, nullptr);
+		vkCmdDispatch(cmdBuffer, GetGroupCount(levelExtents[level].width), GetGroupCount(levelExtents[level].height), 1);
+	}
+
+	// Sampled by the next frame's culling
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+	isBuilt = true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vma/vk_mem_alloc.h>
+#include <volk.h>
+
+struct VkContext;
+
+/// <summary>
+/// Mip chain of the main pass' depth where each texel keeps the farthest depth it covers. The culling projects the
+/// instances' bounds with the view the pyramid was built with, a box behind the farthest depth of its texels is hidden.
+/// </summary>
+class HiZPyramid
+{
+public:
+	bool Initialize(const VkContext& context);
+	void Destroy(const VkContext& context);
+
+	// Sized like the swap chain, one first level descriptor per depth image. The previous pyramid must be destroyed
+	bool CreatePyramid(const VkContext& context, const std::vector<VkImageView>& depthViews);
+	void DestroyPyramid(const VkContext& context);
+
+	// The pyramid is kept in the general layout, it has to leave the undefined layout before the culling samples it
+	void InitializeLayout(VkCommandBuffer cmdBuffer);
+	// Outside of a render pass, the depth image must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	void Build(VkCommandBuffer cmdBuffer, uint32_t depthIndex);
+
+	// False until a depth was reduced into the current pyramid
+	bool IsBuilt() const { return isBuilt; }
+
+	VkImageView GetView() const { return pyramidView; }
+	VkSampler GetSampler() const { return sampler; }
+
+private:
+	bool CreatePipeline(const VkContext& context, const std::string& shaderPath, VkPipeline& outPipeline);
+
+	const std::string depthShaderPath = "Data/Engine/Shaders/HiZDepth";
+	const std::string reduceShaderPath = "Data/Engine/Shaders/HiZ";
+
+	// Shared by both pipelines: the depth, the level above and the level written
+	VkDescriptorSetLayout descriptorLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline depthPipeline = VK_NULL_HANDLE;
+	VkPipeline reducePipeline = VK_NULL_HANDLE;
+	// Nearest, the pyramid and the depth are only fetched
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	VkImage image = VK_NULL_HANDLE;
+	VmaAllocation memory = VK_NULL_HANDLE;
+	VkImageView pyramidView = VK_NULL_HANDLE;
+	std::vector<VkImageView> levelViews;
+	std::vector<VkExtent2D> levelExtents;
+
+	// Reads a depth image into the first level
+	std::vector<VkDescriptorSet> depthSets;
+	// Reads the level above into each level after the first
+	std::vector<VkDescriptorSet> levelSets;
+
+	bool isLayoutInitialized = false;
+	bool isBuilt = false;
+};
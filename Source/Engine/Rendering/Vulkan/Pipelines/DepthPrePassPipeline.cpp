@@ -0,0 +1,206 @@
+#include "DepthPrePassPipeline.h"
+#include "AssetManager/Animation/BoneData.h"
+#include "AssetManager/Model/MeshData.h"
+#include "Rendering/Descriptors/DescriptorRegistry.h"
+#include "Rendering/RenderingInterface.h"
+#include "Rendering/Vulkan/RenderUtilities.h"
+#include "Utilities/FileHelper.h"
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+DepthPrePassPipeline::DepthPrePassPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface, EVertexLayout inVertexLayout)
+	: RenderPipeline(inContext, inRenderingInterface), vertexLayout(inVertexLayout)
+{
+	// SHADER STAGES
+	// Vertex only, the depth is written without a fragment stage
+	const std::string vertShaderPath = (vertexLayout == EVertexLayout::Skinned ? skinnedShaderPath : shaderPath) + "/vert.spv";
+	auto vertShaderCode = FileHelper::ReadFile(vertShaderPath);
+
+	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+
+	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageInfo.pNext = nullptr;
+	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageInfo.module = vertShaderModule;
+	vertShaderStageInfo.pName = "main";
+
+	VkSpecializationInfo vertexSpecializationInfo{};
+	std::array<uint32_t, 2> vertexSpecData =
+	{
+		MAX_BONES,
+		MAX_BONE_INFLUENCE
+	};
+	vertexSpecializationInfo.pData = vertexSpecData.data();
+	vertexSpecializationInfo.dataSize = vertexSpecData.size() * sizeof(uint32_t);
+
+	std::array<VkSpecializationMapEntry, 2> vertSpecializationMap =
+	{
+		VkSpecializationMapEntry
+		{
+			.constantID = 0,
+			.offset = 0,
+			.size = sizeof(uint32_t)
+		},
+		VkSpecializationMapEntry
+		{
+			.constantID = 1,
+			.offset = sizeof(uint32_t),
+			.size = sizeof(uint32_t)
+		}
+	};
+
+	vertexSpecializationInfo.pMapEntries = vertSpecializationMap.data();
+	vertexSpecializationInfo.mapEntryCount = vertSpecializationMap.size();
+	vertShaderStageInfo.pSpecializationInfo = &vertexSpecializationInfo;
+	// *******
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.pNext = nullptr;
+
+	std::array<VkVertexInputBindingDescription, 1> bindingDescriptions{};
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+
+	bindingDescriptions[0].binding = 0;
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	// Same formats as the PBR pipeline's position stream, the attribute stream isn't bound
+	if (vertexLayout == EVertexLayout::Skinned)
+	{
+		bindingDescriptions[0].stride = sizeof(SkinnedPosition);
+
+		attributeDescriptions =
+		{
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(SkinnedPosition, position) },
+			{ 1, 0, VK_FORMAT_R8G8B8A8_UINT, offsetof(SkinnedPosition, boneIDs) },
+			{ 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(SkinnedPosition, weights) }
+		};
+	}
+	else
+	{
+		bindingDescriptions[0].stride = sizeof(StaticPosition);
+
+		attributeDescriptions =
+		{
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(StaticPosition, position) }
+		};
+	}
+
+	vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+	// *************
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.pNext = nullptr;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+	inputAssembly.pNext = nullptr;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+	viewportState.pNext = nullptr;
+
+	// Must rasterize like the PBR pipeline for the color pass' EQUAL test
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.depthBiasEnable = VK_FALSE;
+	rasterizer.depthBiasConstantFactor = 0.0f;
+	rasterizer.depthBiasClamp = 0.0f;
+	rasterizer.depthBiasSlopeFactor = 0.0f;
+	rasterizer.pNext = nullptr;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = context.msaaSamples;
+	multisampling.pSampleMask = nullptr;
+	multisampling.alphaToCoverageEnable = VK_FALSE;
+	multisampling.alphaToOneEnable = VK_FALSE;
+	multisampling.pNext = nullptr;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 0;
+	colorBlending.pAttachments = nullptr;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.pNext = nullptr;
+
+	// The camera set holds the instances and the visible instance ids, the animation set the skinned meshes' bones
+	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{};
+	if (const DescriptorRegistry* registry = renderingInterface->GetDescriptorRegistry())
+	{
+		descriptorSetLayouts[0] = RenderUtilities::GenericHandleToDescriptorSetLayout(registry->GetCameraMatricesLayout().layout);
+		descriptorSetLayouts[1] = RenderUtilities::GenericHandleToDescriptorSetLayout(registry->GetAnimationLayout().layout);
+	}
+
+	flags = MATRICES_DESCRIPTOR_FLAG | ANIMATION_DESCRIPTOR_FLAG;
+
+	pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+
+	if (vkCreatePipelineLayout(context.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create pipeline layout!" << std::endl;
+	}
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.minDepthBounds = 0.0f;
+	depthStencil.maxDepthBounds = 1.0f;
+	depthStencil.stencilTestEnable = VK_FALSE;
+	depthStencil.front = {};
+	depthStencil.back = {};
+	depthStencil.pNext = nullptr;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 1;
+	pipelineInfo.pStages = &vertShaderStageInfo;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.renderPass = context.depthPrePass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+	pipelineInfo.pNext = nullptr;
+
+	if (vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create graphics pipeline!" << std::endl;
+	}
+
+	vkDestroyShaderModule(context.device, vertShaderModule, nullptr);
+}
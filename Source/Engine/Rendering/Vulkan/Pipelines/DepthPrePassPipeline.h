@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Rendering/AbstractData.h"
+#include "Rendering/Vulkan/RenderPipeline.h"
+
+/// <summary>
+/// Depth only variant of the PBR pipeline, it lays down the main pass' depth so the color pass only shades the
+/// visible fragments. Only reads the position (+ skinning) stream.
+/// </summary>
+class DepthPrePassPipeline : public RenderPipeline
+{
+public:
+	DepthPrePassPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface, EVertexLayout inVertexLayout);
+
+	EPipelineType GetType() const override { return vertexLayout == EVertexLayout::Skinned ? EPipelineType::DepthPrePassSkinned : EPipelineType::DepthPrePass; }
+
+private:
+	const std::string shaderPath = "Data/Engine/Shaders/DepthPrePass";
+	const std::string skinnedShaderPath = "Data/Engine/Shaders/DepthPrePassSkinned";
+
+	EVertexLayout vertexLayout = EVertexLayout::Static;
+
+	std::vector<VkDynamicState> dynamicStates =
+	{
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+};
@@ -2,7 +2,6 @@
 #include "AssetManager/Animation/BoneData.h"
 #include "AssetManager/Model/MeshData.h"
 #include "Rendering/Descriptors/DescriptorRegistry.h"
-#include "Rendering/Descriptors/Semantics.h"
 #include "Rendering/Light/Light.h"
 #include "Rendering/Light/Shadow.h"
 #include "Rendering/RenderingInterface.h"
@@ -13,15 +12,16 @@
 #include <array>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
-PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface)
-	: RenderPipeline(inContext, inRenderingInterface)
+PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface, EVertexLayout inVertexLayout)
+	: RenderPipeline(inContext, inRenderingInterface), vertexLayout(inVertexLayout)
 {
 	// SHADER STAGES
 	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
 
 	// Vertex
-	const std::string vertShaderPath = shaderPath + "/vert.spv";
+	const std::string vertShaderPath = (vertexLayout == EVertexLayout::Skinned ? skinnedShaderPath : shaderPath) + "/vert.spv";
 	auto vertShaderCode = FileHelper::ReadFile(vertShaderPath);
 
 	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
@@ -132,51 +132,45 @@ PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRende
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.pNext = nullptr;
 
-	std::array<VkVertexInputBindingDescription, 1> bindingDescriptions{};
-	std::array<VkVertexInputAttributeDescription, 7> attributeDescriptions{};
+	// Binding 0 is the position (+ skinning) stream, binding 1 the shading attributes
+	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, position);
-
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, normal);
-
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, tangent);
-
-	attributeDescriptions[3].binding = 0;
-	attributeDescriptions[3].location = 3;
-	attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[3].offset = offsetof(Vertex, biTangent);
-
-	attributeDescriptions[4].binding = 0;
-	attributeDescriptions[4].location = 4;
-	attributeDescriptions[4].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[4].offset = offsetof(Vertex, uv);
-
-	attributeDescriptions[5].binding = 0;
-	attributeDescriptions[5].location = 5;
-	attributeDescriptions[5].format = VK_FORMAT_R32G32B32A32_SINT;
-	attributeDescriptions[5].offset = offsetof(Vertex, boneIDs);
-
-	attributeDescriptions[6].binding = 0;
-	attributeDescriptions[6].location = 6;
-	attributeDescriptions[6].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attributeDescriptions[6].offset = offsetof(Vertex, weights);
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(VertexAttributes);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	if (vertexLayout == EVertexLayout::Skinned)
+	{
+		bindingDescriptions[0].stride = sizeof(SkinnedPosition);
+
+		attributeDescriptions =
+		{
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(SkinnedPosition, position) },
+			{ 1, 1, VK_FORMAT_R16G16B16A16_SNORM, offsetof(VertexAttributes, normalTangent) },
+			{ 2, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(VertexAttributes, uv) },
+			{ 3, 0, VK_FORMAT_R8G8B8A8_UINT, offsetof(SkinnedPosition, boneIDs) },
+			{ 4, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(SkinnedPosition, weights) }
+		};
+	}
+	else
+	{
+		bindingDescriptions[0].stride = sizeof(StaticPosition);
+
+		attributeDescriptions =
+		{
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(StaticPosition, position) },
+			{ 1, 1, VK_FORMAT_R16G16B16A16_SNORM, offsetof(VertexAttributes, normalTangent) },
+			{ 2, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(VertexAttributes, uv) }
+		};
+	}
 
 	vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
 	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 	// *************	
 
@@ -267,7 +261,7 @@ PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRende
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.pNext = nullptr;
 
-	// Global layouts added first and the pipeline specific layouts will be added later
+	// Only global layouts, the materials are data in the material buffer and their textures are bindless
 	std::array<VkDescriptorSetLayout, 5> descriptorSetLayouts{};
 	if (const DescriptorRegistry* registry = renderingInterface->GetDescriptorRegistry())
 	{
@@ -275,16 +269,16 @@ PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRende
 		VkDescriptorSetLayout lightLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(registry->GetLightLayout().layout);
 		VkDescriptorSetLayout animationLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(registry->GetAnimationLayout().layout);
 		VkDescriptorSetLayout shadowLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(registry->GetShadowLayout().layout);
+		VkDescriptorSetLayout materialLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(registry->GetMaterialLayout().layout);
 
 		descriptorSetLayouts[0] = cameraMatricesLayout;
 		descriptorSetLayouts[1] = lightLayout;
 		descriptorSetLayouts[2] = shadowLayout;
-		descriptorSetLayouts[3] = animationLayout;		
+		descriptorSetLayouts[3] = animationLayout;
+		descriptorSetLayouts[4] = materialLayout;
 	}
 
-	CreatePipelineDescriptorLayoutSets(descriptorSetLayouts);
-
-	flags = MATRICES_DESCRIPTOR_FLAG | LIGHT_DESCRIPTOR_FLAG | ANIMATION_DESCRIPTOR_FLAG;
+	flags = MATRICES_DESCRIPTOR_FLAG | LIGHT_DESCRIPTOR_FLAG | ANIMATION_DESCRIPTOR_FLAG | MATERIAL_DESCRIPTOR_FLAG;
 
 	std::array<VkPushConstantRange, 1> pushConstants{};
 	pushConstants[0].offset = 0;
@@ -302,11 +296,14 @@ PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRende
 		std::cerr << "Failed to create pipeline layout!" << std::endl;
 	}
 
+	// After a depth pre-pass only the fragments that wrote the depth are shaded
+	const bool hasDepthPrePass = context.depthPrePass != VK_NULL_HANDLE;
+
 	VkPipelineDepthStencilStateCreateInfo depthStencil{};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthWriteEnable = hasDepthPrePass ? VK_FALSE : VK_TRUE;
+	depthStencil.depthCompareOp = hasDepthPrePass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.minDepthBounds = 0.0f;
 	depthStencil.maxDepthBounds = 1.0f;
@@ -344,43 +341,3 @@ PBRPipeline::PBRPipeline(const VkContext& inContext, RenderingInterface* inRende
 		vkDestroyShaderModule(context.device, stage.module, nullptr);
 	}
 }
-
-void PBRPipeline::CreatePipelineDescriptorLayoutSets(std::array<VkDescriptorSetLayout, 5>& outDescriptorSetLayouts)
-{
-	std::array<VkDescriptorSetLayoutBinding, 1> samplersLayoutBinding = {};
-
-	// Albedo
-	samplersLayoutBinding[0].binding = 0;
-	samplersLayoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplersLayoutBinding[0].descriptorCount = 1;
-	samplersLayoutBinding[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	samplersLayoutBinding[0].pImmutableSamplers = nullptr;
-	descriptorBindings.emplace_back(
-		DescriptorBindingInfo
-		{
-			static_cast<uint32_t>(samplersLayoutBinding[0].binding),
-			static_cast<uint32_t>(samplersLayoutBinding[0].descriptorType),
-			static_cast<uint32_t>(samplersLayoutBinding[0].stageFlags),
-			Semantics::AlbedoSampler
-		});
-
-	VkDescriptorSetLayoutCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	createInfo.bindingCount = samplersLayoutBinding.size();
-	createInfo.pBindings = samplersLayoutBinding.data();
-	createInfo.pNext = nullptr;
-
-	VkDescriptorSetLayout samplerLayout;
-	if (vkCreateDescriptorSetLayout(context.device, &createInfo, nullptr, &samplerLayout) != VK_SUCCESS)
-	{
-		std::cerr << "Failed to create descriptor set layout for samplers!" << std::endl;
-	}
-	outDescriptorSetLayouts[4] = samplerLayout;
-
-	descriptorLayouts.emplace_back(DescriptorSetLayoutInfo
-		{
-			RenderUtilities::DescriptorSetLayoutToGenericHandle(samplerLayout),
-			4,
-			EDescriptorOwner::Material
-		});
-}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Rendering/AbstractData.h"
 #include "Rendering/Vulkan/RenderPipeline.h"
 
 #include <vector>
@@ -7,14 +8,16 @@
 class PBRPipeline : public RenderPipeline
 {
 public:
-	PBRPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface);
+	PBRPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface, EVertexLayout inVertexLayout);
 
-	EPipelineType GetType() const override { return EPipelineType::PBR; }
+	EPipelineType GetType() const override { return vertexLayout == EVertexLayout::Skinned ? EPipelineType::PBRSkinned : EPipelineType::PBR; }
 
 private:
-	void CreatePipelineDescriptorLayoutSets(std::array<VkDescriptorSetLayout, 5>& outDescriptorSetLayouts);
-
 	const std::string shaderPath = "Data/Engine/Shaders/PBR";
+	// Only the vertex stage differs, the fragment stage is shared with the static variant
+	const std::string skinnedShaderPath = "Data/Engine/Shaders/PBRSkinned";
+
+	EVertexLayout vertexLayout = EVertexLayout::Static;
 
 	std::vector<VkDynamicState> dynamicStates =
 	{
@@ -49,22 +49,27 @@ ShadowMapDebugPipeline::ShadowMapDebugPipeline(const VkContext& inContext, Rende
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.pNext = nullptr;
 
-	std::array<VkVertexInputBindingDescription, 1> bindingDescriptions{};
+	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
 	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
 
+	// The debug plane is a static mesh, its quantized positions already cover [-1, 1]
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex);
+	bindingDescriptions[0].stride = sizeof(StaticPosition);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(VertexAttributes);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
 	attributeDescriptions[0].binding = 0;
 	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, position);
+	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+	attributeDescriptions[0].offset = offsetof(StaticPosition, position);
 
-	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].binding = 1;
 	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, uv);
+	attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+	attributeDescriptions[1].offset = offsetof(VertexAttributes, uv);
 
 	vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
 	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
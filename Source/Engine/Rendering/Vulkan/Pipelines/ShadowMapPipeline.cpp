@@ -13,15 +13,16 @@
 
 #include <array>
 #include <iostream>
+#include <vector>
 
-ShadowMapPipeline::ShadowMapPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface)
-	: RenderPipeline(inContext, inRenderingInterface)
+ShadowMapPipeline::ShadowMapPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface, EVertexLayout inVertexLayout)
+	: RenderPipeline(inContext, inRenderingInterface), vertexLayout(inVertexLayout)
 {
 	// SHADER STAGES
 	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
 
 	// Vertex
-	const std::string vertShaderPath = shaderPath + "/vert.spv";
+	const std::string vertShaderPath = (vertexLayout == EVertexLayout::Skinned ? skinnedShaderPath : shaderPath) + "/vert.spv";
 	auto vertShaderCode = FileHelper::ReadFile(vertShaderPath);
 
 	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
@@ -106,30 +107,36 @@ ShadowMapPipeline::ShadowMapPipeline(const VkContext& inContext, RenderingInterf
 	vertexInputInfo.pNext = nullptr;
 
 	std::array<VkVertexInputBindingDescription, 1> bindingDescriptions{};
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, position);
+	// Depth only, only the position stream is bound so the attribute stream is never fetched
+	if (vertexLayout == EVertexLayout::Skinned)
+	{
+		bindingDescriptions[0].stride = sizeof(SkinnedPosition);
 
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SINT;
-	attributeDescriptions[1].offset = offsetof(Vertex, boneIDs);
+		attributeDescriptions =
+		{
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(SkinnedPosition, position) },
+			{ 1, 0, VK_FORMAT_R8G8B8A8_UINT, offsetof(SkinnedPosition, boneIDs) },
+			{ 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(SkinnedPosition, weights) }
+		};
+	}
+	else
+	{
+		bindingDescriptions[0].stride = sizeof(StaticPosition);
 
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, weights);
+		attributeDescriptions =
+		{
+			{ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(StaticPosition, position) }
+		};
+	}
 
 	vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
 	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 	// *************	
 
@@ -159,8 +166,9 @@ ShadowMapPipeline::ShadowMapPipeline(const VkContext& inContext, RenderingInterf
 
 	VkPipelineViewportStateCreateInfo viewportState{};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
+	// One viewport per cascade, each covers the cascade's tile of the shadow atlas
+	viewportState.viewportCount = MAX_SM;
+	viewportState.scissorCount = MAX_SM;
 	viewportState.pNext = nullptr;
 
 	VkPipelineRasterizationStateCreateInfo rasterizer{};
@@ -183,30 +191,18 @@ ShadowMapPipeline::ShadowMapPipeline(const VkContext& inContext, RenderingInterf
 
 	VkDescriptorSetLayout animationLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(renderingInterface->GetDescriptorRegistry()->GetAnimationLayout().layout);
 	VkDescriptorSetLayout shadowLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(renderingInterface->GetDescriptorRegistry()->GetShadowLayout().layout);
+	// Only for the instance buffer, each caster has an instance per cascade it is rendered in
+	VkDescriptorSetLayout cameraMatricesLayout = RenderUtilities::GenericHandleToDescriptorSetLayout(renderingInterface->GetDescriptorRegistry()->GetCameraMatricesLayout().layout);
 
-	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts
+	std::array<VkDescriptorSetLayout, 3> descriptorSetLayouts
 	{
 		animationLayout,
-		shadowLayout
+		shadowLayout,
+		cameraMatricesLayout
 	};
 
 	flags = MATRICES_DESCRIPTOR_FLAG | LIGHT_DESCRIPTOR_FLAG | ANIMATION_DESCRIPTOR_FLAG;
 
-	std::array<VkPushConstantRange, 1> pushConstants{};
-	pushConstants[0].offset = 0;
-
-	struct alignas(16) ShadowConstants
-	{
-		glm::mat4 model;
-		uint32_t hasAnimation;
-	};
-
-	pushConstants[0].size = sizeof(ShadowConstants);
-	pushConstants[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-	pipelineLayoutInfo.pPushConstantRanges = pushConstants.data();
-	pipelineLayoutInfo.pushConstantRangeCount = pushConstants.size();
-
 	pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
 	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
 
@@ -271,5 +267,5 @@ ShadowMapPipeline::ShadowMapPipeline(const VkContext& inContext, RenderingInterf
 
 EPipelineType ShadowMapPipeline::GetType() const
 {
-	return EPipelineType::ShadowMap;
+	return vertexLayout == EVertexLayout::Skinned ? EPipelineType::ShadowMapSkinned : EPipelineType::ShadowMap;
 }
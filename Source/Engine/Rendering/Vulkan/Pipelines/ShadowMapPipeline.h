@@ -6,12 +6,16 @@
 class ShadowMapPipeline : public RenderPipeline
 {
 public:
-	ShadowMapPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface);
+	ShadowMapPipeline(const VkContext& inContext, RenderingInterface* inRenderingInterface, EVertexLayout inVertexLayout);
 
 	EPipelineType GetType() const override;
 
 private:
 	const std::string shaderPath = "Data/Engine/Shaders/ShadowMapping";
+	// Only the vertex stage differs, the geometry stage is shared with the static variant
+	const std::string skinnedShaderPath = "Data/Engine/Shaders/ShadowMappingSkinned";
+
+	EVertexLayout vertexLayout = EVertexLayout::Static;
 
 	std::vector<VkDynamicState> dynamicStates =
 	{
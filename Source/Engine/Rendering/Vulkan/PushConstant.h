@@ -1,15 +1,15 @@
 #pragma once
 
-#include "Utilities/AlignedVectors.h"
-
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// The same for every draw of the main pass but the material, the per entity data lives in the instance buffer
 struct SharedConstant
 {
-	alignas(16) glm::mat4 model;
-	alignas(16) AlignedMatrix3 normalMatrix;
+	// xyz => position of the view
+	alignas(16) glm::vec4 viewPosition = glm::vec4(0.0f);
 	int32_t lightsCount = 0;
 	float ambientStrength = 0.0f;
-	uint32_t hasAnimations = 0;
-};
\ No newline at end of file
+	// Index of the draw's material in the material buffer, pushed alone when only the material changes
+	uint32_t materialIndex = 0;
+};
@@ -113,3 +113,8 @@ bool RenderPipeline::SupportsAnimation() const
 {
 	return (flags & ANIMATION_DESCRIPTOR_FLAG) != 0;
 }
+
+bool RenderPipeline::SupportsMaterial() const
+{
+	return (flags & MATERIAL_DESCRIPTOR_FLAG) != 0;
+}
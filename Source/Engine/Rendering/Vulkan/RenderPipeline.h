@@ -29,6 +29,7 @@ public:
 	bool SupportsCamera() const;
 	bool SupportsLight() const;
 	bool SupportsAnimation() const;
+	bool SupportsMaterial() const;
 
 protected:
 	VkShaderModule CreateShaderModule(const std::vector<char>& code);
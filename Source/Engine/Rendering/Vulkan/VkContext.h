@@ -39,10 +39,16 @@ struct VkContext
 	VkRenderPass renderPass = VK_NULL_HANDLE;
 	VkRenderPass shadowPass = VK_NULL_HANDLE;
 	VkRenderPass additivePass = VK_NULL_HANDLE;
+	// Null when the main pass writes its own depth
+	VkRenderPass depthPrePass = VK_NULL_HANDLE;
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	// Only the update after bind sets (bindless materials), sized for them
+	VkDescriptorPool bindlessDescriptorPool = VK_NULL_HANDLE;
 
 	QueueFamilyIndices familyIndices;
 	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	// Multi draw indirect, indirect first instance and indirect count, the GPU culling needs all three
+	bool supportsIndirectDraws = false;
 
 	VmaAllocator allocator = VK_NULL_HANDLE;
 	VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
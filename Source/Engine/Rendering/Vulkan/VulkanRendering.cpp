@@ -14,20 +14,28 @@
 #include "Engine.h"
 #include "Frame.h"
 #include "Input/InputSystem.h"
+#include "Pipelines/DepthPrePassPipeline.h"
 #include "Pipelines/PBRPipeline.h"
 #include "Pipelines/ShadowMapPipeline.h"
 #include "Pipelines/ShadowMapDebugPipeline.h"
 #include "PushConstant.h"
+#include "Rendering/Culling/Frustum.h"
+#include "Rendering/Culling/FrustumCulling.h"
+#include "Rendering/Culling/MeshletCulling.h"
 #include "Rendering/Descriptors/DescriptorInfo.h"
 #include "Rendering/Descriptors/DescriptorRegistry.h"
 #include "Rendering/Descriptors/Semantics.h"
 #include "Rendering/Light/Light.h"
 #include "Rendering/Light/LightUtilities.h"
 #include "Rendering/Light/Shadow.h"
+#include "Rendering/Light/ShadowCascadeCache.h"
 #include "Rendering/Light/ShadowData.h"
+#include "Rendering/Lod/LodSelection.h"
+#include "Rendering/Queue/RenderQueue.h"
 #include "RenderPipeline.h"
 #include "RenderUtilities.h"
 #include "Utilities/FileHelper.h"
+#include "Utilities/VertexPacking.h"
 #include "World/View.h"
 #include "World/World.h"
 
@@ -37,16 +45,22 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <entt/entity/registry.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <numeric>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
 #include <set>
 #include <thread>
+#include <unordered_set>
 
 #define VMA_STATIC_VULKAN_FUNCTIONS 0
 #define VMA_DYNAMIC_VULKAN_FUNCTIONS 1
@@ -60,6 +74,15 @@
 
 static bool DEBUG_SHADOW_PASS = 1;
 static bool DEBUG_CASCADE_VISUALIZER = 1;
+static bool DEBUG_DESCRIPTOR_BINDS = 0;
+// Frustum culls the main pass' instances in a compute pass, when off the main pass draws the CPU culled view
+static bool GPU_CULLING = 1;
+// Compares the instances the GPU kept with the ones in the CPU culled view
+static bool DEBUG_GPU_CULLING = 0;
+// Tests the GPU culled instances against the previous frame's Hi-Z pyramid
+static bool OCCLUSION_CULLING = 1;
+// Lays down the main pass' depth before shading it, read when the render passes and the pipelines are created
+static bool DEPTH_PRE_PASS = 1;
 
 namespace Utilities
 {
@@ -100,14 +123,27 @@ bool VulkanRendering::InitializeVulkan()
 	success &= CreateLogicalDevice();
 	success &= CreateMemoryAllocator();
 	success &= CreateSwapChain();
+	success &= CreateDepthPrePass();
 	success &= CreateRenderPass();
 	CreateShadowPass();
 	success &= CreateFrameBuffers();
 	success &= CreateCommandPools();
 	success &= CreateDescriptorPool();
+	success &= geometryPool.Initialize(context.allocator);
 
 	CreateRenderFrames();
-	CreateDescriptorRegistry();
+	success &= CreateDescriptorRegistry();
+
+	success &= gpuCulling.Initialize(context);
+	gpuCulling.SetInstanceBuffers(context,
+		RenderUtilities::GenericHandleToBuffer(descriptorRegistry->GetInstanceBuffer().buffer),
+		RenderUtilities::GenericHandleToBuffer(descriptorRegistry->GetVisibleInstanceBuffer().buffer));
+
+	success &= hiZPyramid.Initialize(context);
+	success &= CreateHiZPyramid();
+
+	CreateBuffer(EBufferType::Indirect, SHADOW_DRAW_BUFFER_FRAME_SIZE * MAX_FRAMES_IN_FLIGHT, shadowDrawBuffer);
+
 	CreateRenderPipelines();
 	CreateShadowPassImage();
 	CreateShadowMappingFB();
@@ -285,13 +321,40 @@ bool VulkanRendering::CreateLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+	supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supportedVulkan12Features;
+	vkGetPhysicalDeviceFeatures2(context.physicalDevice, &supportedFeatures);
+
+	// Without them the GPU culling is off and the CPU culled view is drawn directly
+	context.supportsIndirectDraws = supportedFeatures.features.multiDrawIndirect && supportedFeatures.features.drawIndirectFirstInstance && supportedVulkan12Features.drawIndirectCount;
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.sampleRateShading = VK_TRUE;
 	deviceFeatures.geometryShader = VK_TRUE;
+	// The shadow cascades are rendered in a single pass, one viewport per atlas tile
+	deviceFeatures.multiViewport = VK_TRUE;
+	// The indirect draws point to their instances with firstInstance
+	deviceFeatures.multiDrawIndirect = context.supportsIndirectDraws;
+	deviceFeatures.drawIndirectFirstInstance = context.supportsIndirectDraws;
+
+	// Bindless textures, the materials index one large texture array
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	// The GPU culling compacts the draws, their count is read from a buffer
+	vulkan12Features.drawIndirectCount = context.supportsIndirectDraws;
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan12Features;
 
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -434,96 +497,241 @@ bool VulkanRendering::CreateSwapChain()
 
 void VulkanRendering::CreateShadowPassImage()
 {
-	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	const uint32_t atlasSize = ShadowAtlas::GetQualitySettings(shadowQuality).atlasSize;
+
+	VkImage image;
+	VmaAllocation memory;
+
+	VkImageCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.extent.width = atlasSize;
+	info.extent.height = atlasSize;
+	info.extent.depth = 1;
+	info.mipLevels = 1;
+	info.arrayLayers = 1;
+	info.format = VK_FORMAT_D32_SFLOAT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VmaAllocationCreateInfo memoryInfo{};
+	memoryInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	memoryInfo.flags = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+	if (vmaCreateImage(context.allocator, &info, &memoryInfo, &image, &memory, nullptr) != VK_SUCCESS)
 	{
-		VkImage image;
-		VmaAllocation memory;
+		std::cerr << "Failed to create shadow image!" << std::endl;
+	}
 
-		VkImageCreateInfo info{};
-		info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		info.imageType = VK_IMAGE_TYPE_2D;
-		info.extent.width = SHADOW_MAP_SIZE;
-		info.extent.height = SHADOW_MAP_SIZE;
-		info.extent.depth = 1;
-		info.mipLevels = 1;
-		info.arrayLayers = MAX_SM; // cascades
-		info.format = VK_FORMAT_D32_SFLOAT;
-		info.tiling = VK_IMAGE_TILING_OPTIMAL;
-		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		info.samples = VK_SAMPLE_COUNT_1_BIT;
-		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VmaAllocationCreateInfo memoryInfo{};
-		memoryInfo.usage = VMA_MEMORY_USAGE_AUTO;
-		memoryInfo.flags = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-
-		if (vmaCreateImage(context.allocator, &info, &memoryInfo, &image, &memory, nullptr) != VK_SUCCESS)
-		{
-			std::cerr << "Failed to create shadow image!" << std::endl;
-		}
+	VkImageView view;
 
-		VkImageView view;
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_D32_SFLOAT;
+
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(context.device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create shadow image view!" << std::endl;
+	}
+
+	VkSampler sampler;
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = 0.0f;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+	vkCreateSampler(context.device, &samplerInfo, nullptr, &sampler);
+
+	shadowMapData.shadowDepthTexture.image = RenderUtilities::ImageToGenericHandle(image);
+	shadowMapData.shadowDepthTexture.memory = RenderUtilities::AllocationToGenericHandle(memory);
+	shadowMapData.shadowDepthTexture.view = RenderUtilities::ImageViewToGenericHandle(view);
+	shadowMapData.shadowDepthTexture.sampler = RenderUtilities::ImageSamplerToGenericHandle(sampler);
+
+	// The tiles are handed out again on the next shadow pass
+	shadowMapData.atlas.Initialize(atlasSize);
+	shadowMapData.cascadeTiles.clear();
+	shadowMapData.cascadeCache.Invalidate();
+	shadowMapData.isLayoutInitialized = false;
+
+	// Every frame's shadow set samples the same atlas, each set is written once its frame is done
+	staleShadowDescriptors = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+}
+
+void VulkanRendering::UpdateShadowAtlasDescriptor(uint32_t frame)
+{
+	if ((staleShadowDescriptors & (1u << frame)) == 0)
+	{
+		return;
+	}
+	staleShadowDescriptors &= ~(1u << frame);
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = RenderUtilities::GenericHandleToImageView(shadowMapData.shadowDepthTexture.view);
+	imageInfo.sampler = RenderUtilities::GenericHandleToImageSampler(shadowMapData.shadowDepthTexture.sampler);
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetShadowDescriptorSet(frame));
+	write.dstBinding = 1;
+	write.dstArrayElement = 0;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = 1;
+	write.pImageInfo = &imageInfo;
+	write.pBufferInfo = nullptr;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+void VulkanRendering::DestroyShadowAtlas()
+{
+	VkImage shadowImage = RenderUtilities::GenericHandleToImage(shadowMapData.shadowDepthTexture.image);
+	VmaAllocation shadowMemory = RenderUtilities::GenericHandleToAllocation(shadowMapData.shadowDepthTexture.memory);
+	VkImageView shadowView = RenderUtilities::GenericHandleToImageView(shadowMapData.shadowDepthTexture.view);
+	VkSampler shadowSampler = RenderUtilities::GenericHandleToImageSampler(shadowMapData.shadowDepthTexture.sampler);
+
+	vmaDestroyImage(context.allocator, shadowImage, shadowMemory);
+	vkDestroyImageView(context.device, shadowView, nullptr);
+	vkDestroySampler(context.device, shadowSampler, nullptr);
+
+	vkDestroyFramebuffer(context.device, shadowMapData.shadowMappingFB, nullptr);
+}
+
+void VulkanRendering::AllocateCascadeTiles(uint32_t cascadeCount)
+{
+	ShadowAtlas& atlas = shadowMapData.atlas;
+	for (const ShadowAtlasTile& tile : shadowMapData.cascadeTiles)
+	{
+		atlas.Free(tile);
+	}
+
+	const ShadowQualitySettings settings = ShadowAtlas::GetQualitySettings(shadowQuality);
 
-		VkImageViewCreateInfo viewInfo{};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = image;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-		viewInfo.format = VK_FORMAT_D32_SFLOAT;
+	shadowMapData.cascadeTiles.assign(cascadeCount, ShadowAtlasTile{});
+	for (uint32_t i = 0; i < cascadeCount; ++i)
+	{
+		uint32_t tileSize = std::max(settings.nearCascadeSize >> i, settings.farCascadeSize);
 
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = MAX_SM; // cascades
+		// Smaller tiles rather than no shadows when the atlas is full
+		while (!atlas.Allocate(tileSize, shadowMapData.cascadeTiles[i]) && tileSize > SHADOW_ATLAS_MIN_TILE_SIZE)
+		{
+			tileSize /= 2;
+		}
 
-		if (vkCreateImageView(context.device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+		if (shadowMapData.cascadeTiles[i].size == 0)
 		{
-			std::cerr << "Failed to create shadow image view!" << std::endl;
+			std::cerr << "Failed to allocate the shadow atlas tile of cascade " << i << "!" << std::endl;
 		}
+	}
+
+	shadowMapData.cascadeCache.Invalidate();
+}
+
+void VulkanRendering::SetShadowQuality(EShadowQuality quality)
+{
+	if (quality == shadowQuality)
+	{
+		pendingShadowQuality.reset();
+		return;
+	}
+
+	pendingShadowQuality = quality;
+}
+
+void VulkanRendering::ApplyPendingShadowQuality()
+{
+	if (!pendingShadowQuality.has_value())
+	{
+		return;
+	}
+
+	shadowQuality = pendingShadowQuality.value();
+	pendingShadowQuality.reset();
+
+	// Released with the frame's resources, the frames in flight recorded their shadow pass with them
+	DestroyTexture(shadowMapData.shadowDepthTexture);
+	framebuffersPendingDelete[releaseFrame].push_back(shadowMapData.shadowMappingFB);
+
+	CreateShadowPassImage();
+	CreateShadowMappingFB();
+}
+
+bool VulkanRendering::CreateDepthPrePass()
+{
+	if (!DEPTH_PRE_PASS)
+	{
+		return true;
+	}
+
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = FindDepthFormat();
+	depthAttachment.samples = context.msaaSamples;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	// Loaded by the main pass
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 0;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+	subpass.colorAttachmentCount = 0;
+
+	// The depth image was last written by a previous frame's passes and read by its Hi-Z build
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dependencyFlags = 0;
+
+	VkRenderPassCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	info.attachmentCount = 1;
+	info.pAttachments = &depthAttachment;
+	info.dependencyCount = 1;
+	info.pDependencies = &dependency;
+	info.subpassCount = 1;
+	info.pSubpasses = &subpass;
 
-		VkSampler sampler;
-
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		samplerInfo.compareEnable = VK_TRUE;
-		samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-
-		vkCreateSampler(context.device, &samplerInfo, nullptr, &sampler);
-
-		shadowMapData[i].shadowDepthTexture.image = RenderUtilities::ImageToGenericHandle(image);
-		shadowMapData[i].shadowDepthTexture.memory = RenderUtilities::AllocationToGenericHandle(memory);
-		shadowMapData[i].shadowDepthTexture.view = RenderUtilities::ImageViewToGenericHandle(view);
-		shadowMapData[i].shadowDepthTexture.sampler = RenderUtilities::ImageSamplerToGenericHandle(sampler);
-
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = view;
-		imageInfo.sampler = sampler;
-
-		VkWriteDescriptorSet write{};
-		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		write.dstSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetShadowDescriptorSet(i));
-		write.dstBinding = 1;
-		write.dstArrayElement = 0;
-		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		write.descriptorCount = 1;
-		write.pImageInfo = &imageInfo;
-		write.pBufferInfo = nullptr;
-
-		vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+	if (vkCreateRenderPass(context.device, &info, nullptr, &context.depthPrePass) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create depth pre-pass!" << std::endl;
+		return false;
 	}
+
+	return true;
 }
 
 bool VulkanRendering::CreateRenderPass()
@@ -542,15 +750,18 @@ bool VulkanRendering::CreateRenderPass()
 	colorAttachmentRef.attachment = 0;
 	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	// After the depth pre-pass the depth is only tested. It is kept for the Hi-Z pyramid
+	const bool hasDepthPrePass = context.depthPrePass != VK_NULL_HANDLE;
+
 	VkAttachmentDescription depthAttachment{};
 	depthAttachment.format = FindDepthFormat();
 	depthAttachment.samples = context.msaaSamples;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.loadOp = hasDepthPrePass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.initialLayout = hasDepthPrePass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 	VkAttachmentReference depthAttachmentRef{};
 	depthAttachmentRef.attachment = 1;
@@ -585,16 +796,25 @@ bool VulkanRendering::CreateRenderPass()
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
 
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+	std::array<VkSubpassDependency, 2> dependencies{};
+	// The depth was written by the pre-pass, or by a previous frame and read by its Hi-Z build
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// The Hi-Z pyramid is built from the depth once the pass is done
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
 
 	if (vkCreateRenderPass(context.device, &renderPassInfo, nullptr, &context.renderPass) != VK_SUCCESS)
 	{
@@ -605,6 +825,11 @@ bool VulkanRendering::CreateRenderPass()
 	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 	std::array<VkAttachmentDescription, 3> additiveAttachments = { colorAttachment, depthAttachment, colorAttachmentResolve };
 
 	VkSubpassDescription additiveSubpass{};
@@ -621,6 +846,18 @@ bool VulkanRendering::CreateRenderPass()
 	additivePassInfo.subpassCount = 1;
 	additivePassInfo.pSubpasses = &additiveSubpass;
 
+	// Clears a depth image the Hi-Z build may have just read
+	VkSubpassDependency additiveDependency{};
+	additiveDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	additiveDependency.dstSubpass = 0;
+	additiveDependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	additiveDependency.srcAccessMask = 0;
+	additiveDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	additiveDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	additivePassInfo.dependencyCount = 1;
+	additivePassInfo.pDependencies = &additiveDependency;
+
 
 	if (vkCreateRenderPass(context.device, &additivePassInfo, nullptr, &context.additivePass) != VK_SUCCESS)
 	{
@@ -636,11 +873,12 @@ void VulkanRendering::CreateShadowPass()
 	VkAttachmentDescription depthAttachment{};
 	depthAttachment.format = FindDepthFormat();
 	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	// The cascades that didn't change are kept, DrawShadows clears the ones it re-renders
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference depthAttachmentRef{};
@@ -658,7 +896,7 @@ void VulkanRendering::CreateShadowPass()
 	dependency.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	dependency.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 	dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependency.dependencyFlags = 0;
 
 	VkRenderPassCreateInfo info{};
@@ -722,7 +960,8 @@ void VulkanRendering::CreateDepthResources()
 			context.msaaSamples,
 			depthFormat,
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			// Sampled by the Hi-Z pyramid
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
 			image,
 			memory
@@ -763,6 +1002,29 @@ bool VulkanRendering::CreateFrameBuffers()
 		}
 	}
 
+	if (context.depthPrePass != VK_NULL_HANDLE)
+	{
+		for (size_t i = 0; i < swapChainData.depthPrePassFramebuffers.size(); i++)
+		{
+			VkImageView depthView = RenderUtilities::GenericHandleToImageView(swapChainData.depths[i].view);
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = context.depthPrePass;
+			framebufferInfo.attachmentCount = 1;
+			framebufferInfo.pAttachments = &depthView;
+			framebufferInfo.width = context.swapChainExtent.width;
+			framebufferInfo.height = context.swapChainExtent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(context.device, &framebufferInfo, nullptr, &swapChainData.depthPrePassFramebuffers[i]) != VK_SUCCESS)
+			{
+				std::cerr << "Failed to create depth pre-pass framebuffer!" << std::endl;
+				return false;
+			}
+		}
+	}
+
 	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
 	{
 		std::array<VkImageView, 3> attachments =
@@ -791,25 +1053,40 @@ bool VulkanRendering::CreateFrameBuffers()
 	return true;
 }
 
-void VulkanRendering::CreateShadowMappingFB()
+bool VulkanRendering::CreateHiZPyramid()
 {
-	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	std::vector<VkImageView> depthViews(swapChainData.depths.size());
+	for (size_t i = 0; i < swapChainData.depths.size(); ++i)
+	{
+		depthViews[i] = RenderUtilities::GenericHandleToImageView(swapChainData.depths[i].view);
+	}
+
+	if (!hiZPyramid.CreatePyramid(context, depthViews))
 	{
-		VkImageView view = RenderUtilities::GenericHandleToImageView(shadowMapData[i].shadowDepthTexture.view);
+		return false;
+	}
 
-		VkFramebufferCreateInfo info{};
-		info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		info.renderPass = context.shadowPass;
-		info.attachmentCount = 1;
-		info.pAttachments = &view;
-		info.width = SHADOW_MAP_SIZE;
-		info.height = SHADOW_MAP_SIZE;
-		info.layers = MAX_SM;
+	gpuCulling.SetOcclusionPyramid(context, hiZPyramid.GetView(), hiZPyramid.GetSampler());
+	return true;
+}
 
-		if (vkCreateFramebuffer(context.device, &info, nullptr, &shadowMapData[i].shadowMappingFB) != VK_SUCCESS)
-		{
-			std::cerr << "Failed to create shadow framebuffer!" << std::endl;
-		}
+void VulkanRendering::CreateShadowMappingFB()
+{
+	const uint32_t atlasSize = shadowMapData.atlas.GetSize();
+	VkImageView view = RenderUtilities::GenericHandleToImageView(shadowMapData.shadowDepthTexture.view);
+
+	VkFramebufferCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	info.renderPass = context.shadowPass;
+	info.attachmentCount = 1;
+	info.pAttachments = &view;
+	info.width = atlasSize;
+	info.height = atlasSize;
+	info.layers = 1;
+
+	if (vkCreateFramebuffer(context.device, &info, nullptr, &shadowMapData.shadowMappingFB) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create shadow framebuffer!" << std::endl;
 	}
 }
 
@@ -850,7 +1127,8 @@ bool VulkanRendering::CreateDescriptorPool()
 		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 500},
 		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2000},
 		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000},
-		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000}
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 100}
 	};
 
 	VkDescriptorPoolCreateInfo info{};
@@ -866,6 +1144,27 @@ bool VulkanRendering::CreateDescriptorPool()
 		return false;
 	}
 
+	// One material set per frame in flight, each with the material buffer and every bindless texture slot
+	std::vector<VkDescriptorPoolSize> bindlessPoolSizes =
+	{
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT * MAX_BINDLESS_TEXTURES},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT}
+	};
+
+	VkDescriptorPoolCreateInfo bindlessInfo{};
+	bindlessInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	bindlessInfo.poolSizeCount = bindlessPoolSizes.size();
+	bindlessInfo.pPoolSizes = bindlessPoolSizes.data();
+	// The material sets are written after being bound (bindless textures)
+	bindlessInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	bindlessInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+	if (vkCreateDescriptorPool(context.device, &bindlessInfo, nullptr, &context.bindlessDescriptorPool) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create bindless descriptor pool!" << std::endl;
+		return false;
+	}
+
 	return true;
 }
 
@@ -888,6 +1187,9 @@ void VulkanRendering::CreateBuffer(EBufferType bufferType, uint32_t size, Alloca
 	case EBufferType::Storage:
 		type = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 		break;
+	case EBufferType::Indirect:
+		type = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+		break;
 	}
 
 	VkBuffer buffer;
@@ -905,18 +1207,31 @@ void VulkanRendering::CreateBuffer(EBufferType bufferType, uint32_t size, Alloca
 	outBuffer.memory = RenderUtilities::AllocationToGenericHandle(memory);
 }
 
-void VulkanRendering::CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cameraMatricesLayout, DescriptorSetLayoutInfo& lightLayout, DescriptorSetLayoutInfo& animationLayout, DescriptorSetLayoutInfo& shadowLayout)
+void VulkanRendering::CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cameraMatricesLayout, DescriptorSetLayoutInfo& lightLayout, DescriptorSetLayoutInfo& animationLayout, DescriptorSetLayoutInfo& shadowLayout, DescriptorSetLayoutInfo& materialLayout)
 {
-	VkDescriptorSetLayoutBinding cameraMatricesBinding{};
-	cameraMatricesBinding.binding = 0;
-	cameraMatricesBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	cameraMatricesBinding.descriptorCount = 1;
-	cameraMatricesBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	std::array<VkDescriptorSetLayoutBinding, 3> cameraBindings{};
+
+	cameraBindings[0].binding = 0;
+	cameraBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraBindings[0].descriptorCount = 1;
+	cameraBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// instances of the view's draws, one copy per frame in flight
+	cameraBindings[1].binding = 1;
+	cameraBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	cameraBindings[1].descriptorCount = 1;
+	cameraBindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	// ids of the instances each draw reads, compacted by the GPU culling. One copy per frame in flight
+	cameraBindings[2].binding = 2;
+	cameraBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	cameraBindings[2].descriptorCount = 1;
+	cameraBindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 	VkDescriptorSetLayoutCreateInfo cameraCreateInfo{};
 	cameraCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	cameraCreateInfo.bindingCount = 1;
-	cameraCreateInfo.pBindings = &cameraMatricesBinding;
+	cameraCreateInfo.bindingCount = cameraBindings.size();
+	cameraCreateInfo.pBindings = cameraBindings.data();
 
 	VkDescriptorSetLayout camLayout;
 	if (vkCreateDescriptorSetLayout(context.device, &cameraCreateInfo, nullptr, &camLayout) != VK_SUCCESS)
@@ -926,13 +1241,19 @@ void VulkanRendering::CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cam
 	cameraMatricesLayout.layout = RenderUtilities::DescriptorSetLayoutToGenericHandle(camLayout);
 
 	// Light
-	std::array<VkDescriptorSetLayoutBinding, 1> lightBindings{};
+	std::array<VkDescriptorSetLayoutBinding, 2> lightBindings{};
 
 	lightBindings[0].binding = 0;
 	lightBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 	lightBindings[0].descriptorCount = 1;
 	lightBindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+	// light clusters, one copy per frame in flight
+	lightBindings[1].binding = 1;
+	lightBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	lightBindings[1].descriptorCount = 1;
+	lightBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
 	VkDescriptorSetLayoutCreateInfo sharedCreateInfo{};
 	sharedCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	sharedCreateInfo.bindingCount = lightBindings.size();
@@ -997,24 +1318,67 @@ void VulkanRendering::CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cam
 		std::cerr << "Failed to create descriptor set layout for the light!" << std::endl;
 	}
 	shadowLayout.layout = RenderUtilities::DescriptorSetLayoutToGenericHandle(shadowDescriptorLayout);
+
+	// Material
+	std::array<VkDescriptorSetLayoutBinding, 2> materialBindings{};
+
+	// material buffer
+	materialBindings[0].binding = 0;
+	materialBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	materialBindings[0].descriptorCount = 1;
+	materialBindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// bindless textures, the slots are written as the materials reference them
+	materialBindings[1].binding = 1;
+	materialBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	materialBindings[1].descriptorCount = MAX_BINDLESS_TEXTURES;
+	materialBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	std::array<VkDescriptorBindingFlags, 2> materialBindingFlags =
+	{
+		0,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo materialFlagsInfo{};
+	materialFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	materialFlagsInfo.bindingCount = materialBindingFlags.size();
+	materialFlagsInfo.pBindingFlags = materialBindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo materialCreateInfo{};
+	materialCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	materialCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	materialCreateInfo.bindingCount = materialBindings.size();
+	materialCreateInfo.pBindings = materialBindings.data();
+	materialCreateInfo.pNext = &materialFlagsInfo;
+
+	VkDescriptorSetLayout materialDescriptorLayout;
+	if (vkCreateDescriptorSetLayout(context.device, &materialCreateInfo, nullptr, &materialDescriptorLayout) != VK_SUCCESS)
+	{
+		std::cerr << "Failed to create descriptor set layout for the materials!" << std::endl;
+	}
+	materialLayout.layout = RenderUtilities::DescriptorSetLayoutToGenericHandle(materialDescriptorLayout);
+	materialLayout.updateAfterBind = true;
 }
 
-void VulkanRendering::CreateDescriptorSet(const DescriptorSetLayoutInfo& layoutInfo, GenericHandle& outDescriptorSet)
+bool VulkanRendering::CreateDescriptorSet(const DescriptorSetLayoutInfo& layoutInfo, GenericHandle& outDescriptorSet)
 {
 	VkDescriptorSetLayout layout = RenderUtilities::GenericHandleToDescriptorSetLayout(layoutInfo.layout);
 
 	VkDescriptorSetAllocateInfo info{};
 	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	info.descriptorPool = context.descriptorPool;
+	info.descriptorPool = layoutInfo.updateAfterBind ? context.bindlessDescriptorPool : context.descriptorPool;
 	info.descriptorSetCount = 1;
 	info.pSetLayouts = &layout;
 
-	VkDescriptorSet set;
+	VkDescriptorSet set = VK_NULL_HANDLE;
 	if (vkAllocateDescriptorSets(context.device, &info, &set) != VK_SUCCESS)
 	{
-		std::cerr << "Failed to allocate light descriptor set!" << std::endl;
+		std::cerr << "Failed to allocate descriptor set!" << std::endl;
+		return false;
 	}
 	outDescriptorSet = RenderUtilities::DescriptorSetToGenericHandle(set);
+	return true;
 }
 
 void VulkanRendering::UpdateDescriptorSet(EDescriptorSetType type, GenericHandle descriptorSet, AllocatedBuffer buffer, uint32_t binding)
@@ -1093,16 +1457,60 @@ void VulkanRendering::DestroyDescriptorSetLayout(const DescriptorSetLayoutInfo&
 	vkDestroyDescriptorSetLayout(context.device, layout, nullptr);
 }
 
+void VulkanRendering::UpdateBindlessTexture(GenericHandle descriptorSet, uint32_t binding, uint32_t arrayIndex, const AllocatedTexture& texture)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = RenderUtilities::GenericHandleToImageView(texture.view);
+	imageInfo.sampler = RenderUtilities::GenericHandleToImageSampler(texture.sampler);
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorSet);
+	write.dstBinding = binding;
+	write.dstArrayElement = arrayIndex;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = 1;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+EPipelineType VulkanRendering::GetMeshPipeline(EPipelineType materialPipeline, bool isSkinned)
+{
+	// Skinned meshes use a different vertex layout so they go through the skinned variant of the material pipeline
+	if (isSkinned && materialPipeline == EPipelineType::PBR)
+	{
+		return EPipelineType::PBRSkinned;
+	}
+	return materialPipeline;
+}
+
 void VulkanRendering::CreateRenderPipelines()
 {
-	PBRPipeline* litPipeline = new PBRPipeline(context, this);
+	PBRPipeline* litPipeline = new PBRPipeline(context, this, EVertexLayout::Static);
 	renderPipelines.emplace(EPipelineType::PBR, litPipeline);
 
-	ShadowMapPipeline* shadowMapPipeline = new ShadowMapPipeline(context, this);
+	PBRPipeline* skinnedLitPipeline = new PBRPipeline(context, this, EVertexLayout::Skinned);
+	renderPipelines.emplace(EPipelineType::PBRSkinned, skinnedLitPipeline);
+
+	ShadowMapPipeline* shadowMapPipeline = new ShadowMapPipeline(context, this, EVertexLayout::Static);
 	renderPipelines.emplace(EPipelineType::ShadowMap, shadowMapPipeline);
 
+	ShadowMapPipeline* skinnedShadowMapPipeline = new ShadowMapPipeline(context, this, EVertexLayout::Skinned);
+	renderPipelines.emplace(EPipelineType::ShadowMapSkinned, skinnedShadowMapPipeline);
+
 	ShadowMapDebugPipeline* shadowMapDebugPipeline = new ShadowMapDebugPipeline(context, this);
 	renderPipelines.emplace(EPipelineType::ShadowMapDebug, shadowMapDebugPipeline);
+
+	if (context.depthPrePass != VK_NULL_HANDLE)
+	{
+		DepthPrePassPipeline* depthPrePassPipeline = new DepthPrePassPipeline(context, this, EVertexLayout::Static);
+		renderPipelines.emplace(EPipelineType::DepthPrePass, depthPrePassPipeline);
+
+		DepthPrePassPipeline* skinnedDepthPrePassPipeline = new DepthPrePassPipeline(context, this, EVertexLayout::Skinned);
+		renderPipelines.emplace(EPipelineType::DepthPrePassSkinned, skinnedDepthPrePassPipeline);
+	}
 }
 
 void VulkanRendering::SetupDebugMessenger()
@@ -1144,6 +1552,18 @@ void VulkanRendering::CleanupSwapChain()
 		vkDestroyFramebuffer(context.device, swapChainData.swapChainFramebuffers[i], nullptr);
 	}
 
+	for (VkFramebuffer& framebuffer : swapChainData.depthPrePassFramebuffers)
+	{
+		if (framebuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyFramebuffer(context.device, framebuffer, nullptr);
+			framebuffer = VK_NULL_HANDLE;
+		}
+	}
+
+	// Sized like the swap chain and bound to its depth images
+	hiZPyramid.DestroyPyramid(context);
+
 	for (size_t i = 0; i < swapChainData.views.size(); i++)
 	{
 		vkDestroyImageView(context.device, swapChainData.views[i], nullptr);
@@ -1152,17 +1572,17 @@ void VulkanRendering::CleanupSwapChain()
 	vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
 }
 
-void VulkanRendering::CleanupPendingDestroyBuffers()
+void VulkanRendering::CleanupPendingDestroyBuffers(uint32_t frame)
 {
-	for (AllocatedBuffer& bufferData : buffersPendingDelete)
+	for (AllocatedBuffer& bufferData : buffersPendingDelete[frame])
 	{
 		vmaDestroyBuffer(context.allocator,
 			RenderUtilities::GenericHandleToBuffer(bufferData.buffer),
 			RenderUtilities::GenericHandleToAllocation(bufferData.memory));
 	}
-	buffersPendingDelete.clear();
+	buffersPendingDelete[frame].clear();
 
-	for (AllocatedTexture& texture : imagesPendingDelete)
+	for (AllocatedTexture& texture : imagesPendingDelete[frame])
 	{
 		VkImage image = RenderUtilities::GenericHandleToImage(texture.image);
 		VmaAllocation memory = RenderUtilities::GenericHandleToAllocation(texture.memory);
@@ -1178,7 +1598,19 @@ void VulkanRendering::CleanupPendingDestroyBuffers()
 			vkDestroySampler(context.device, sampler, nullptr);
 		}
 	}
-	imagesPendingDelete.clear();
+	imagesPendingDelete[frame].clear();
+
+	for (const MeshRenderData& renderData : meshesPendingDelete[frame])
+	{
+		geometryPool.Free(renderData);
+	}
+	meshesPendingDelete[frame].clear();
+
+	for (VkFramebuffer framebuffer : framebuffersPendingDelete[frame])
+	{
+		vkDestroyFramebuffer(context.device, framebuffer, nullptr);
+	}
+	framebuffersPendingDelete[frame].clear();
 }
 
 void VulkanRendering::RecreateSwapChain()
@@ -1186,6 +1618,7 @@ void VulkanRendering::RecreateSwapChain()
 	CleanupSwapChain();
 	CreateSwapChain();
 	CreateFrameBuffers();
+	CreateHiZPyramid();
 }
 
 void VulkanRendering::HandleWindowResized()
@@ -1213,6 +1646,17 @@ bool VulkanRendering::IsDeviceSuitable(VkPhysicalDevice device) const
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	const bool supportsBindless = vulkan12Features.runtimeDescriptorArray && vulkan12Features.descriptorBindingPartiallyBound &&
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind && vulkan12Features.descriptorBindingUpdateUnusedWhilePending;
+
 	QueueFamilyIndices indices = FindQueueFamilies(device);
 
 	bool extensionsSupported = CheckDeviceExtensionSupport(device);
@@ -1224,7 +1668,7 @@ bool VulkanRendering::IsDeviceSuitable(VkPhysicalDevice device) const
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
 
-	return indices.IsValid() && extensionsSupported && swapChainAdequate && deviceFeatures.samplerAnisotropy;
+	return indices.IsValid() && extensionsSupported && swapChainAdequate && deviceFeatures.samplerAnisotropy && deviceFeatures.multiViewport && supportsBindless;
 }
 
 bool VulkanRendering::CheckDeviceExtensionSupport(VkPhysicalDevice device) const
@@ -1275,7 +1719,8 @@ QueueFamilyIndices VulkanRendering::FindQueueFamilies(VkPhysicalDevice device) c
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies)
 	{
-		if (!indices.graphicsFamily.has_value() && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		// The culling is dispatched on the graphics queue
+		if (!indices.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
 		{
 			indices.graphicsFamily = i;
 		}
@@ -1401,10 +1846,11 @@ VkFormat VulkanRendering::FindSupportedFormat(const std::vector<VkFormat>& candi
 
 VkFormat VulkanRendering::FindDepthFormat() const
 {
+	// The Hi-Z pyramid samples the depth
 	return FindSupportedFormat(
 		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 VkSampleCountFlagBits VulkanRendering::GetMaxUsableSampleCount() const
@@ -1412,7 +1858,9 @@ VkSampleCountFlagBits VulkanRendering::GetMaxUsableSampleCount() const
 	VkPhysicalDeviceProperties physicalDeviceProperties;
 	vkGetPhysicalDeviceProperties(context.physicalDevice, &physicalDeviceProperties);
 
-	VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+	// The Hi-Z pyramid samples the multisampled depth
+	VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts
+		& physicalDeviceProperties.limits.sampledImageDepthSampleCounts;
 
 	if (counts & VK_SAMPLE_COUNT_64_BIT) { return VK_SAMPLE_COUNT_64_BIT; }
 	if (counts & VK_SAMPLE_COUNT_32_BIT) { return VK_SAMPLE_COUNT_32_BIT; }
@@ -1547,21 +1995,7 @@ void VulkanRendering::UnInitialize()
 	descriptorRegistry->UnInitialize();
 	materialSystem->ReleaseResources();
 
-	for (int32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-	{
-		// Shadow pass resources
-		VkImage shadowImage = RenderUtilities::GenericHandleToImage(shadowMapData[i].shadowDepthTexture.image);
-		VmaAllocation shadowMemory = RenderUtilities::GenericHandleToAllocation(shadowMapData[i].shadowDepthTexture.memory);
-		VkImageView shadowView = RenderUtilities::GenericHandleToImageView(shadowMapData[i].shadowDepthTexture.view);
-		VkSampler shadowSampler = RenderUtilities::GenericHandleToImageSampler(shadowMapData[i].shadowDepthTexture.sampler);
-
-		vmaDestroyImage(context.allocator, shadowImage, shadowMemory);
-		vkDestroyImageView(context.device, shadowView, nullptr);
-		vkDestroySampler(context.device, shadowSampler, nullptr);
-
-		vkDestroyFramebuffer(context.device, shadowMapData[i].shadowMappingFB, nullptr);
-		// ********************
-	}
+	DestroyShadowAtlas();
 
 	for (Frame& renderFrame : renderFrames)
 	{
@@ -1576,13 +2010,24 @@ void VulkanRendering::UnInitialize()
 	}
 	renderPipelines.clear();
 
-	CleanupPendingDestroyBuffers();
+	DestroyBuffer(shadowDrawBuffer);
+
+	// The device is idle since the swap chain cleanup
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		CleanupPendingDestroyBuffers(i);
+	}
+	geometryPool.Destroy(context.allocator);
+	gpuCulling.Destroy(context);
+	hiZPyramid.Destroy(context);
 
 	vkDestroyDescriptorPool(context.device, context.descriptorPool, nullptr);
+	vkDestroyDescriptorPool(context.device, context.bindlessDescriptorPool, nullptr);
 	vkDestroyCommandPool(context.device, context.graphicsCommandPool, nullptr);
 	vkDestroyCommandPool(context.device, context.transferCommandPool, nullptr);
 	vkDestroyRenderPass(context.device, context.renderPass, nullptr);
 	vkDestroyRenderPass(context.device, context.shadowPass, nullptr);
+	vkDestroyRenderPass(context.device, context.depthPrePass, nullptr);
 	vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
 	vmaDestroyAllocator(context.allocator);
 	vkDestroyDevice(context.device, nullptr);
@@ -1598,6 +2043,13 @@ void VulkanRendering::DrawFrame()
 	vkWaitForFences(context.device, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
 	vkResetFences(context.device, 1, &frame.inFlightFence);
 
+	// Every frame recorded before the frame's previous submission is done too
+	CleanupPendingDestroyBuffers(currentFrame);
+	releaseFrame = currentFrame;
+
+	ApplyPendingShadowQuality();
+	UpdateShadowAtlasDescriptor(currentFrame);
+
 	uint32_t imageIndex;
 	vkAcquireNextImageKHR(context.device, context.swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 
@@ -1648,19 +2100,28 @@ void VulkanRendering::DrawShadows(const View& view)
 
 	const Camera& camera = *view.camera;
 
-	RenderPipeline* pipeline = renderPipelines[EPipelineType::ShadowMap];
-
-	pipeline->Bind(cmdBuffer);
-
-
 	Light light = view.registry->get<Light>(view.lightsInView[0]);
 	const LightInstance& lightInstance = view.lightSystem->GetInstance(light.lightInstanceHandle);
 
-	std::vector<glm::mat4> lightMatrices = LightUtilities::GetLightSpaceMatrices(camera, lightInstance.eulers);
+	const uint32_t cascadeCount = std::min<uint32_t>(static_cast<uint32_t>(camera.shadowCascadeLevels.size()) + 1, MAX_SM);
+	if (shadowMapData.cascadeTiles.size() != cascadeCount)
+	{
+		AllocateCascadeTiles(cascadeCount);
+	}
 
-	const uint32_t offset = currentFrame * sizeof(glm::mat4) * MAX_SM;
-	UpdateBuffer(descriptorRegistry->GetLightSMBuffer(), offset, sizeof(glm::mat4) * lightMatrices.size(), lightMatrices.data());
+	// A cascade without a tile is never rendered
+	std::vector<uint32_t> cascadeResolutions(cascadeCount);
+	uint32_t tileMask = 0;
+	for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade)
+	{
+		cascadeResolutions[cascade] = shadowMapData.cascadeTiles[cascade].size;
+		if (cascadeResolutions[cascade] != 0)
+		{
+			tileMask |= 1u << cascade;
+		}
+	}
 
+	const std::vector<glm::mat4> lightMatrices = LightUtilities::GetLightSpaceMatrices(camera, lightInstance.eulers, cascadeResolutions);
 
 	VkDescriptorSet animationDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetAnimationDescriptorSet());
 
@@ -1668,71 +2129,369 @@ void VulkanRendering::DrawShadows(const View& view)
 
 	VkDescriptorSet descriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetShadowDescriptorSet(currentFrame));
 
-	vkCmdBindDescriptorSets(cmdBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipeline->GetLayout(),
-		0,
-		1,
-		&animationDescriptorSet,
-		1,
-		&animationDynamicOffset);
-
 	uint32_t shadowDynamicOffset = currentFrame * sizeof(glm::mat4) * MAX_SM;
 
-	vkCmdBindDescriptorSets(cmdBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipeline->GetLayout(),
-		1,
-		1,
-		&descriptorSet,
-		1,
-		&shadowDynamicOffset);
-
-	for (entt::entity entity : view.entitiesInView)
+	// Anything that changes how a caster is rendered changes its signature
+	const uint32_t casterCount = static_cast<uint32_t>(view.shadowCasters.size());
+	casterSignatures.resize(casterCount);
+	for (uint32_t i = 0; i < casterCount; ++i)
 	{
+		const entt::entity entity = view.shadowCasters[i];
+
 		const Transform& transform = view.registry->get<const Transform>(entity);
 		const ModelComponent& modelComponent = view.registry->get<const ModelComponent>(entity);
 
-		struct alignas(16) ShadowConstants
+		// Only the values, not the components' layout. The LOD follows the camera, a cached cascade keeps the one it was
+		// rendered with rather than being redrawn whenever the camera moves
+		uint64_t signature = ShadowCascadeCache::EMPTY_SIGNATURE;
+		ShadowCascadeCache::AddToSignature(signature, &entity, sizeof(entt::entity));
+		ShadowCascadeCache::AddToSignature(signature, glm::value_ptr(transform.position), sizeof(glm::vec3));
+		ShadowCascadeCache::AddToSignature(signature, glm::value_ptr(transform.eulers), sizeof(glm::vec3));
+		ShadowCascadeCache::AddToSignature(signature, glm::value_ptr(transform.scale), sizeof(glm::vec3));
+		ShadowCascadeCache::AddToSignature(signature, &modelComponent.handle, sizeof(uint32_t));
+		casterSignatures[i] = signature;
+	}
+
+	// Each caster is only rendered in the cascades its world bounds overlap
+	casterCascadeMasks.assign(casterCount, 0);
+	cascadeVisibility.resize(view.casterBounds.centerX.size());
+
+	std::vector<ShadowCascadeState> cascadeStates(cascadeCount);
+	for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade)
+	{
+		ShadowCascadeState& state = cascadeStates[cascade];
+		state.matrix = lightMatrices[cascade];
+		state.casterSignature = ShadowCascadeCache::EMPTY_SIGNATURE;
+
+		const Frustum cascadeFrustum = Frustum::FromViewProjection(lightMatrices[cascade]);
+		if (FrustumCulling::CullBoxes(view.casterBounds, 0, casterCount, cascadeFrustum, cascadeVisibility.data()) == 0)
 		{
-			glm::mat4 model;
-			uint32_t hasAnimation;
-		};
+			continue;
+		}
 
-		ShadowConstants constants
+		for (uint32_t i = 0; i < casterCount; ++i)
 		{
-			transform.ComputeModel(),
-			view.registry->try_get<AnimatorComponent>(entity) != nullptr
-		};
+			if (cascadeVisibility[i] != 0)
+			{
+				casterCascadeMasks[i] |= 1u << cascade;
 
-		vkCmdPushConstants(cmdBuffer,
-			pipeline->GetLayout(),
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(ShadowConstants),
-			&constants);
+				ShadowCascadeCache::AddToSignature(state.casterSignature, &casterSignatures[i], sizeof(uint64_t));
+				state.hasAnimatedCasters |= view.registry->try_get<AnimatorComponent>(view.shadowCasters[i]) != nullptr;
+			}
+		}
+	}
+
+	// The cascades that didn't change keep the matrices they were rendered with, the main pass samples them with those
+	std::vector<glm::mat4> cascadeMatrices;
+	const uint32_t updateMask = shadowMapData.cascadeCache.Update(cascadeStates, cascadeMatrices);
+
+	const uint32_t offset = currentFrame * sizeof(glm::mat4) * MAX_SM;
+	UpdateBuffer(descriptorRegistry->GetLightSMBuffer(), offset, sizeof(glm::mat4) * cascadeMatrices.size(), cascadeMatrices.data());
 
+	const uint32_t renderMask = updateMask & tileMask;
+	if (renderMask == 0)
+	{
+		return;
+	}
+
+	// The geometry shader sends each cascade to its own viewport, the unused ones only need to be valid
+	std::array<VkViewport, MAX_SM> viewports{};
+	std::array<VkRect2D, MAX_SM> scissors{};
+	for (uint32_t cascade = 0; cascade < MAX_SM; ++cascade)
+	{
+		ShadowAtlasTile tile{ 0, 0, 1 };
+		if (cascade < cascadeCount && shadowMapData.cascadeTiles[cascade].size != 0)
+		{
+			tile = shadowMapData.cascadeTiles[cascade];
+		}
+
+		// Flipped like the other passes
+		VkViewport& viewport = viewports[cascade];
+		viewport.x = static_cast<float>(tile.x);
+		viewport.y = static_cast<float>(tile.y + tile.size);
+		viewport.width = static_cast<float>(tile.size);
+		viewport.height = -static_cast<float>(tile.size);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D& scissor = scissors[cascade];
+		scissor.offset = { static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y) };
+		scissor.extent = { tile.size, tile.size };
+	}
+
+	vkCmdSetViewport(cmdBuffer, 0, MAX_SM, viewports.data());
+	vkCmdSetScissor(cmdBuffer, 0, MAX_SM, scissors.data());
+
+	// The pass loads the shadow atlas, only the tiles of the re-rendered cascades are cleared
+	std::vector<VkClearRect> clearRects;
+	for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade)
+	{
+		if ((renderMask & (1u << cascade)) != 0)
+		{
+			VkClearRect& rect = clearRects.emplace_back();
+			rect.rect = scissors[cascade];
+			rect.baseArrayLayer = 0;
+			rect.layerCount = 1;
+		}
+	}
+
+	VkClearAttachment clearAttachment{};
+	clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+	vkCmdClearAttachments(cmdBuffer, 1, &clearAttachment, static_cast<uint32_t>(clearRects.size()), clearRects.data());
+
+	for (uint32_t& cascadeMask : casterCascadeMasks)
+	{
+		cascadeMask &= renderMask;
+	}
+
+	// Static and skinned meshes have different vertex layouts, so each group has its own pipeline.
+	// The casters get their instances after the main pass' ones
+	const uint32_t firstShadowInstance = static_cast<uint32_t>(instances.size());
+	casterFirstInstances.assign(casterCount, 0);
+
+	std::array<std::vector<uint32_t>, 2> castersPerLayout;
+	for (uint32_t i = 0; i < casterCount; ++i)
+	{
+		if (casterCascadeMasks[i] == 0)
+		{
+			continue;
+		}
+
+		const ModelComponent& modelComponent = view.registry->get<const ModelComponent>(view.shadowCasters[i]);
 		const Model* model = AssetManager::Get().LoadAsset<Model>(modelComponent.handle);
-		const MeshData& meshData = model->GetMeshData();
-		const MeshRenderData& renderData = model->GetRenderData();
+		if (!model->IsReady())
+		{
+			continue;
+		}
 
-		VkBuffer buffer = RenderUtilities::GenericHandleToBuffer(renderData.vertex.buffer);
-		VkDeviceSize zeroOffset[] = { 0 };
-		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, zeroOffset);
+		casterFirstInstances[i] = static_cast<uint32_t>(instances.size());
+		if (!AddShadowCasterInstances(view, view.shadowCasters[i], casterCascadeMasks[i]))
+		{
+			break;
+		}
 
-		VkBuffer indexBuffer = RenderUtilities::GenericHandleToBuffer(renderData.index.buffer);
-		vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		castersPerLayout[model->GetMeshData().isSkinned ? 1 : 0].push_back(i);
+	}
 
-		for (int32_t i = 0; i < meshData.meshesCount; ++i)
+	const uint32_t shadowInstanceCount = static_cast<uint32_t>(instances.size()) - firstShadowInstance;
+	if (shadowInstanceCount == 0)
+	{
+		return;
+	}
+
+	UpdateBuffer(descriptorRegistry->GetInstanceBuffer(),
+		INSTANCE_BUFFER_FRAME_SIZE * currentFrame + sizeof(InstanceLayout) * firstShadowInstance,
+		sizeof(InstanceLayout) * shadowInstanceCount,
+		instances.data() + firstShadowInstance);
+
+	// The casters' submeshes sharing a layout and an index type are a single indirect draw, 16 bit indices first
+	shadowDraws.clear();
+	std::array<std::array<uint32_t, 2>, 2> firstDraws{};
+	std::array<std::array<uint32_t, 2>, 2> drawCounts{};
+	for (size_t layout = 0; layout < castersPerLayout.size(); ++layout)
+	{
+		for (uint32_t indexType = 0; indexType < 2; ++indexType)
 		{
-			vkCmdDrawIndexed(cmdBuffer,
-				meshData.meshIndices[i].count,
-				1,
-				meshData.offset[i],
-				0,
-				0);
+			firstDraws[layout][indexType] = static_cast<uint32_t>(shadowDraws.size());
+
+			for (uint32_t caster : castersPerLayout[layout])
+			{
+				const ModelComponent& modelComponent = view.registry->get<const ModelComponent>(view.shadowCasters[caster]);
+				const Model* model = AssetManager::Get().LoadAsset<Model>(modelComponent.handle);
+				const MeshData& meshData = model->GetMeshData();
+
+				for (uint32_t i = 0; i < meshData.meshesCount && shadowDraws.size() < MAX_SHADOW_DRAWS; ++i)
+				{
+					const MeshIndexData& submesh = meshData.meshIndices[i];
+					if (submesh.use16BitIndices == (indexType == 0))
+					{
+						shadowDraws.push_back(GetSubmeshDraw(model->GetRenderData(), submesh, modelComponent.lodIndex, std::popcount(casterCascadeMasks[caster]), casterFirstInstances[caster]));
+					}
+				}
+			}
+
+			drawCounts[layout][indexType] = static_cast<uint32_t>(shadowDraws.size()) - firstDraws[layout][indexType];
 		}
 	}
+
+	const uint32_t shadowDrawOffset = SHADOW_DRAW_BUFFER_FRAME_SIZE * currentFrame;
+	UpdateBuffer(shadowDrawBuffer, shadowDrawOffset, sizeof(VkDrawIndexedIndirectCommand) * shadowDraws.size(), shadowDraws.data());
+
+	VkBuffer indirectBuffer = RenderUtilities::GenericHandleToBuffer(shadowDrawBuffer.buffer);
+	VkDescriptorSet cameraDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetCameraMatricesDescriptorSet());
+
+	// The shadow shaders read their instance directly, the visible instances are only bound for the layout
+	const std::array<uint32_t, 2> instanceOffsets =
+	{
+		INSTANCE_BUFFER_FRAME_SIZE * currentFrame,
+		VISIBLE_INSTANCE_BUFFER_FRAME_SIZE * currentFrame
+	};
+
+	for (size_t layout = 0; layout < castersPerLayout.size(); ++layout)
+	{
+		if (castersPerLayout[layout].empty())
+		{
+			continue;
+		}
+
+		RenderPipeline* pipeline = renderPipelines[layout == 0 ? EPipelineType::ShadowMap : EPipelineType::ShadowMapSkinned];
+
+		pipeline->Bind(cmdBuffer);
+
+		descriptorBindState.Bind(pipeline->GetLayout(), 0, animationDescriptorSet, 1, &animationDynamicOffset);
+		descriptorBindState.Bind(pipeline->GetLayout(), 1, descriptorSet, 1, &shadowDynamicOffset);
+		descriptorBindState.Bind(pipeline->GetLayout(), 2, cameraDescriptorSet, instanceOffsets.size(), instanceOffsets.data());
+
+		// Only the position stream, the shadow pipelines don't read the shading attributes
+		geometryPool.BindVertexBuffers(static_cast<EVertexLayout>(layout), false);
+
+		for (uint32_t indexType = 0; indexType < 2; ++indexType)
+		{
+			if (drawCounts[layout][indexType] == 0)
+			{
+				continue;
+			}
+
+			geometryPool.BindIndexBuffer(indexType == 0 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+			if (!context.supportsIndirectDraws)
+			{
+				for (uint32_t i = firstDraws[layout][indexType]; i < firstDraws[layout][indexType] + drawCounts[layout][indexType]; ++i)
+				{
+					const VkDrawIndexedIndirectCommand& draw = shadowDraws[i];
+					vkCmdDrawIndexed(cmdBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+				}
+				continue;
+			}
+
+			vkCmdDrawIndexedIndirect(cmdBuffer,
+				indirectBuffer,
+				shadowDrawOffset + sizeof(VkDrawIndexedIndirectCommand) * firstDraws[layout][indexType],
+				drawCounts[layout][indexType],
+				sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+}
+
+bool VulkanRendering::AddShadowCasterInstances(const View& view, entt::entity entity, uint32_t cascadeMask)
+{
+	const uint32_t cascadeCount = std::popcount(cascadeMask);
+	if (instances.size() + cascadeCount > MAX_DRAW_INSTANCES)
+	{
+		return false;
+	}
+
+	const Transform& transform = view.registry->get<const Transform>(entity);
+	const ModelComponent& modelComponent = view.registry->get<const ModelComponent>(entity);
+	const Model* model = AssetManager::Get().LoadAsset<Model>(modelComponent.handle);
+
+	InstanceLayout casterInstance{};
+	casterInstance.model = transform.ComputeModel() * VertexPacking::GetDequantizationMatrix(model->GetMeshData());
+
+	auto it = bonePalettes.find(entity);
+	if (it != bonePalettes.end())
+	{
+		casterInstance.hasAnimation = 1;
+		casterInstance.bonePalette = it->second;
+	}
+
+	// Instance n of the caster's draws renders into the cascade of the n-th bit set in the mask
+	while (cascadeMask != 0)
+	{
+		casterInstance.cascade = std::countr_zero(cascadeMask);
+		instances.push_back(casterInstance);
+		cascadeMask &= cascadeMask - 1;
+	}
+
+	return true;
+}
+
+VkDrawIndexedIndirectCommand VulkanRendering::GetSubmeshDraw(const MeshRenderData& renderData, const MeshIndexData& submesh, uint32_t lodIndex, uint32_t instanceCount, uint32_t firstInstance)
+{
+	uint32_t indexCount = submesh.count;
+	uint32_t indexByteOffset = submesh.indexByteOffset;
+	if (lodIndex > 0 && !submesh.lods.empty())
+	{
+		const MeshLod& lod = submesh.lods[std::min<size_t>(lodIndex, submesh.lods.size()) - 1];
+		indexCount = lod.count;
+		indexByteOffset = lod.indexByteOffset;
+	}
+
+	// The pool's index buffer is bound at 0, the mesh's range and the LOD are found through the first index
+	const uint32_t indexSize = submesh.use16BitIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	VkDrawIndexedIndirectCommand draw{};
+	draw.indexCount = indexCount;
+	draw.instanceCount = instanceCount;
+	draw.firstIndex = (renderData.indexOffset + indexByteOffset) / indexSize;
+	draw.vertexOffset = static_cast<int32_t>(renderData.baseVertex) + submesh.vertexOffset;
+	draw.firstInstance = firstInstance;
+	return draw;
+}
+
+void VulkanRendering::DrawSubmesh(VkCommandBuffer cmdBuffer, const MeshRenderData& renderData, const MeshIndexData& submesh, uint32_t lodIndex, uint32_t instanceCount, uint32_t firstInstance)
+{
+	geometryPool.BindIndexBuffer(submesh.use16BitIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+	const VkDrawIndexedIndirectCommand draw = GetSubmeshDraw(renderData, submesh, lodIndex, instanceCount, firstInstance);
+	vkCmdDrawIndexed(cmdBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+}
+
+void VulkanRendering::DrawSubmeshMeshlets(VkCommandBuffer cmdBuffer, const MeshRenderData& renderData, const MeshIndexData& submesh, const glm::mat4& model, const glm::vec3& scale, const Frustum& cameraFrustum, const glm::vec3& cameraPosition, uint32_t firstInstance)
+{
+	const float maxScale = std::max({ std::abs(scale.x), std::abs(scale.y), std::abs(scale.z) });
+
+	// The normal cones can't be moved to local space when the model stretches
+	const bool isUniformScale = std::abs(scale.x - scale.y) <= std::numeric_limits<float>::epsilon() * maxScale &&
+		std::abs(scale.x - scale.z) <= std::numeric_limits<float>::epsilon() * maxScale;
+
+	const glm::vec3 localCameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+	const uint32_t meshletCount = static_cast<uint32_t>(submesh.meshlets.size());
+	const uint32_t visibleCount = MeshletCulling::CullMeshlets(submesh.meshletBounds,
+		meshletCount,
+		cameraFrustum.ToLocalSpace(model),
+		maxScale,
+		localCameraPosition,
+		isUniformScale,
+		meshletVisibility);
+
+	if (visibleCount == 0)
+	{
+		return;
+	}
+
+	const uint32_t indexSize = submesh.use16BitIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	const uint32_t submeshFirstIndex = (renderData.indexOffset + submesh.indexByteOffset) / indexSize;
+	geometryPool.BindIndexBuffer(submesh.use16BitIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+	// The meshlets are contiguous in the index buffer so each run of visible meshlets is a single draw
+	uint32_t meshletIndex = 0;
+	while (meshletIndex < meshletCount)
+	{
+		if (meshletVisibility[meshletIndex] == 0)
+		{
+			++meshletIndex;
+			continue;
+		}
+
+		const uint32_t firstIndex = submeshFirstIndex + submesh.meshlets[meshletIndex].firstIndex;
+		uint32_t indexCount = 0;
+		while (meshletIndex < meshletCount && meshletVisibility[meshletIndex] != 0)
+		{
+			indexCount += submesh.meshlets[meshletIndex].indexCount;
+			++meshletIndex;
+		}
+
+		vkCmdDrawIndexed(cmdBuffer,
+			indexCount,
+			1,
+			firstIndex,
+			static_cast<int32_t>(renderData.baseVertex) + submesh.vertexOffset,
+			firstInstance);
+	}
 }
 
 // TODO the descriptors need to be cleaned up!
@@ -1748,207 +2507,577 @@ void VulkanRendering::DrawSingle(const View& view)
 		UpdateProjection(camera.data.projection);
 	}
 
-	if (camera.viewChanged)
-	{
-		UpdateView(camera.data.view);
-	}
+	if (camera.viewChanged)
+	{
+		UpdateView(camera.data.view);
+	}
+
+	// Only need to update shadow data once, not per frame
+	// TODO need to find a better way to update this based on the view instead of just updating each frame
+
+	if (currentFrame == 0)
+	{
+		ShadowData shadowData{};
+		shadowData.cascadeCount = camera.shadowCascadeLevels.size();
+		for (int32_t i = 0; i < shadowData.cascadeCount; ++i)
+		{
+			shadowData.cascadePlaneDistance[i] = camera.shadowCascadeLevels[i];
+		}
+		shadowData.farPlane = camera.data.farView;
+
+		for (size_t i = 0; i < shadowMapData.cascadeTiles.size(); ++i)
+		{
+			shadowData.cascadeAtlasRects[i] = shadowMapData.atlas.GetUVRect(shadowMapData.cascadeTiles[i]);
+		}
+
+		UpdateBuffer(descriptorRegistry->GetShadowDataBuffer(), 0, sizeof(ShadowData), &shadowData);
+
+		RenderUtilities::SetDebugName(context.device, std::get<uintptr_t>(descriptorRegistry->GetShadowDataBuffer().buffer), VK_OBJECT_TYPE_BUFFER, "Shadow Data Buffer");
+	}
+
+	// The render queue and the instances were built before the shadow pass
+	const Frustum cameraFrustum = Frustum::FromViewProjection(camera.data.projection * camera.data.view);
+
+	SharedConstant sharedConstant{};
+	sharedConstant.viewPosition = glm::vec4(camera.data.position, 1.0f);
+	sharedConstant.lightsCount = view.lightsInView.size();
+	sharedConstant.ambientStrength = 0.1f;
+
+	// Only the state that differs from the previous group is bound, the descriptor sets are filtered by the bind state
+	RenderPipeline* pipeline = nullptr;
+	EPipelineType boundPipelineType = EPipelineType::PBR;
+	uint32_t boundMaterial = 0;
+
+	for (uint32_t groupIndex = 0; groupIndex < instanceGroups.size(); ++groupIndex)
+	{
+		const InstanceGroup& group = instanceGroups[groupIndex];
+
+		// The groups of a culled batch are all drawn by its first group
+		if (group.culledBatch != NO_CULLED_DRAW && culledBatches[group.culledBatch].firstGroup != groupIndex)
+		{
+			continue;
+		}
+
+		const DrawPacket& packet = *group.packet;
+
+		const MeshData& meshData = packet.model->GetMeshData();
+		const MeshRenderData& renderData = packet.model->GetRenderData();
+
+		const EPipelineType pipelineType = RenderQueue::GetPipeline(packet.key);
+		if (pipeline == nullptr || pipelineType != boundPipelineType)
+		{
+			pipeline = renderPipelines[pipelineType];
+			pipeline->Bind(cmdBuffer);
+			boundPipelineType = pipelineType;
+
+			BindGlobalDescriptorSets(pipeline);
+
+			// The constants are pushed whole after a layout change, with the group's material
+			boundMaterial = meshData.materials[packet.submesh].materialInstanceHandle;
+			sharedConstant.materialIndex = boundMaterial;
+
+			vkCmdPushConstants(cmdBuffer,
+				pipeline->GetLayout(),
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0,
+				sizeof(SharedConstant),
+				&sharedConstant);
+		}
+
+		// Every mesh of a layout shares the same buffers, they are only bound again when the layout changes
+		geometryPool.BindVertexBuffers(renderData.layout, true);
+
+		// The materials are data in the material buffer, switching material only pushes its index
+		const uint32_t material = meshData.materials[packet.submesh].materialInstanceHandle;
+		if (material != boundMaterial)
+		{
+			vkCmdPushConstants(cmdBuffer,
+				pipeline->GetLayout(),
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				offsetof(SharedConstant, materialIndex),
+				sizeof(uint32_t),
+				&material);
+
+			boundMaterial = material;
+		}
+
+		DrawInstanceGroup(cmdBuffer, view, group, cameraFrustum);
+	}
+}
+
+void VulkanRendering::DrawDepthPrePass(const View& view)
+{
+	VkCommandBuffer cmdBuffer = renderFrames[currentFrame].commandBuffer;
+
+	const Frustum cameraFrustum = Frustum::FromViewProjection(view.camera->data.projection * view.camera->data.view);
+
+	RenderPipeline* pipeline = nullptr;
+	EPipelineType boundPipelineType = EPipelineType::DepthPrePass;
+
+	// Same groups as the color pass so that its EQUAL test passes on every drawn pixel
+	for (uint32_t groupIndex = 0; groupIndex < instanceGroups.size(); ++groupIndex)
+	{
+		const InstanceGroup& group = instanceGroups[groupIndex];
+
+		if (group.culledBatch != NO_CULLED_DRAW && culledBatches[group.culledBatch].firstGroup != groupIndex)
+		{
+			continue;
+		}
+
+		// Only the PBR pipelines test against the pre-pass depth
+		const EPipelineType materialPipeline = RenderQueue::GetPipeline(group.packet->key);
+		if (materialPipeline != EPipelineType::PBR && materialPipeline != EPipelineType::PBRSkinned)
+		{
+			continue;
+		}
+
+		const MeshRenderData& renderData = group.packet->model->GetRenderData();
+
+		const EPipelineType pipelineType = renderData.layout == EVertexLayout::Skinned ? EPipelineType::DepthPrePassSkinned : EPipelineType::DepthPrePass;
+		if (pipeline == nullptr || pipelineType != boundPipelineType)
+		{
+			pipeline = renderPipelines[pipelineType];
+			pipeline->Bind(cmdBuffer);
+			boundPipelineType = pipelineType;
+
+			BindGlobalDescriptorSets(pipeline);
+		}
+
+		// Positions only
+		geometryPool.BindVertexBuffers(renderData.layout, false);
+
+		DrawInstanceGroup(cmdBuffer, view, group, cameraFrustum);
+	}
+}
+
+void VulkanRendering::DrawInstanceGroup(VkCommandBuffer cmdBuffer, const View& view, const InstanceGroup& group, const Frustum& cameraFrustum)
+{
+	const DrawPacket& packet = *group.packet;
+
+	const MeshData& meshData = packet.model->GetMeshData();
+	const MeshRenderData& renderData = packet.model->GetRenderData();
+
+	const MeshIndexData& submesh = meshData.meshIndices[packet.submesh];
+	if (group.culledBatch != NO_CULLED_DRAW)
+	{
+		const CulledBatch& batch = culledBatches[group.culledBatch];
+
+		geometryPool.BindIndexBuffer(submesh.use16BitIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+		gpuCulling.DrawBatch(cmdBuffer, currentFrame, group.culledBatch, batch.firstDraw, batch.drawCount);
+	}
+	else if (IsCulledPerMeshlet(packet))
+	{
+		const Transform& transform = view.registry->get<const Transform>(packet.entity);
+		DrawSubmeshMeshlets(cmdBuffer, renderData, submesh, transform.ComputeModel(), transform.scale, cameraFrustum, view.camera->data.position, group.firstInstance);
+	}
+	else
+	{
+		DrawSubmesh(cmdBuffer, renderData, submesh, packet.lodIndex, group.instanceCount, group.firstInstance);
+	}
+}
+
+void VulkanRendering::BuildRenderQueue(const View& view)
+{
+	const CameraData& cameraData = view.camera->data;
+	AssetManager& assetManager = AssetManager::Get();
+
+	// The GPU culling tests every model, otherwise the CPU culled view is drawn
+	const std::vector<entt::entity>& entities = IsGpuCulling() ? view.shadowCasters : view.entitiesInView;
+
+	// One packet per submesh, the sort groups them by pipeline, material and mesh
+	renderQueue.Clear();
+	for (const entt::entity& entity : entities)
+	{
+		const Transform& transform = view.registry->get<const Transform>(entity);
+		const ModelComponent& modelComponent = view.registry->get<const ModelComponent>(entity);
+		const Model* model = assetManager.LoadAsset<Model>(modelComponent.handle);
+		if (!model->IsReady())
+		{
+			continue;
+		}
+
+		const MeshData& meshData = model->GetMeshData();
+
+		const float depth = glm::length(transform.position - cameraData.position) / cameraData.farView;
+
+		for (uint32_t i = 0; i < meshData.meshesCount; ++i)
+		{
+			// Each submesh goes through its own material's pipeline
+			const uint32_t material = meshData.materials[i].materialInstanceHandle;
+			const EPipelineType pipelineType = GetMeshPipeline(materialSystem->GetPipeline(material), meshData.isSkinned);
+
+			const uint64_t key = RenderQueue::MakeKey(ERenderPass::Opaque, pipelineType, material, modelComponent.handle, depth);
+			renderQueue.Add(DrawPacket{ key, model, entity, i, modelComponent.lodIndex });
+		}
+	}
+	renderQueue.Sort();
+}
+
+bool VulkanRendering::IsGpuCulling() const
+{
+	return GPU_CULLING && context.supportsIndirectDraws;
+}
+
+bool VulkanRendering::IsCulledPerMeshlet(const DrawPacket& packet)
+{
+	return packet.lodIndex == 0 && !packet.model->GetMeshData().meshIndices[packet.submesh].meshlets.empty();
+}
+
+void VulkanRendering::BuildInstanceGroups(const View& view)
+{
+	instances.clear();
+	instanceGroups.clear();
+	culledDraws.clear();
+	culledBatches.clear();
+
+	// The groups the GPU doesn't cull keep the CPU's frustum test, also the reference of the GPU culling's result
+	const bool gpuCulled = IsGpuCulling();
+	std::unordered_set<entt::entity> entitiesInView;
+	if (gpuCulled)
+	{
+		entitiesInView.insert(view.entitiesInView.begin(), view.entitiesInView.end());
+	}
+	cpuVisibleInstances[currentFrame].clear();
+
+	// Batches of the last culled group's pipeline and material, one per index type
+	std::array<uint32_t, 2> openBatches = { NO_CULLED_DRAW, NO_CULLED_DRAW };
+
+	const std::vector<DrawPacket>& packets = renderQueue.GetPackets();
+
+	size_t runStart = 0;
+	while (runStart < packets.size())
+	{
+		// A run shares the pipeline, the material and the model, the packets only differ by their depth
+		const uint64_t stateKey = packets[runStart].key >> DRAW_KEY_DEPTH_BITS;
+		size_t runEnd = runStart + 1;
+		while (runEnd < packets.size() && (packets[runEnd].key >> DRAW_KEY_DEPTH_BITS) == stateKey && packets[runEnd].model == packets[runStart].model)
+		{
+			++runEnd;
+		}
+
+		// The submeshes and LODs of the run are drawn separately, the sort is stable so each group stays front to back
+		instanceRun.clear();
+		for (size_t i = runStart; i < runEnd; ++i)
+		{
+			instanceRun.push_back(&packets[i]);
+		}
+		std::stable_sort(instanceRun.begin(), instanceRun.end(), [](const DrawPacket* a, const DrawPacket* b)
+			{
+				return a->submesh != b->submesh ? a->submesh < b->submesh : a->lodIndex < b->lodIndex;
+			});
+
+		size_t groupStart = 0;
+		while (groupStart < instanceRun.size())
+		{
+			const DrawPacket* first = instanceRun[groupStart];
+
+			// The meshlets are culled with the entity's transform, these draws can't be shared
+			size_t groupEnd = groupStart + 1;
+			if (!IsCulledPerMeshlet(*first))
+			{
+				while (groupEnd < instanceRun.size() && instanceRun[groupEnd]->submesh == first->submesh && instanceRun[groupEnd]->lodIndex == first->lodIndex)
+				{
+					++groupEnd;
+				}
+			}
+
+			const uint32_t instanceCount = static_cast<uint32_t>(std::min<size_t>(groupEnd - groupStart, MAX_DRAW_INSTANCES - instances.size()));
+			if (instanceCount == 0)
+			{
+				break;
+			}
+
+			const uint32_t groupIndex = static_cast<uint32_t>(instanceGroups.size());
+			instanceGroups.push_back(InstanceGroup{ first, static_cast<uint32_t>(instances.size()), instanceCount });
+
+			uint32_t culledDraw = NO_CULLED_DRAW;
+			if (gpuCulled && !IsCulledPerMeshlet(*first) && AddCulledDraw(groupIndex, openBatches) != NO_CULLED_DRAW)
+			{
+				culledDraw = static_cast<uint32_t>(culledDraws.size()) - 1;
+			}
+
+			uint32_t keptCount = 0;
+			for (uint32_t i = 0; i < instanceCount; ++i)
+			{
+				const DrawPacket& packet = *instanceRun[groupStart + i];
+				if (gpuCulled && culledDraw == NO_CULLED_DRAW && !entitiesInView.contains(packet.entity))
+				{
+					continue;
+				}
+				++keptCount;
+
+				const Transform& transform = view.registry->get<const Transform>(packet.entity);
+
+				InstanceLayout& instance = instances.emplace_back();
+				instance.model = transform.ComputeModel() * VertexPacking::GetDequantizationMatrix(packet.model->GetMeshData());
+				instance.normalMatrix = AlignedMatrix3{ transform.ComputeNormalMatrix(), glm::vec3(0.0f) };
+				instance.culledDraw = culledDraw;
+
+				auto it = bonePalettes.find(packet.entity);
+				if (it != bonePalettes.end())
+				{
+					instance.bonePalette = it->second;
+					instance.hasAnimation = 1;
+				}
+
+				if (DEBUG_GPU_CULLING && culledDraw != NO_CULLED_DRAW && entitiesInView.contains(packet.entity))
+				{
+					cpuVisibleInstances[currentFrame].push_back(static_cast<uint32_t>(instances.size()) - 1);
+				}
+			}
+
+			// Nothing references a group that isn't GPU culled, it can be dropped when all its instances are out of view
+			if (keptCount == 0)
+			{
+				instanceGroups.pop_back();
+			}
+			else
+			{
+				instanceGroups.back().instanceCount = keptCount;
+			}
+
+			groupStart = groupEnd;
+		}
+
+		runStart = runEnd;
+	}
+
+	// Each batch owns a range of the indirect commands large enough for all of its draws
+	uint32_t firstDraw = 0;
+	for (CulledBatch& batch : culledBatches)
+	{
+		batch.firstDraw = firstDraw;
+		firstDraw += batch.drawCount;
+	}
+
+	for (CulledDrawLayout& draw : culledDraws)
+	{
+		draw.batchFirstDraw = culledBatches[draw.batch].firstDraw;
+	}
+
+	if (!instances.empty())
+	{
+		UpdateBuffer(descriptorRegistry->GetInstanceBuffer(), INSTANCE_BUFFER_FRAME_SIZE * currentFrame, sizeof(InstanceLayout) * instances.size(), instances.data());
+
+		// The groups drawn directly read their instances in order, the culling overwrites the culled groups' ranges
+		visibleInstances.resize(instances.size());
+		std::iota(visibleInstances.begin(), visibleInstances.end(), 0);
+		UpdateBuffer(descriptorRegistry->GetVisibleInstanceBuffer(), VISIBLE_INSTANCE_BUFFER_FRAME_SIZE * currentFrame, sizeof(uint32_t) * visibleInstances.size(), visibleInstances.data());
+	}
+}
+
+uint32_t VulkanRendering::AddCulledDraw(uint32_t groupIndex, std::array<uint32_t, 2>& openBatches)
+{
+	if (culledDraws.size() >= MAX_CULLED_DRAWS)
+	{
+		return NO_CULLED_DRAW;
+	}
+
+	InstanceGroup& group = instanceGroups[groupIndex];
+	const DrawPacket& packet = *group.packet;
+	const MeshData& meshData = packet.model->GetMeshData();
+	const MeshIndexData& submesh = meshData.meshIndices[packet.submesh];
+
+	// A batch is drawn with the state of its first group, the groups can only join it when they share that state
+	const EPipelineType pipelineType = RenderQueue::GetPipeline(packet.key);
+	const uint32_t material = meshData.materials[packet.submesh].materialInstanceHandle;
+	const uint32_t indexType = submesh.use16BitIndices ? 0 : 1;
+
+	if (openBatches[0] != NO_CULLED_DRAW || openBatches[1] != NO_CULLED_DRAW)
+	{
+		const uint32_t openBatch = openBatches[openBatches[0] != NO_CULLED_DRAW ? 0 : 1];
+		const DrawPacket& batchPacket = *instanceGroups[culledBatches[openBatch].firstGroup].packet;
+		if (RenderQueue::GetPipeline(batchPacket.key) != pipelineType || batchPacket.model->GetMeshData().materials[batchPacket.submesh].materialInstanceHandle != material)
+		{
+			openBatches = { NO_CULLED_DRAW, NO_CULLED_DRAW };
+		}
+	}
+
+	if (openBatches[indexType] == NO_CULLED_DRAW)
+	{
+		if (culledBatches.size() >= MAX_CULLED_BATCHES)
+		{
+			return NO_CULLED_DRAW;
+		}
+
+		openBatches[indexType] = static_cast<uint32_t>(culledBatches.size());
+		culledBatches.push_back(CulledBatch{ groupIndex, 0, 0 });
+	}
+
+	const uint32_t batch = openBatches[indexType];
+	++culledBatches[batch].drawCount;
+	group.culledBatch = batch;
+
+	const VkDrawIndexedIndirectCommand draw = GetSubmeshDraw(packet.model->GetRenderData(), submesh, packet.lodIndex, 0, group.firstInstance);
+
+	CulledDrawLayout& culledDraw = culledDraws.emplace_back();
+	culledDraw.indexCount = draw.indexCount;
+	culledDraw.firstIndex = draw.firstIndex;
+	culledDraw.vertexOffset = draw.vertexOffset;
+	culledDraw.firstInstance = draw.firstInstance;
+	culledDraw.batch = batch;
+
+	// The static positions are quantized to the mesh bounds, the instances' model matrices map the unit cube back
+	if (meshData.isSkinned)
+	{
+		culledDraw.boundsCenter = glm::vec4((meshData.boundsMin + meshData.boundsMax) * 0.5f, 0.0f);
+		culledDraw.boundsExtent = glm::vec4((meshData.boundsMax - meshData.boundsMin) * 0.5f, 0.0f);
+	}
+	else
+	{
+		culledDraw.boundsCenter = glm::vec4(0.0f);
+		culledDraw.boundsExtent = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	}
+
+	return batch;
+}
+
+void VulkanRendering::CullInstances(const View& view)
+{
+	if (culledDraws.empty())
+	{
+		return;
+	}
+
+	const CameraData& cameraData = view.camera->data;
+	const Frustum cameraFrustum = Frustum::FromViewProjection(cameraData.projection * cameraData.view);
+
+	// The pyramid holds the previous frame's depth, the bounds are projected with the view it was built with
+	const bool testOcclusion = OCCLUSION_CULLING && hiZPyramid.IsBuilt();
+
+	gpuCulling.Dispatch(renderFrames[currentFrame].commandBuffer, currentFrame, cameraFrustum, hiZViewProjection, testOcclusion, static_cast<uint32_t>(instances.size()), culledDraws);
+}
+
+void VulkanRendering::CompareGpuCulling(uint32_t frame)
+{
+	VmaAllocation memory = RenderUtilities::GenericHandleToAllocation(descriptorRegistry->GetVisibleInstanceBuffer().memory);
+	void* data;
+	vmaMapMemory(context.allocator, memory, &data);
+	vmaInvalidateAllocation(context.allocator, memory, VkDeviceSize(VISIBLE_INSTANCE_BUFFER_FRAME_SIZE) * frame, VISIBLE_INSTANCE_BUFFER_FRAME_SIZE);
+
+	const uint32_t* visibleIds = reinterpret_cast<const uint32_t*>(static_cast<const char*>(data) + VISIBLE_INSTANCE_BUFFER_FRAME_SIZE * frame);
+	gpuCulling.GetVisibleInstances(context, frame, visibleIds, gpuVisibleInstances);
+	vmaUnmapMemory(context.allocator, memory);
 
-	// Only need to update shadow data once, not per frame
-	// TODO need to find a better way to update this based on the view instead of just updating each frame
+	// Both sets are sorted. The GPU tests the meshes' bounds and the CPU the entities' so a few instances at the edges
+	// of the frustum can differ, the occlusion test only removes instances from the GPU's set
+	const std::vector<uint32_t>& cpuInstances = cpuVisibleInstances[frame];
 
-	if (currentFrame == 0)
-	{
-		ShadowData shadowData{};
-		shadowData.cascadeCount = camera.shadowCascadeLevels.size();
-		for (int32_t i = 0; i < shadowData.cascadeCount; ++i)
-		{
-			shadowData.cascadePlaneDistance[i] = camera.shadowCascadeLevels[i];
-		}
-		shadowData.farPlane = camera.data.farView;
+	std::vector<uint32_t> gpuOnly;
+	std::set_difference(gpuVisibleInstances.begin(), gpuVisibleInstances.end(), cpuInstances.begin(), cpuInstances.end(), std::back_inserter(gpuOnly));
 
-		UpdateBuffer(descriptorRegistry->GetShadowDataBuffer(), 0, sizeof(ShadowData), &shadowData);
+	std::vector<uint32_t> cpuOnly;
+	std::set_difference(cpuInstances.begin(), cpuInstances.end(), gpuVisibleInstances.begin(), gpuVisibleInstances.end(), std::back_inserter(cpuOnly));
 
-		RenderUtilities::SetDebugName(context.device, std::get<uintptr_t>(descriptorRegistry->GetShadowDataBuffer().buffer), VK_OBJECT_TYPE_BUFFER, "Shadow Data Buffer");
-	}
+	std::cout << "GPU culled instances: " << gpuVisibleInstances.size() << ", CPU reference: " << cpuInstances.size()
+		<< ", only kept by the GPU: " << gpuOnly.size() << ", only kept by the CPU: " << cpuOnly.size() << std::endl;
 
-	AssetManager& assetManager = AssetManager::Get();
-	std::unordered_map<EPipelineType, std::vector<entt::entity>> entitiesPerPipeline;
-	for (const entt::entity& entity : view.entitiesInView)
+	if (!gpuOnly.empty())
 	{
-		// I'm only supporting materials in the same render pipeline in the model
-		const ModelComponent& modelComponent = view.registry->get<const ModelComponent>(entity);
-		const Model* model = assetManager.LoadAsset<Model>(modelComponent.handle);
-		entitiesPerPipeline[static_cast<EPipelineType>(model->GetMeshData().materials[0].pipeline)].push_back(entity);
+		std::cerr << "GPU culling kept instance " << gpuOnly.front() << " outside of the CPU culled view!" << std::endl;
 	}
 
-	VkDescriptorSet previousMaterialDescriptor = VK_NULL_HANDLE;
-
-	uint32_t entityIndex = 0;
-	for (const auto& it : entitiesPerPipeline)
+	if (!OCCLUSION_CULLING && !cpuOnly.empty())
 	{
-		RenderPipeline* pipeline = renderPipelines[it.first];
+		std::cerr << "GPU culling removed instance " << cpuOnly.front() << " inside of the CPU culled view!" << std::endl;
+	}
+}
 
-		pipeline->Bind(cmdBuffer);
+void VulkanRendering::GatherBonePalettes(const View& view)
+{
+	bonePalettes.clear();
 
-		const entt::registry* registry = view.registry;
-		for (const entt::entity& entity : it.second)
+	// The shadow casters are every model, the palettes are shared by the shadow and the main passes
+	for (entt::entity entity : view.shadowCasters)
+	{
+		if (auto animatorComponent = view.registry->try_get<AnimatorComponent>(entity))
 		{
-			const Transform& transform = registry->get<const Transform>(entity);
-			const ModelComponent& modelComponent = registry->get<const ModelComponent>(entity);
-
-			SharedConstant sharedConstant{};
-			sharedConstant.model = transform.ComputeModel();
-			const glm::mat3 normalMatrix = transform.ComputeNormalMatrix();
-			const glm::vec3 viewPosition = camera.data.position;
-			sharedConstant.normalMatrix = AlignedMatrix3{ normalMatrix, viewPosition };
-			sharedConstant.lightsCount = view.lightsInView.size();
-			sharedConstant.ambientStrength = 0.1f;
-
-			if (auto animatorComponent = view.registry->try_get<AnimatorComponent>(entity))
-			{
-				sharedConstant.hasAnimations = 1;
-			}
-
-			vkCmdPushConstants(cmdBuffer,
-				pipeline->GetLayout(),
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SharedConstant),
-				&sharedConstant);
-
-			uint32_t descriptorOffset = 0;
-			if (pipeline->SupportsCamera())
+			const uint32_t slot = static_cast<uint32_t>(bonePalettes.size());
+			if (slot >= MAX_ANIMATED_ENTITIES)
 			{
-				VkDescriptorSet cameraDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetCameraMatricesDescriptorSet());
-
-				vkCmdBindDescriptorSets(
-					cmdBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipeline->GetLayout(),
-					descriptorOffset,
-					1,
-					&cameraDescriptorSet,
-					0,
-					nullptr
-				);
-
-				descriptorOffset++;
+				break;
 			}
 
-			if (pipeline->SupportsLight())
-			{
-				VkDescriptorSet lightDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetLightDescriptorSet());
-
-				vkCmdBindDescriptorSets(
-					cmdBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipeline->GetLayout(),
-					descriptorOffset,
-					1,
-					&lightDescriptorSet,
-					0,
-					nullptr
-				);
+			view.animationSystem->GatherDrawData(animatorComponent->animatorInstanceHandle, slot, currentFrame);
+			bonePalettes[entity] = slot;
+		}
+	}
+}
 
-				descriptorOffset++;
+void VulkanRendering::BindGlobalDescriptorSets(RenderPipeline* pipeline)
+{
+	uint32_t descriptorOffset = 0;
+	if (pipeline->SupportsCamera())
+	{
+		VkDescriptorSet cameraDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetCameraMatricesDescriptorSet());
 
-				VkDescriptorSet shadowDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetShadowDescriptorSet(currentFrame));
+		const std::array<uint32_t, 2> instanceOffsets =
+		{
+			INSTANCE_BUFFER_FRAME_SIZE * currentFrame,
+			VISIBLE_INSTANCE_BUFFER_FRAME_SIZE * currentFrame
+		};
 
-				std::array<uint32_t, 1> dynamicOffsets =
-				{
-					sizeof(glm::mat4) * currentFrame * MAX_SM
-				};
-
-				vkCmdBindDescriptorSets(
-					cmdBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipeline->GetLayout(),
-					descriptorOffset,
-					1,
-					&shadowDescriptorSet,
-					dynamicOffsets.size(),
-					dynamicOffsets.data()
-				);
-
-				descriptorOffset++;
-			}
+		descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, cameraDescriptorSet, instanceOffsets.size(), instanceOffsets.data());
 
-			if (pipeline->SupportsAnimation())
-			{
-				VkDescriptorSet animationDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetAnimationDescriptorSet());
+		descriptorOffset++;
+	}
 
-				uint32_t dynamicOffset = 0;
+	if (pipeline->SupportsLight())
+	{
+		VkDescriptorSet lightDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetLightDescriptorSet());
 
-				if (auto animatorComponent = view.registry->try_get<AnimatorComponent>(entity))
-				{
-					view.animationSystem->GatherDrawData(animatorComponent->animatorInstanceHandle, entityIndex, currentFrame);
-					dynamicOffset = currentFrame * sizeof(AnimationLayout) * MAX_ANIMATED_ENTITIES;
-				}
+		const uint32_t clusterOffset = CLUSTER_BUFFER_FRAME_SIZE * currentFrame;
 
-				vkCmdBindDescriptorSets(cmdBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipeline->GetLayout(),
-					descriptorOffset,
-					1,
-					&animationDescriptorSet,
-					1,
-					&dynamicOffset);
+		descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, lightDescriptorSet, 1, &clusterOffset);
 
-				descriptorOffset++;
-			}
+		descriptorOffset++;
 
-			const Model* model = AssetManager::Get().LoadAsset<Model>(modelComponent.handle);
-			const MeshData& meshData = model->GetMeshData();
-			const MeshRenderData& renderData = model->GetRenderData();
+		VkDescriptorSet shadowDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetShadowDescriptorSet(currentFrame));
 
-			VkBuffer buffer = RenderUtilities::GenericHandleToBuffer(renderData.vertex.buffer);
-			VkDeviceSize zeroOffset[] = { 0 };
-			vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, zeroOffset);
+		std::array<uint32_t, 1> dynamicOffsets =
+		{
+			sizeof(glm::mat4) * currentFrame * MAX_SM
+		};
 
-			VkBuffer indexBuffer = RenderUtilities::GenericHandleToBuffer(renderData.index.buffer);
-			vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, shadowDescriptorSet, dynamicOffsets.size(), dynamicOffsets.data());
 
-			for (int32_t i = 0; i < meshData.meshesCount; ++i)
-			{
-				MaterialInstance materialInstance;
-				materialSystem->TryGetMaterialInstance(meshData.materials[i].materialInstanceHandle, materialInstance);
+		descriptorOffset++;
+	}
 
-				VkDescriptorSet materialDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(materialInstance.descriptorSet);
-				if (previousMaterialDescriptor != materialDescriptorSet)
-				{
-					vkCmdBindDescriptorSets(cmdBuffer,
-						VK_PIPELINE_BIND_POINT_GRAPHICS,
-						pipeline->GetLayout(),
-						descriptorOffset,
-						1,
-						&materialDescriptorSet,
-						0, nullptr);
+	// Only read by the entities with an animator, bound once for the whole pipeline
+	if (pipeline->SupportsAnimation())
+	{
+		VkDescriptorSet animationDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetAnimationDescriptorSet());
 
-					previousMaterialDescriptor = materialDescriptorSet;
+		const uint32_t dynamicOffset = currentFrame * sizeof(AnimationLayout) * MAX_ANIMATED_ENTITIES;
 
-					descriptorOffset++;
-				}
+		descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, animationDescriptorSet, 1, &dynamicOffset);
 
-				vkCmdDrawIndexed(cmdBuffer,
-					meshData.meshIndices[i].count,
-					1,
-					meshData.offset[i],
-					0,
-					0);
-			}
+		descriptorOffset++;
+	}
 
-			++entityIndex;
-		}
+	if (pipeline->SupportsMaterial())
+	{
+		VkDescriptorSet materialDescriptorSet = RenderUtilities::GenericHandleToDescriptorSet(descriptorRegistry->GetMaterialDescriptorSet(currentFrame));
+		descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, materialDescriptorSet);
 	}
 }
 
 void VulkanRendering::EndFrame()
 {
-	VkResult fenceStatus = vkGetFenceStatus(context.device, renderFrames[currentFrame].inFlightFence);
-	if (fenceStatus == VK_SUCCESS)
+	// The released resources are destroyed by DrawFrame once the frames that can use them are done
+}
+
+void VulkanRendering::WaitForFramesInFlight()
+{
+	std::vector<VkFence> fences;
+	fences.reserve(renderFrames.size());
+	for (const Frame& frame : renderFrames)
 	{
-		CleanupPendingDestroyBuffers();
+		fences.push_back(frame.inFlightFence);
 	}
+
+	vkWaitForFences(context.device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
 }
 
 VkCommandBuffer VulkanRendering::GetCurrentCommandBuffer() const
@@ -2019,9 +3148,41 @@ void VulkanRendering::CreateMeshVertexBuffer(const MeshData& meshData, MeshRende
 {
 	/*auto func = [&]()
 		{*/
-	const VkDeviceSize verticesBufferSize = sizeof(Vertex) * meshData.verticesCount;
-	VkDeviceSize indicesBufferSize = sizeof(uint32_t) * meshData.indicesCount;
-	const VkDeviceSize stagingBufferSize = verticesBufferSize + indicesBufferSize;
+	// The GPU gets the compact layouts, the full Vertex stays on the CPU side.
+	// Positions and shading attributes are split so the depth only passes fetch the positions alone
+	std::vector<StaticPosition> staticPositions;
+	std::vector<SkinnedPosition> skinnedPositions;
+	const void* positions = nullptr;
+	VkDeviceSize positionsBufferSize = 0;
+	if (meshData.isSkinned)
+	{
+		VertexPacking::PackSkinnedPositions(meshData, skinnedPositions);
+		positions = skinnedPositions.data();
+		positionsBufferSize = sizeof(SkinnedPosition) * skinnedPositions.size();
+	}
+	else
+	{
+		VertexPacking::PackStaticPositions(meshData, staticPositions);
+		positions = staticPositions.data();
+		positionsBufferSize = sizeof(StaticPosition) * staticPositions.size();
+	}
+
+	std::vector<VertexAttributes> attributes;
+	VertexPacking::PackAttributes(meshData, attributes);
+	const VkDeviceSize attributesBufferSize = sizeof(VertexAttributes) * attributes.size();
+
+	const VkDeviceSize indicesBufferSize = meshData.indexBufferSize;
+
+	const EVertexLayout layout = meshData.isSkinned ? EVertexLayout::Skinned : EVertexLayout::Static;
+	outRenderData.layout = layout;
+	if (!geometryPool.Allocate(layout, static_cast<uint32_t>(attributes.size()), meshData.indexBufferSize, outRenderData))
+	{
+		// The mesh has no range of its own, it's skipped by every pass
+		outRenderData.state = ERenderDataLoadState::Failed;
+		return;
+	}
+
+	const VkDeviceSize stagingBufferSize = positionsBufferSize + attributesBufferSize + indicesBufferSize;
 
 	VkBuffer stagingBuffer;
 	VmaAllocation staginBufferMemory;
@@ -2035,53 +3196,49 @@ void VulkanRendering::CreateMeshVertexBuffer(const MeshData& meshData, MeshRende
 		staginBufferMemory
 	);
 
+	// Staging layout: [positions][attributes][indices]
+	const VkDeviceSize indicesOffset = positionsBufferSize + attributesBufferSize;
+
 	void* data;
 	vmaMapMemory(context.allocator, staginBufferMemory, &data);
-	memcpy(data, meshData.vertices.data(), static_cast<size_t>(verticesBufferSize));
+	memcpy(data, positions, static_cast<size_t>(positionsBufferSize));
+	memcpy(reinterpret_cast<char*>(data) + positionsBufferSize, attributes.data(), static_cast<size_t>(attributesBufferSize));
 
-	uint32_t previousSize = 0;
-	for (int32_t i = 0; i < meshData.meshesCount; ++i)
+	auto copyIndices = [&](const std::vector<uint32_t>& indices, uint32_t count, uint32_t indexByteOffset, bool use16BitIndices)
+		{
+			char* destination = reinterpret_cast<char*>(data) + indicesOffset + indexByteOffset;
+			if (use16BitIndices)
+			{
+				uint16_t* indices16 = reinterpret_cast<uint16_t*>(destination);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					indices16[i] = static_cast<uint16_t>(indices[i]);
+				}
+			}
+			else
+			{
+				memcpy(destination, indices.data(), sizeof(uint32_t) * count);
+			}
+		};
+
+	// Each submesh is followed by its LODs
+	for (const MeshIndexData& submesh : meshData.meshIndices)
 	{
-		const size_t bufferSize = sizeof(uint32_t) * meshData.meshIndices[i].count;
-		memcpy(reinterpret_cast<char*>(data) + verticesBufferSize + previousSize, meshData.meshIndices[i].indices.data(), bufferSize);
-		previousSize += bufferSize;
+		copyIndices(submesh.indices, submesh.count, submesh.indexByteOffset, submesh.use16BitIndices);
+		for (const MeshLod& lod : submesh.lods)
+		{
+			copyIndices(lod.indices, lod.count, lod.indexByteOffset, submesh.use16BitIndices);
+		}
 	}
 	vmaUnmapMemory(context.allocator, staginBufferMemory);
 
-	VkBuffer vertexBuffer;
-	VkBuffer indexBuffer;
-
-	VmaAllocation vertexMemory;
-	VmaAllocation indexMemory;
-
-	CreateBuffer(
-		verticesBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VMA_MEMORY_USAGE_AUTO,
-		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
-		vertexBuffer,
-		vertexMemory
-	);
-
-	CreateBuffer(
-		indicesBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VMA_MEMORY_USAGE_AUTO,
-		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
-		indexBuffer,
-		indexMemory
-	);
-
-	// Vertex buffer
-	CopyBuffer(stagingBuffer, vertexBuffer, verticesBufferSize, 0, 0);
+	const VkDeviceSize positionStride = GeometryPool::GetPositionStride(layout);
 
-	// Indices buffer
-	CopyBuffer(stagingBuffer, indexBuffer, indicesBufferSize, verticesBufferSize, 0);
+	// The streams and the indices are copied in the mesh's ranges of the shared buffers
+	CopyBuffer(stagingBuffer, geometryPool.GetPositionBuffer(layout), positionsBufferSize, 0, positionStride * outRenderData.baseVertex);
+	CopyBuffer(stagingBuffer, geometryPool.GetAttributeBuffer(layout), attributesBufferSize, positionsBufferSize, sizeof(VertexAttributes) * outRenderData.baseVertex);
+	CopyBuffer(stagingBuffer, geometryPool.GetIndexBuffer(), indicesBufferSize, indicesOffset, outRenderData.indexOffset);
 
-	outRenderData.vertex.buffer = RenderUtilities::BufferToGenericHandle(vertexBuffer);
-	outRenderData.index.buffer = RenderUtilities::BufferToGenericHandle(indexBuffer);
-	outRenderData.vertex.memory = RenderUtilities::AllocationToGenericHandle(vertexMemory);
-	outRenderData.index.memory = RenderUtilities::AllocationToGenericHandle(indexMemory);
 	outRenderData.state = ERenderDataLoadState::Ready;
 
 	vmaDestroyBuffer(context.allocator, stagingBuffer, staginBufferMemory);
@@ -2259,12 +3416,17 @@ void VulkanRendering::UpdateBuffer(AllocatedBuffer buffer, uint32_t offset, uint
 
 void VulkanRendering::DestroyBuffer(AllocatedBuffer buffer)
 {
-	buffersPendingDelete.push_back(buffer);
+	buffersPendingDelete[releaseFrame].push_back(buffer);
 }
 
 void VulkanRendering::DestroyTexture(AllocatedTexture texture)
 {
-	imagesPendingDelete.push_back(texture);
+	imagesPendingDelete[releaseFrame].push_back(texture);
+}
+
+void VulkanRendering::DestroyMeshVertexBuffer(const MeshRenderData& renderData)
+{
+	meshesPendingDelete[releaseFrame].push_back(renderData);
 }
 
 void VulkanRendering::RecordCommandBuffer(uint32_t imageIndex)
@@ -2281,17 +3443,53 @@ void VulkanRendering::RecordCommandBuffer(uint32_t imageIndex)
 		throw std::runtime_error("Failed to begin recording command buffer!");
 	}
 
+	descriptorBindState.Begin(frame.commandBuffer);
+	geometryPool.Begin(frame.commandBuffer);
+
 	World* world = GameEngine->GetCurrentWorld();
 
 	View view;
 	world->GetWorldView(&view);
 
+	// Before the shadow pass so the casters use the same LOD as the mesh they shadow
+	SelectLods(view);
+
+	GatherBonePalettes(view);
+
+	BuildLightClusters(view);
+
+	materialSystem->FlushMaterials(currentFrame);
+
+	if (DEBUG_GPU_CULLING)
+	{
+		// The frame's previous culling is done, its fence was waited on before recording
+		CompareGpuCulling(currentFrame);
+	}
+
+	// Before the shadow pass, the culling is recorded outside of the render passes and the casters' instances follow
+	BuildRenderQueue(view);
+	BuildInstanceGroups(view);
+	hiZPyramid.InitializeLayout(frame.commandBuffer);
+	CullInstances(view);
+
 	ShadowRenderPass(view);
 
 	TransitionShadowLayoutToFragment(frame.commandBuffer);
 
+	if (context.depthPrePass != VK_NULL_HANDLE)
+	{
+		DepthPrePass(imageIndex, view);
+	}
+
 	DrawRenderPass(imageIndex, view);
 
+	// Before the additive pass clears the depth, the next frame culls against it
+	if (OCCLUSION_CULLING)
+	{
+		hiZPyramid.Build(frame.commandBuffer, imageIndex);
+		hiZViewProjection = view.camera->data.projection * view.camera->data.view;
+	}
+
 	if (DEBUG_SHADOW_PASS)
 	{
 		DebugShadowPass(imageIndex, view);
@@ -2303,48 +3501,81 @@ void VulkanRendering::RecordCommandBuffer(uint32_t imageIndex)
 	{
 		throw std::runtime_error("failed to record command buffer!");
 	}
+
+	if (DEBUG_DESCRIPTOR_BINDS)
+	{
+		const DescriptorBindStats& stats = descriptorBindState.GetStats();
+		std::cout << "Descriptor binds: " << stats.binds << ", skipped: " << stats.skipped << std::endl;
+	}
+}
+
+void VulkanRendering::BuildLightClusters(const View& view)
+{
+	clusteredLighting.BeginLights();
+	for (entt::entity entity : view.lightsInView)
+	{
+		const Light& light = view.registry->get<const Light>(entity);
+		clusteredLighting.AddLight(light.lightInstanceHandle, view.lightSystem->GetInstance(light.lightInstanceHandle));
+	}
+
+	const CameraData& cameraData = view.camera->data;
+	clusteredLighting.Build(cameraData.projection, cameraData.view, cameraData.nearView, cameraData.farView, context.swapChainExtent.width, context.swapChainExtent.height);
+
+	// This frame's copy isn't read anymore, its fence was waited on before recording
+	const uint32_t frameOffset = CLUSTER_BUFFER_FRAME_SIZE * currentFrame;
+	ClusterGridHeader header = clusteredLighting.GetHeader();
+	std::vector<uint32_t>& items = clusteredLighting.GetItems();
+
+	AllocatedBuffer clusterBuffer = descriptorRegistry->GetClusterBuffer();
+	UpdateBuffer(clusterBuffer, frameOffset, sizeof(ClusterGridHeader), &header);
+	UpdateBuffer(clusterBuffer, frameOffset + sizeof(ClusterGridHeader), sizeof(uint32_t) * items.size(), items.data());
+}
+
+void VulkanRendering::SelectLods(const View& view)
+{
+	const float viewportHeight = static_cast<float>(context.swapChainExtent.height);
+
+	// The shadow casters outside the camera's frustum still get a LOD for the shadow pass
+	for (entt::entity entity : view.shadowCasters)
+	{
+		ModelComponent& modelComponent = view.registry->get<ModelComponent>(entity);
+		const Transform& transform = view.registry->get<const Transform>(entity);
+
+		const Model* model = AssetManager::Get().LoadAsset<Model>(modelComponent.handle);
+		modelComponent.lodIndex = LodSelection::SelectLod(model->GetMeshData(), transform, view.camera->data, viewportHeight, modelComponent.lodIndex);
+	}
 }
 
 void VulkanRendering::ShadowRenderPass(const View& view)
 {
 	Frame& frame = renderFrames[currentFrame];
 
+	// The pass loads the cached cascades so the image can't be in the undefined layout
+	if (!shadowMapData.isLayoutInitialized)
+	{
+		TransitionShadowLayoutFromUndefined(frame.commandBuffer);
+		shadowMapData.isLayoutInitialized = true;
+	}
+
+	const uint32_t atlasSize = shadowMapData.atlas.GetSize();
+
 	VkRenderPassBeginInfo passInfo{};
 	passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	passInfo.renderPass = context.shadowPass;
-	passInfo.framebuffer = shadowMapData[currentFrame].shadowMappingFB;
-
-	VkClearValue clear{};
-	clear.depthStencil = { 1.0f, 0 };
+	passInfo.framebuffer = shadowMapData.shadowMappingFB;
 
-	passInfo.clearValueCount = 1;
-	passInfo.pClearValues = &clear;
+	passInfo.clearValueCount = 0;
+	passInfo.pClearValues = nullptr;
 	passInfo.renderArea.offset = { 0, 0 };
 	passInfo.renderArea.extent =
 	{
-		SHADOW_MAP_SIZE,
-		SHADOW_MAP_SIZE
+		atlasSize,
+		atlasSize
 	};
 
 	vkCmdBeginRenderPass(frame.commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	// TODO Keep these ? What if I want to add a setting menu for shadows ?
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = static_cast<float>(SHADOW_MAP_SIZE);
-	viewport.width = static_cast<float>(SHADOW_MAP_SIZE);
-	viewport.height = -static_cast<float>(SHADOW_MAP_SIZE);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	vkCmdSetViewport(frame.commandBuffer, 0, 1, &viewport);
-
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE };
-
-	vkCmdSetScissor(frame.commandBuffer, 0, 1, &scissor);
-
+	// DrawShadows sets a viewport per cascade once the cascades have their tiles
 	DrawShadows(view);
 
 	vkCmdEndRenderPass(frame.commandBuffer);
@@ -2401,27 +3632,35 @@ void VulkanRendering::DebugShadowPass(uint32_t imageIndex, const View& view)
 	vkCmdEndRenderPass(frame.commandBuffer);
 }
 
-void VulkanRendering::DrawRenderPass(uint32_t imageIndex, const View& view)
+void VulkanRendering::DepthPrePass(uint32_t imageIndex, const View& view)
 {
 	Frame& frame = renderFrames[currentFrame];
 
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = context.renderPass;
-	renderPassInfo.framebuffer = swapChainData.swapChainFramebuffers[imageIndex];
+	renderPassInfo.renderPass = context.depthPrePass;
+	renderPassInfo.framebuffer = swapChainData.depthPrePassFramebuffers[imageIndex];
 
 	renderPassInfo.renderArea.offset = { 0, 0 };
 	renderPassInfo.renderArea.extent = context.swapChainExtent;
 
-	std::array<VkClearValue, 2> clearValues{};
-	clearValues[0].color = { {0.1f, 0.1f, 0.1f, 1.0f} };
-	clearValues[1].depthStencil = { 1.0f, 0 };
+	VkClearValue clearValue{};
+	clearValue.depthStencil = { 1.0f, 0 };
 
-	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderPassInfo.pClearValues = clearValues.data();
+	renderPassInfo.clearValueCount = 1;
+	renderPassInfo.pClearValues = &clearValue;
 
 	vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
+	SetMainViewport(frame.commandBuffer);
+
+	DrawDepthPrePass(view);
+
+	vkCmdEndRenderPass(frame.commandBuffer);
+}
+
+void VulkanRendering::SetMainViewport(VkCommandBuffer cmdBuffer)
+{
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = static_cast<float>(context.swapChainExtent.height);
@@ -2429,17 +3668,45 @@ void VulkanRendering::DrawRenderPass(uint32_t imageIndex, const View& view)
 	viewport.height = -static_cast<float>(context.swapChainExtent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(frame.commandBuffer, 0, 1, &viewport);
+	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0, 0 };
 	scissor.extent = context.swapChainExtent;
-	vkCmdSetScissor(frame.commandBuffer, 0, 1, &scissor);
+	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+}
+
+void VulkanRendering::DrawRenderPass(uint32_t imageIndex, const View& view)
+{
+	Frame& frame = renderFrames[currentFrame];
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = context.renderPass;
+	renderPassInfo.framebuffer = swapChainData.swapChainFramebuffers[imageIndex];
+
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = context.swapChainExtent;
+
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {0.1f, 0.1f, 0.1f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.pClearValues = clearValues.data();
+
+	vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	SetMainViewport(frame.commandBuffer);
 
 	DrawSingle(view);
 
 #if WITH_EDITOR
 	editorUI->DrawFrame(reinterpret_cast<uintptr_t>(renderFrames[currentFrame].commandBuffer));
+
+	// The UI binds its own sets and buffers
+	descriptorBindState.Invalidate();
+	geometryPool.Invalidate();
 #endif
 
 	vkCmdEndRenderPass(frame.commandBuffer);
@@ -2466,6 +3733,10 @@ void VulkanRendering::DrawShadowDebugQuad(const View& view)
 		debugData.nearPlane = camera.data.nearView;
 		debugData.farPlane = camera.data.farView;
 		debugData.layer = TRACKED_LAYER;
+		if (static_cast<size_t>(TRACKED_LAYER) < shadowMapData.cascadeTiles.size())
+		{
+			debugData.atlasRect = shadowMapData.atlas.GetUVRect(shadowMapData.cascadeTiles[TRACKED_LAYER]);
+		}
 
 		UpdateBuffer(debugBuffer, 0, sizeof(ShadowDebugData), &debugData);
 	}
@@ -2475,53 +3746,30 @@ void VulkanRendering::DrawShadowDebugQuad(const View& view)
 
 	uint32_t dynamicOffset = sizeof(glm::mat4) * currentFrame;
 
-	vkCmdBindDescriptorSets(
-		cmdBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipeline->GetLayout(),
-		descriptorOffset,
-		1,
-		&shadowDescriptorSet,
-		1,
-		&dynamicOffset
-	);
+	descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, shadowDescriptorSet, 1, &dynamicOffset);
 
 	descriptorOffset++;
 
 	VkDescriptorSet debugDataSet = RenderUtilities::GenericHandleToDescriptorSet(pipeline->GetDebugDescriptorSet());
-	vkCmdBindDescriptorSets(
-		cmdBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipeline->GetLayout(),
-		descriptorOffset,
-		1,
-		&debugDataSet,
-		0,
-		nullptr
-	);
+	descriptorBindState.Bind(pipeline->GetLayout(), descriptorOffset, debugDataSet);
 
 	uint32_t handle[1];
 	AssetManager::Get().QueryAssets(handle, "Meshes\\Plane");
 
 	const Model* model = AssetManager::Get().LoadAsset<Model>(handle[0]);
+	if (model == nullptr || !model->IsReady())
+	{
+		return;
+	}
+
 	const MeshData& meshData = model->GetMeshData();
 	const MeshRenderData& renderData = model->GetRenderData();
 
-	VkBuffer buffer = RenderUtilities::GenericHandleToBuffer(renderData.vertex.buffer);
-	VkDeviceSize zeroOffset[] = { 0 };
-	vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, zeroOffset);
-
-	VkBuffer indexBuffer = RenderUtilities::GenericHandleToBuffer(renderData.index.buffer);
-	vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	geometryPool.BindVertexBuffers(renderData.layout, true);
 
 	for (int32_t i = 0; i < meshData.meshesCount; ++i)
 	{
-		vkCmdDrawIndexed(cmdBuffer,
-			meshData.meshIndices[i].count,
-			1,
-			meshData.offset[i],
-			0,
-			0);
+		DrawSubmesh(cmdBuffer, renderData, meshData.meshIndices[i], 0);
 	}
 }
 
@@ -2545,6 +3793,12 @@ void VulkanRendering::OnKeyPressed(uint32_t key, EKeyPressType pressType)
 		{
 			DEBUG_CASCADE_VISUALIZER = !DEBUG_CASCADE_VISUALIZER;
 		}
+		else if (key == SDLK_3)
+		{
+			// Cycles from low to ultra
+			const EShadowQuality quality = pendingShadowQuality.value_or(shadowQuality);
+			SetShadowQuality(static_cast<EShadowQuality>((static_cast<uint8_t>(quality) + 1) % (static_cast<uint8_t>(EShadowQuality::Ultra) + 1)));
+		}
 	}
 }
 
@@ -2643,6 +3897,38 @@ void VulkanRendering::TransitionImageLayout(VkCommandBuffer commandBuffer, VkIma
 	);
 }
 
+void VulkanRendering::TransitionShadowLayoutFromUndefined(VkCommandBuffer commandBuffer)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+	barrier.image = RenderUtilities::GenericHandleToImage(shadowMapData.shadowDepthTexture.image);
+
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier
+	);
+}
+
 void VulkanRendering::TransitionShadowLayoutToFragment(VkCommandBuffer commandBuffer)
 {
 	VkImageMemoryBarrier barrier = {};
@@ -2656,13 +3942,13 @@ void VulkanRendering::TransitionShadowLayoutToFragment(VkCommandBuffer commandBu
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-	barrier.image = RenderUtilities::GenericHandleToImage(shadowMapData[currentFrame].shadowDepthTexture.image);
+	barrier.image = RenderUtilities::GenericHandleToImage(shadowMapData.shadowDepthTexture.image);
 
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = 1;
 	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = MAX_SM;
+	barrier.subresourceRange.layerCount = 1;
 
 	vkCmdPipelineBarrier(
 		commandBuffer,
@@ -2688,13 +3974,13 @@ void VulkanRendering::TransitionShadowLayoutToGeometry(VkCommandBuffer commandBu
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-	barrier.image = RenderUtilities::GenericHandleToImage(shadowMapData[currentFrame].shadowDepthTexture.image);
+	barrier.image = RenderUtilities::GenericHandleToImage(shadowMapData.shadowDepthTexture.image);
 
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = 1;
 	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = MAX_SM;
+	barrier.subresourceRange.layerCount = 1;
 
 	vkCmdPipelineBarrier(
 		commandBuffer,
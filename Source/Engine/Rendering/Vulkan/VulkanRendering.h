@@ -1,11 +1,22 @@
 #pragma once
 
+#include "DescriptorBindState.h"
 #include "Frame.h"
+#include "GeometryPool.h"
+#include "GpuCulling.h"
+#include "HiZPyramid.h"
 #include "Rendering/AbstractData.h"
+#include "Rendering/Light/ClusteredLighting.h"
+#include "Rendering/Light/ShadowAtlas.h"
+#include "Rendering/Light/ShadowCascadeCache.h"
+#include "Rendering/Queue/InstanceData.h"
+#include "Rendering/Queue/RenderQueue.h"
 #include "Rendering/RenderingInterface.h"
 #include "VkContext.h"
 
 #include <array>
+#include <entt/entity/fwd.hpp>
+#include <optional>
 #include <SDL3/SDL_video.h>
 #include <string>
 #include <vector>
@@ -19,7 +30,9 @@ class RenderPipeline;
 class EditorUI;
 #endif
 
+struct Frustum;
 struct MeshData;
+struct MeshIndexData;
 struct MeshRenderData;
 
 enum class EKeyPressType : uint8_t;
@@ -48,6 +61,7 @@ struct SwapChainData
 	void Resize(uint32_t size)
 	{
 		swapChainFramebuffers.resize(size);
+		depthPrePassFramebuffers.resize(size, VK_NULL_HANDLE);
 		images.resize(size);
 		views.resize(size);
 		depths.resize(size);
@@ -55,6 +69,8 @@ struct SwapChainData
 	}
 
 	std::vector<VkFramebuffer> swapChainFramebuffers;
+	// Only the depth attachment, empty handles without the depth pre-pass
+	std::vector<VkFramebuffer> depthPrePassFramebuffers;
 
 	std::vector<VkImage> images;
 	std::vector<VkImageView> views;
@@ -63,10 +79,39 @@ struct SwapChainData
 	std::vector<AllocatedTexture> colors;
 };
 
+// Packets drawing the same submesh with the same material, drawn with a single instanced draw
+struct InstanceGroup
+{
+	const DrawPacket* packet = nullptr;
+	uint32_t firstInstance = 0;
+	uint32_t instanceCount = 0;
+	// NO_CULLED_DRAW when the group is drawn directly
+	uint32_t culledBatch = NO_CULLED_DRAW;
+};
+
+// Culled groups sharing a pipeline, a material and an index type, drawn with a single indirect draw at the first group
+struct CulledBatch
+{
+	uint32_t firstGroup = 0;
+	uint32_t firstDraw = 0;
+	uint32_t drawCount = 0;
+};
+
+// Each frame in flight owns a copy of the shadow casters' draws, aligned like the other per frame buffers
+constexpr uint32_t SHADOW_DRAW_BUFFER_FRAME_SIZE = (sizeof(VkDrawIndexedIndirectCommand) * MAX_SHADOW_DRAWS + 255) & ~255u;
+
 struct ShadowMapData
 {
 	VkFramebuffer shadowMappingFB = VK_NULL_HANDLE;
+	// A single atlas shared by the frames in flight, the layout transitions order the frames' reads and writes
 	AllocatedTexture shadowDepthTexture;
+
+	ShadowAtlas atlas;
+	std::vector<ShadowAtlasTile> cascadeTiles;
+
+	// The cascades are kept between frames
+	ShadowCascadeCache cascadeCache;
+	bool isLayoutInitialized = false;
 };
 
 class VulkanRendering : public RenderingInterface
@@ -77,6 +122,7 @@ public:
 
 	void DrawFrame() override;
 	void EndFrame() override;
+	void WaitForFramesInFlight() override;
 
 	const VkContext& GetContext() const { return context; }
 	VkCommandBuffer GetCurrentCommandBuffer() const;
@@ -88,15 +134,17 @@ public:
 
 	/// Global descriptors
 	void CreateBuffer(EBufferType bufferType, uint32_t size, AllocatedBuffer& outBuffer) override;
-	void CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cameraMatricesLayout, DescriptorSetLayoutInfo& lightLayout, DescriptorSetLayoutInfo& animationLayout, DescriptorSetLayoutInfo& shadowLayout) override;
-	void CreateDescriptorSet(const DescriptorSetLayoutInfo& layoutInfo, GenericHandle& outDescriptorSet) override;
+	void CreateGlobalDescriptorLayouts(DescriptorSetLayoutInfo& cameraMatricesLayout, DescriptorSetLayoutInfo& lightLayout, DescriptorSetLayoutInfo& animationLayout, DescriptorSetLayoutInfo& shadowLayout, DescriptorSetLayoutInfo& materialLayout) override;
+	bool CreateDescriptorSet(const DescriptorSetLayoutInfo& layoutInfo, GenericHandle& outDescriptorSet) override;
 	void UpdateDescriptorSet(EDescriptorSetType type, GenericHandle descriptorSet, AllocatedBuffer buffer, uint32_t binding = 0) override;
 	void UpdateDynamicDescriptorSet(EDescriptorSetType type, GenericHandle descriptorSet, AllocatedBuffer buffer, uint32_t binding, uint32_t offset, uint32_t range) override;
 	void DestroyDescriptorSetLayout(const DescriptorSetLayoutInfo& layoutInfo) override;
+	void UpdateBindlessTexture(GenericHandle descriptorSet, uint32_t binding, uint32_t arrayIndex, const AllocatedTexture& texture) override;
 	// *******************
 
 	// Buffer manips
 	void CreateMeshVertexBuffer(const MeshData& meshData, MeshRenderData& outRenderData) override;
+	void DestroyMeshVertexBuffer(const MeshRenderData& renderData) override;
 	void CreateTextureBuffer(const TextureData& textureData, void* pixels, TextureRenderData& renderData) override;
 
 	void UpdateBuffer(AllocatedBuffer buffer, uint32_t offset, uint32_t range, void* dataToCopy) override;
@@ -105,6 +153,11 @@ public:
 	void DestroyTexture(AllocatedTexture texture) override;
 	// ************
 
+	void SetShadowQuality(EShadowQuality quality) override;
+
+	// Descriptor set binds of the last recorded frame
+	const DescriptorBindStats& GetDescriptorBindStats() const { return descriptorBindState.GetStats(); }
+
 protected:
 	void DrawShadows(const View& view) override;
 	void DrawSingle(const View& view) override;
@@ -126,25 +179,74 @@ private:
 	bool CreateMemoryAllocator();
 	bool CreateSwapChain();
 	void CreateShadowPassImage();
+	bool CreateDepthPrePass();
 	bool CreateRenderPass();
 	void CreateShadowPass();
 	bool CreateFrameBuffers();
 	void CreateShadowMappingFB();
+	void DestroyShadowAtlas();
+	// Swaps the atlas for the pending quality's, the frames in flight keep sampling the old one until they are done
+	void ApplyPendingShadowQuality();
+	// Points the frame's shadow set to the current atlas if it still samples an old one
+	void UpdateShadowAtlasDescriptor(uint32_t frame);
+	// Gives each cascade its tile of the atlas, the far cascades get smaller tiles
+	void AllocateCascadeTiles(uint32_t cascadeCount);
 	bool CreateCommandPools();
 	bool CreateDescriptorPool();
+	// Sized like the swap chain, the culling samples it
+	bool CreateHiZPyramid();
 
 	void CreateRenderFrames();
 	void CreateRenderPipelines();
 	void SetupDebugMessenger();
 
+	static EPipelineType GetMeshPipeline(EPipelineType materialPipeline, bool isSkinned);
+	// Adds the caster's instances, one per cascade set in cascadeMask. Returns false when the instance buffer is full
+	bool AddShadowCasterInstances(const View& view, entt::entity entity, uint32_t cascadeMask);
+	// The submesh's range of the geometry pool's index buffer at the LOD, bound at 0
+	static VkDrawIndexedIndirectCommand GetSubmeshDraw(const MeshRenderData& renderData, const MeshIndexData& submesh, uint32_t lodIndex, uint32_t instanceCount, uint32_t firstInstance);
+	// The mesh's vertex buffers must be bound, the submesh's indices are found in the geometry pool's index buffer
+	void DrawSubmesh(VkCommandBuffer cmdBuffer, const MeshRenderData& renderData, const MeshIndexData& submesh, uint32_t lodIndex, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+	// Culls the submesh's meshlets on the CPU and only draws the visible ones
+	void DrawSubmeshMeshlets(VkCommandBuffer cmdBuffer, const MeshRenderData& renderData, const MeshIndexData& submesh, const glm::mat4& model, const glm::vec3& scale, const Frustum& cameraFrustum, const glm::vec3& cameraPosition, uint32_t firstInstance);
+
 	void CleanupSwapChain();
-	void CleanupPendingDestroyBuffers();
+	// Destroys what was released while the frame was the last one recorded, its fence must have been waited on
+	void CleanupPendingDestroyBuffers(uint32_t frame);
 	void RecreateSwapChain();
 
 	void RecordCommandBuffer(uint32_t imageIndex);
+	void SelectLods(const View& view);
+	// Uploads the bones of the animated entities, each one gets a slot in the animation buffer for this frame
+	void GatherBonePalettes(const View& view);
+	// Bins the lights into the camera's clusters and uploads them for the current frame
+	void BuildLightClusters(const View& view);
 	void ShadowRenderPass(const View& view);
 	void DebugShadowPass(uint32_t imageIndex, const View& view);
+	void DepthPrePass(uint32_t imageIndex, const View& view);
+	// The main pass' groups with the depth only pipelines, the color pass then shades the fragments with an EQUAL depth
+	void DrawDepthPrePass(const View& view);
 	void DrawRenderPass(uint32_t imageIndex, const View& view);
+	// The main pass' viewport, flipped so y points up
+	void SetMainViewport(VkCommandBuffer cmdBuffer);
+	// The group's pipeline, descriptor sets and vertex buffers must be bound
+	void DrawInstanceGroup(VkCommandBuffer cmdBuffer, const View& view, const InstanceGroup& group, const Frustum& cameraFrustum);
+	// One packet per submesh of the entities the main pass draws, sorted by pipeline, material and mesh
+	void BuildRenderQueue(const View& view);
+	// Groups the sorted packets sharing a submesh and a material and uploads their instances
+	void BuildInstanceGroups(const View& view);
+	// Adds the group to the culled draws and to its batch. Returns the batch or NO_CULLED_DRAW when full
+	uint32_t AddCulledDraw(uint32_t groupIndex, std::array<uint32_t, 2>& openBatches);
+	// Records the GPU culling of the main pass' instances, outside of the render passes
+	void CullInstances(const View& view);
+	// Compares the instances the frame's last culling kept with the CPU culled view, the frame's fence must have been waited on
+	void CompareGpuCulling(uint32_t frame);
+	// The GPU culling is on and the device has the indirect draw features it needs
+	bool IsGpuCulling() const;
+	// Meshlet culled submeshes are drawn one entity at a time
+	static bool IsCulledPerMeshlet(const DrawPacket& packet);
+	// Binds the camera, light, shadow, animation and material sets the pipeline uses
+	void BindGlobalDescriptorSets(RenderPipeline* pipeline);
 
 	void DrawShadowDebugQuad(const View& view);
 
@@ -169,6 +271,7 @@ private:
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 	void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
+	void TransitionShadowLayoutFromUndefined(VkCommandBuffer commandBuffer);
 	void TransitionShadowLayoutToFragment(VkCommandBuffer commandBuffer);
 	void TransitionShadowLayoutToGeometry(VkCommandBuffer commandBuffer);
 
@@ -199,21 +302,70 @@ private:
 	SwapChainData swapChainData;
 
 	uint32_t currentFrame = 0;
+	// The last frame whose fence was waited on, the resources released from then on can be used by it
+	uint32_t releaseFrame = 0;
 
 	// Shadows
-	std::array<ShadowMapData, MAX_FRAMES_IN_FLIGHT> shadowMapData;
+	ShadowMapData shadowMapData;
+	// Applied at the start of the next frame
+	std::optional<EShadowQuality> pendingShadowQuality;
+	// One bit per frame whose shadow set wasn't written since the atlas was created
+	uint32_t staleShadowDescriptors = 0;
 
 	// Need to track the shadow image since it will transfered between layouts to be sampled
 	VkImageLayout currentShadowImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	// *******
 
+	ClusteredLighting clusteredLighting;
+	// Draws of the main pass, rebuilt each frame
+	RenderQueue renderQueue;
+	// Descriptor sets bound on the frame's command buffer
+	DescriptorBindState descriptorBindState;
+	// Vertices and indices of every mesh, bound once per vertex layout instead of once per model
+	GeometryPool geometryPool;
+	GpuCulling gpuCulling;
+	// Built from the main pass' depth at the end of the frame, tested by the next frame's culling
+	HiZPyramid hiZPyramid;
+	glm::mat4 hiZViewProjection = glm::mat4(1.0f);
+
 	std::unordered_map<EPipelineType, RenderPipeline*> renderPipelines;
 
 	std::vector<Frame> renderFrames;
 	std::array<VkFramebuffer, MAX_FRAMES_IN_FLIGHT> additiveFrameBuffers;
 
-	std::vector<AllocatedBuffer> buffersPendingDelete;
-	std::vector<AllocatedTexture> imagesPendingDelete;
+	// Scratch for the meshlet culling, kept to avoid allocating each draw
+	std::vector<uint8_t> meshletVisibility;
+	// Scratch for the shadow casters' culling, one bit per cascade the caster overlaps
+	std::vector<uint32_t> casterCascadeMasks;
+	std::vector<uint8_t> cascadeVisibility;
+	std::vector<uint64_t> casterSignatures;
+	std::vector<uint32_t> casterFirstInstances;
+
+	// Draws of the shadow casters, written by the CPU each frame
+	std::vector<VkDrawIndexedIndirectCommand> shadowDraws;
+	AllocatedBuffer shadowDrawBuffer;
+
+	// Slot of each animated entity's bones in the animation buffer, rebuilt each frame
+	std::unordered_map<entt::entity, uint32_t> bonePalettes;
+
+	// Scratch for the main pass instancing, the shadow casters' instances follow the main pass' ones
+	std::vector<InstanceLayout> instances;
+	std::vector<InstanceGroup> instanceGroups;
+	std::vector<const DrawPacket*> instanceRun;
+	std::vector<uint32_t> visibleInstances;
+
+	// Groups of the main pass culled on the GPU, rebuilt each frame
+	std::vector<CulledDrawLayout> culledDraws;
+	std::vector<CulledBatch> culledBatches;
+	// Instances of the culled draws inside the CPU culled view, sorted. The CPU reference of the GPU culling's result
+	std::array<std::vector<uint32_t>, MAX_FRAMES_IN_FLIGHT> cpuVisibleInstances;
+	std::vector<uint32_t> gpuVisibleInstances;
+
+	// By the frame that was recording when they were released
+	std::array<std::vector<AllocatedBuffer>, MAX_FRAMES_IN_FLIGHT> buffersPendingDelete;
+	std::array<std::vector<AllocatedTexture>, MAX_FRAMES_IN_FLIGHT> imagesPendingDelete;
+	std::array<std::vector<MeshRenderData>, MAX_FRAMES_IN_FLIGHT> meshesPendingDelete;
+	std::array<std::vector<VkFramebuffer>, MAX_FRAMES_IN_FLIGHT> framebuffersPendingDelete;
 
 	std::vector<const char*> instanceExtensions =
 	{
@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool instance;
+	return instance;
+}
+
+ThreadPool::ThreadPool()
+{
+	// The main thread participates in ParallelFor so one core is left for it
+	const uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+	const uint32_t workerCount = hardwareThreads - 1;
+
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		isRunning = false;
+	}
+	jobsCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+}
+
+void ThreadPool::Submit(std::function<void()>&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		jobs.emplace_back(std::move(job));
+	}
+	jobsCondition.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (count == 1 || workers.empty())
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			func(i);
+		}
+		return;
+	}
+
+	struct ParallelForState
+	{
+		std::atomic<uint32_t> next = 0;
+		std::atomic<uint32_t> done = 0;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+
+	std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+
+	// func is only touched while done < count, which means the caller is still waiting on it
+	auto drain = [state, count, &func]()
+		{
+			uint32_t index = state->next.fetch_add(1);
+			while (index < count)
+			{
+				func(index);
+				if (state->done.fetch_add(1) + 1 == count)
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->condition.notify_all();
+				}
+				index = state->next.fetch_add(1);
+			}
+		};
+
+	const uint32_t helpers = std::min(count - 1, GetWorkerCount());
+	for (uint32_t i = 0; i < helpers; ++i)
+	{
+		Submit(drain);
+	}
+
+	drain();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->condition.wait(lock, [&state, count]()
+		{
+			return state->done.load() == count;
+		});
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobsCondition.wait(lock, [this]()
+				{
+					return !isRunning || !jobs.empty();
+				});
+
+			if (!isRunning && jobs.empty())
+			{
+				return;
+			}
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
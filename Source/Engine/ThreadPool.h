@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Worker threads for CPU heavy jobs (decompression, culling, etc.). Unlike the TaskManager which runs
+/// registered functions on the main thread, jobs submitted here run on any worker and must not touch
+/// main thread only state (Vulkan command buffers, ECS registry writes, etc.).
+/// </summary>
+class ThreadPool
+{
+public:
+	static ThreadPool& Get();
+
+	~ThreadPool();
+
+	void Submit(std::function<void()>&& job);
+
+	/**
+	 * Runs func(i) for every i in [0, count) spread across the workers. The calling thread also executes
+	 * jobs so this is safe to call from a worker. Returns when every index has been processed.
+	 */
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	ThreadPool();
+
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+
+	std::mutex jobsMutex;
+	std::condition_variable jobsCondition;
+
+	bool isRunning = true;
+};
@@ -0,0 +1,420 @@
+#include "AsyncFileIO.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if WITH_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Blocking reads in flight at the same time when io_uring isn't available
+constexpr uint32_t IO_WORKER_COUNT = 4;
+
+#if WITH_IO_URING
+// Max requests submitted to the ring at once
+constexpr uint32_t IO_QUEUE_DEPTH = 256;
+// The ring's reads take a 32 bit size, larger requests are read in several parts
+constexpr uint64_t MAX_RING_READ_SIZE = 1ull << 30;
+#endif
+
+AsyncFileIO& AsyncFileIO::Get()
+{
+	static AsyncFileIO instance;
+	return instance;
+}
+
+AsyncFileIO::AsyncFileIO()
+{
+#if WITH_IO_URING
+	if (io_uring_queue_init(IO_QUEUE_DEPTH, &ring, 0) == 0)
+	{
+		isRingInitialized = true;
+		workers.emplace_back(&AsyncFileIO::RingLoop, this);
+		return;
+	}
+
+	std::cerr << "Failed to initialize io_uring, falling back to blocking I/O threads!" << std::endl;
+#endif
+
+	for (uint32_t i = 0; i < IO_WORKER_COUNT; ++i)
+	{
+		workers.emplace_back(&AsyncFileIO::WorkerLoop, this);
+	}
+}
+
+AsyncFileIO::~AsyncFileIO()
+{
+	{
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		isRunning = false;
+	}
+	requestsCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+#if WITH_IO_URING
+	if (isRingInitialized)
+	{
+		io_uring_queue_exit(&ring);
+	}
+#endif
+}
+
+bool AsyncFileIO::IsUsingIOUring() const
+{
+#if WITH_IO_URING
+	return isRingInitialized;
+#else
+	return false;
+#endif
+}
+
+IORequestHandle AsyncFileIO::Submit(IORequest&& request)
+{
+	const IORequestHandle handle = Enqueue(std::move(request))->handle;
+	requestsCondition.notify_one();
+	return handle;
+}
+
+void AsyncFileIO::SubmitBatch(std::vector<IORequest>&& requests, std::vector<IORequestHandle>& outHandles)
+{
+	outHandles.reserve(outHandles.size() + requests.size());
+	for (IORequest& request : requests)
+	{
+		outHandles.push_back(Enqueue(std::move(request))->handle);
+	}
+
+	// Wake everyone once so the whole batch is picked up together
+	requestsCondition.notify_all();
+}
+
+EIOStatus AsyncFileIO::Read(IORequest&& request, uint64_t* outBytesRead)
+{
+	std::shared_ptr<RequestState> state = Enqueue(std::move(request));
+	requestsCondition.notify_one();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->condition.wait(lock, [&state]()
+		{
+			return state->isDone;
+		});
+
+	if (outBytesRead != nullptr)
+	{
+		*outBytesRead = state->bytesRead;
+	}
+
+	return state->status.load();
+}
+
+bool AsyncFileIO::Cancel(IORequestHandle handle)
+{
+	std::shared_ptr<RequestState> state;
+	{
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		auto it = requests.find(handle);
+		if (it == requests.end())
+		{
+			return false;
+		}
+		state = it->second;
+	}
+
+	state->isCancelled = true;
+
+	// Pending requests are completed here, the I/O threads skip them when they reach the front of the queue
+	EIOStatus expected = EIOStatus::Pending;
+	if (state->status.compare_exchange_strong(expected, EIOStatus::Cancelled))
+	{
+		Complete(state, EIOStatus::Cancelled);
+	}
+
+	return true;
+}
+
+void AsyncFileIO::DispatchCompletions()
+{
+	std::vector<std::shared_ptr<RequestState>> completed;
+	{
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		completed.swap(completedRequests);
+
+		for (const std::shared_ptr<RequestState>& state : completed)
+		{
+			requests.erase(state->handle);
+		}
+	}
+
+	for (const std::shared_ptr<RequestState>& state : completed)
+	{
+		IOResult result{};
+		result.handle = state->handle;
+		result.status = state->status.load();
+		result.data = state->GetDestination();
+		result.size = state->bytesRead;
+
+		state->request.callback(result);
+	}
+}
+
+std::shared_ptr<AsyncFileIO::RequestState> AsyncFileIO::Enqueue(IORequest&& request)
+{
+	std::shared_ptr<RequestState> state = std::make_shared<RequestState>();
+	state->request = std::move(request);
+
+	std::lock_guard<std::mutex> lock(requestsMutex);
+	state->handle = nextHandle++;
+	requests.emplace(state->handle, state);
+	pendingQueues[static_cast<size_t>(state->request.priority)].push_back(state);
+	outstandingCount++;
+
+	return state;
+}
+
+std::shared_ptr<AsyncFileIO::RequestState> AsyncFileIO::PopNextRequest(bool shouldWait)
+{
+	std::unique_lock<std::mutex> lock(requestsMutex);
+
+	while (true)
+	{
+		for (std::deque<std::shared_ptr<RequestState>>& queue : pendingQueues)
+		{
+			while (!queue.empty())
+			{
+				std::shared_ptr<RequestState> state = queue.front();
+				queue.pop_front();
+
+				// Cancelled while waiting in the queue, already completed by Cancel
+				EIOStatus expected = EIOStatus::Pending;
+				if (state->status.compare_exchange_strong(expected, EIOStatus::InFlight))
+				{
+					return state;
+				}
+			}
+		}
+
+		if (!shouldWait || !isRunning)
+		{
+			return nullptr;
+		}
+
+		requestsCondition.wait(lock);
+	}
+}
+
+bool AsyncFileIO::PrepareRequest(RequestState& state)
+{
+	IORequest& request = state.request;
+
+	if (request.size == 0)
+	{
+		std::error_code error;
+		const uint64_t fileSize = std::filesystem::file_size(request.path, error);
+		if (error || fileSize < request.offset)
+		{
+			std::cerr << "Failed to get the size of " << request.path << "!" << std::endl;
+			return false;
+		}
+		request.size = fileSize - request.offset;
+	}
+
+	if (request.destination == nullptr)
+	{
+		state.ownedBuffer.resize(request.size);
+	}
+
+	return true;
+}
+
+void AsyncFileIO::Complete(const std::shared_ptr<RequestState>& state, EIOStatus status)
+{
+	// In flight requests can't be interrupted, they are only reported as cancelled
+	if (state->isCancelled)
+	{
+		status = EIOStatus::Cancelled;
+	}
+
+	state->status = status;
+
+	{
+		std::lock_guard<std::mutex> lock(requestsMutex);
+		if (state->request.callback)
+		{
+			completedRequests.push_back(state);
+		}
+		else
+		{
+			requests.erase(state->handle);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->isDone = true;
+	}
+	state->condition.notify_all();
+
+	outstandingCount--;
+}
+
+void AsyncFileIO::WorkerLoop()
+{
+	while (std::shared_ptr<RequestState> state = PopNextRequest(true))
+	{
+		if (!PrepareRequest(*state))
+		{
+			Complete(state, EIOStatus::Failed);
+			continue;
+		}
+
+		const IORequest& request = state->request;
+
+		std::ifstream file(request.path, std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cerr << "Failed to open " << request.path << "!" << std::endl;
+			Complete(state, EIOStatus::Failed);
+			continue;
+		}
+
+		file.seekg(request.offset);
+		file.read(reinterpret_cast<char*>(state->GetDestination()), request.size);
+		state->bytesRead = file.gcount();
+
+		Complete(state, state->bytesRead == request.size ? EIOStatus::Completed : EIOStatus::Failed);
+	}
+}
+
+#if WITH_IO_URING
+void AsyncFileIO::RingLoop()
+{
+	struct RingRequest
+	{
+		std::shared_ptr<RequestState> state;
+		int32_t fileDescriptor = -1;
+	};
+
+	std::unordered_map<RequestState*, RingRequest> inFlight;
+
+	// Reads what's left of the request, a read can return less than it was asked for
+	auto prepareRead = [this](const RingRequest& ringRequest)
+		{
+			RequestState& state = *ringRequest.state;
+			const uint64_t remaining = state.request.size - state.bytesRead;
+
+			io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+			io_uring_prep_read(sqe, ringRequest.fileDescriptor, state.GetDestination() + state.bytesRead,
+				static_cast<uint32_t>(std::min(remaining, MAX_RING_READ_SIZE)), state.request.offset + state.bytesRead);
+			io_uring_sqe_set_data(sqe, &state);
+		};
+
+	while (true)
+	{
+		// Fill the submission queue with as many requests as possible, highest priority first
+		uint32_t prepared = 0;
+		while (inFlight.size() < IO_QUEUE_DEPTH)
+		{
+			std::shared_ptr<RequestState> state = PopNextRequest(inFlight.empty());
+			if (state == nullptr)
+			{
+				break;
+			}
+
+			if (!PrepareRequest(*state))
+			{
+				Complete(state, EIOStatus::Failed);
+				continue;
+			}
+
+			const int32_t fileDescriptor = open(state->request.path.c_str(), O_RDONLY);
+			if (fileDescriptor < 0)
+			{
+				std::cerr << "Failed to open " << state->request.path << "!" << std::endl;
+				Complete(state, EIOStatus::Failed);
+				continue;
+			}
+
+			if (state->request.size == 0)
+			{
+				close(fileDescriptor);
+				Complete(state, EIOStatus::Completed);
+				continue;
+			}
+
+			const RingRequest& ringRequest = inFlight.emplace(state.get(), RingRequest{ state, fileDescriptor }).first->second;
+			prepareRead(ringRequest);
+			prepared++;
+		}
+
+		if (prepared > 0)
+		{
+			io_uring_submit(&ring);
+		}
+
+		if (inFlight.empty())
+		{
+			std::lock_guard<std::mutex> lock(requestsMutex);
+			if (!isRunning)
+			{
+				return;
+			}
+			continue;
+		}
+
+		// Short timeout so new high priority requests don't wait for a slow read to finish
+		__kernel_timespec timeout{ 0, 1000000 };
+		io_uring_cqe* cqe = nullptr;
+		if (io_uring_wait_cqe_timeout(&ring, &cqe, &timeout) != 0)
+		{
+			continue;
+		}
+
+		uint32_t head = 0;
+		uint32_t reaped = 0;
+		uint32_t resubmitted = 0;
+		io_uring_for_each_cqe(&ring, head, cqe)
+		{
+			auto it = inFlight.find(static_cast<RequestState*>(io_uring_cqe_get_data(cqe)));
+			if (it != inFlight.end())
+			{
+				RequestState& state = *it->second.state;
+				if (cqe->res > 0)
+				{
+					state.bytesRead += static_cast<uint64_t>(cqe->res);
+				}
+
+				// Short reads continue where they stopped, only an error or the end of the file fails the request
+				if (cqe->res > 0 && state.bytesRead < state.request.size)
+				{
+					prepareRead(it->second);
+					resubmitted++;
+				}
+				else
+				{
+					RingRequest ringRequest = std::move(it->second);
+					inFlight.erase(it);
+					close(ringRequest.fileDescriptor);
+
+					Complete(ringRequest.state, state.bytesRead == state.request.size ? EIOStatus::Completed : EIOStatus::Failed);
+				}
+			}
+			reaped++;
+		}
+		io_uring_cq_advance(&ring, reaped);
+
+		if (resubmitted > 0)
+		{
+			io_uring_submit(&ring);
+		}
+	}
+}
+#endif
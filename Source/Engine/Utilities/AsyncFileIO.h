@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if WITH_IO_URING
+#include <liburing.h>
+#endif
+
+using IORequestHandle = uint64_t;
+constexpr IORequestHandle INVALID_IO_REQUEST = 0;
+
+enum class EIOPriority : uint8_t
+{
+	High,
+	Normal,
+	Low,
+	Count
+};
+
+enum class EIOStatus : uint8_t
+{
+	Pending,
+	InFlight,
+	Completed,
+	Failed,
+	Cancelled
+};
+
+struct IOResult
+{
+	IORequestHandle handle = INVALID_IO_REQUEST;
+	EIOStatus status = EIOStatus::Pending;
+	// Either the caller's destination or a buffer owned by the request, only valid inside the callback
+	uint8_t* data = nullptr;
+	uint64_t size = 0;
+};
+
+using IOCallback = std::function<void(const IOResult&)>;
+
+struct IORequest
+{
+	std::string path;
+	uint64_t offset = 0;
+	// 0 reads everything from the offset to the end of the file
+	uint64_t size = 0;
+	// Caller provided memory (staging buffers, pack chunks, etc.), when null the request allocates its own buffer
+	void* destination = nullptr;
+	EIOPriority priority = EIOPriority::Normal;
+	// Invoked on the main thread from DispatchCompletions
+	IOCallback callback;
+};
+
+/// <summary>
+/// Asynchronous reads with priorities and cancellation. On Linux the requests are batched through io_uring
+/// when the engine is built with liburing, everywhere else a small pool of blocking I/O threads is used.
+/// The I/O threads are separate from the ThreadPool so slow disks never block CPU jobs.
+/// </summary>
+class AsyncFileIO
+{
+public:
+	static AsyncFileIO& Get();
+
+	~AsyncFileIO();
+
+	IORequestHandle Submit(IORequest&& request);
+	void SubmitBatch(std::vector<IORequest>&& requests, std::vector<IORequestHandle>& outHandles);
+
+	/**
+	 * Pending requests are dropped before they touch the disk. Requests already in flight still finish
+	 * but are reported as cancelled and their data must not be used.
+	 */
+	bool Cancel(IORequestHandle handle);
+
+	/**
+	 * Blocking read that still goes through the queue, so it is batched with the other outstanding requests.
+	 * Safe to call from worker threads, the callback (if any) is still dispatched on the main thread.
+	 */
+	EIOStatus Read(IORequest&& request, uint64_t* outBytesRead = nullptr);
+
+	// Called once per frame by the engine
+	void DispatchCompletions();
+
+	uint32_t GetOutstandingCount() const { return outstandingCount.load(); }
+	bool IsUsingIOUring() const;
+
+private:
+	struct RequestState
+	{
+		IORequestHandle handle = INVALID_IO_REQUEST;
+		IORequest request;
+		std::vector<uint8_t> ownedBuffer;
+
+		std::atomic<EIOStatus> status = EIOStatus::Pending;
+		std::atomic<bool> isCancelled = false;
+		uint64_t bytesRead = 0;
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool isDone = false;
+
+		uint8_t* GetDestination() { return request.destination != nullptr ? static_cast<uint8_t*>(request.destination) : ownedBuffer.data(); }
+	};
+
+	AsyncFileIO();
+
+	std::shared_ptr<RequestState> Enqueue(IORequest&& request);
+	std::shared_ptr<RequestState> PopNextRequest(bool shouldWait);
+	bool PrepareRequest(RequestState& state);
+	void Complete(const std::shared_ptr<RequestState>& state, EIOStatus status);
+
+	void WorkerLoop();
+
+#if WITH_IO_URING
+	void RingLoop();
+
+	io_uring ring{};
+	bool isRingInitialized = false;
+#endif
+
+	std::vector<std::thread> workers;
+
+	std::array<std::deque<std::shared_ptr<RequestState>>, static_cast<size_t>(EIOPriority::Count)> pendingQueues;
+	std::unordered_map<IORequestHandle, std::shared_ptr<RequestState>> requests;
+	std::vector<std::shared_ptr<RequestState>> completedRequests;
+
+	std::mutex requestsMutex;
+	std::condition_variable requestsCondition;
+
+	std::atomic<uint32_t> outstandingCount = 0;
+	IORequestHandle nextHandle = 1;
+	bool isRunning = true;
+};
@@ -1,5 +1,6 @@
 #include "FileHelper.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
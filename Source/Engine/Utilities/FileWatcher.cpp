@@ -0,0 +1,185 @@
+#include "FileWatcher.h"
+
+#include <chrono>
+#include <iostream>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How long the watch thread sleeps between checks, also bounds how long Stop waits
+constexpr int32_t WATCH_INTERVAL_MS = 250;
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+bool FileWatcher::Start(const std::string& inDirectory)
+{
+	if (isRunning)
+	{
+		return false;
+	}
+
+	std::error_code error;
+	if (!std::filesystem::is_directory(inDirectory, error))
+	{
+		return false;
+	}
+
+	directory = inDirectory;
+
+#if defined(__linux__)
+	inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyDescriptor < 0)
+	{
+		std::cerr << "Failed to initialize inotify for " << directory << "!" << std::endl;
+		return false;
+	}
+
+	// inotify isn't recursive so every sub folder needs its own watch
+	AddWatch(directory);
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+	{
+		if (entry.is_directory())
+		{
+			AddWatch(entry.path().string());
+		}
+	}
+#else
+	ScanModifiedFiles(false);
+#endif
+
+	isRunning = true;
+	watchThread = std::thread(&FileWatcher::WatchLoop, this);
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (!isRunning)
+	{
+		return;
+	}
+
+	isRunning = false;
+	if (watchThread.joinable())
+	{
+		watchThread.join();
+	}
+
+#if defined(__linux__)
+	close(inotifyDescriptor);
+	inotifyDescriptor = -1;
+	watchedDirectories.clear();
+#endif
+}
+
+void FileWatcher::PollChanges(std::vector<std::string>& outChangedFiles)
+{
+	std::lock_guard<std::mutex> lock(changesMutex);
+	outChangedFiles.insert(outChangedFiles.end(), changedFiles.begin(), changedFiles.end());
+	changedFiles.clear();
+}
+
+void FileWatcher::PushChange(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(changesMutex);
+	changedFiles.insert(path);
+}
+
+#if defined(__linux__)
+void FileWatcher::AddWatch(const std::string& path)
+{
+	const int32_t watch = inotify_add_watch(inotifyDescriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (watch < 0)
+	{
+		std::cerr << "Failed to watch " << path << "!" << std::endl;
+		return;
+	}
+
+	watchedDirectories[watch] = path;
+}
+
+void FileWatcher::WatchLoop()
+{
+	alignas(inotify_event) char buffer[4096];
+
+	while (isRunning)
+	{
+		pollfd descriptor{ inotifyDescriptor, POLLIN, 0 };
+		if (poll(&descriptor, 1, WATCH_INTERVAL_MS) <= 0)
+		{
+			continue;
+		}
+
+		const ssize_t length = read(inotifyDescriptor, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			auto it = watchedDirectories.find(event->wd);
+			if (it == watchedDirectories.end() || event->len == 0)
+			{
+				continue;
+			}
+
+			const std::string path = (std::filesystem::path(it->second) / event->name).string();
+
+			if ((event->mask & IN_ISDIR) != 0)
+			{
+				// New folders need to be watched as well
+				if ((event->mask & IN_CREATE) != 0)
+				{
+					AddWatch(path);
+				}
+				continue;
+			}
+
+			// IN_CREATE is followed by IN_CLOSE_WRITE once the file is fully written
+			if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0)
+			{
+				PushChange(path);
+			}
+		}
+	}
+}
+#else
+void FileWatcher::ScanModifiedFiles(bool shouldReport)
+{
+	std::error_code error;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+	{
+		if (!entry.is_regular_file())
+		{
+			continue;
+		}
+
+		const std::string path = entry.path().string();
+		const std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+
+		auto it = fileTimes.find(path);
+		if (it == fileTimes.end() || it->second != writeTime)
+		{
+			fileTimes[path] = writeTime;
+			if (shouldReport)
+			{
+				PushChange(path);
+			}
+		}
+	}
+}
+
+void FileWatcher::WatchLoop()
+{
+	while (isRunning)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+		ScanModifiedFiles(true);
+	}
+}
+#endif
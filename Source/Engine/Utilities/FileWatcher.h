@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// <summary>
+/// Watches a directory tree and reports the files that were written. Uses inotify on Linux, other
+/// platforms poll the modification times which is fine since it's only meant for development.
+/// </summary>
+class FileWatcher
+{
+public:
+	~FileWatcher();
+
+	bool Start(const std::string& inDirectory);
+	void Stop();
+
+	// Files written since the last call, each path is reported once even if it was saved multiple times
+	void PollChanges(std::vector<std::string>& outChangedFiles);
+
+	const std::string& GetDirectory() const { return directory; }
+
+private:
+	void WatchLoop();
+	void PushChange(const std::string& path);
+
+#if defined(__linux__)
+	void AddWatch(const std::string& path);
+
+	int32_t inotifyDescriptor = -1;
+	std::unordered_map<int32_t, std::string> watchedDirectories;
+#else
+	void ScanModifiedFiles(bool shouldReport);
+
+	std::unordered_map<std::string, std::filesystem::file_time_type> fileTimes;
+#endif
+
+	std::string directory;
+	std::thread watchThread;
+	std::atomic<bool> isRunning = false;
+
+	std::mutex changesMutex;
+	std::unordered_set<std::string> changedFiles;
+};
@@ -8,13 +8,21 @@
 
 bool ImageImporter::ImportTexture(const std::string& path, TextureData& outData, TextureRenderData& outTextureRenderData)
 {
-	int32_t& width = outData.width;
-	int32_t& height = outData.height;
-	int32_t& channels = outData.channels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &outData.width, &outData.height, &outData.channels, STBI_rgb_alpha);
+	return CreateTexture(pixels, outData, outTextureRenderData);
+}
 
-	if (stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha))
+bool ImageImporter::ImportTexture(const std::vector<uint8_t>& fileData, TextureData& outData, TextureRenderData& outTextureRenderData)
+{
+	stbi_uc* pixels = stbi_load_from_memory(fileData.data(), static_cast<int32_t>(fileData.size()), &outData.width, &outData.height, &outData.channels, STBI_rgb_alpha);
+	return CreateTexture(pixels, outData, outTextureRenderData);
+}
+
+bool ImageImporter::CreateTexture(uint8_t* pixels, TextureData& outData, TextureRenderData& outTextureRenderData)
+{
+	if (pixels != nullptr)
 	{
-		outData.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+		outData.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(outData.width, outData.height)))) + 1;
 		RenderingInterface* renderingInterface = GameEngine->GetRenderingSystem();
 		renderingInterface->CreateTextureBuffer(outData, pixels, outTextureRenderData);
 		return true;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 struct TextureData;
 struct TextureRenderData;
@@ -9,4 +11,8 @@ class ImageImporter
 {
 public:
 	static bool ImportTexture(const std::string& path, TextureData& outData, TextureRenderData& outTextureRenderData);
+	static bool ImportTexture(const std::vector<uint8_t>& fileData, TextureData& outData, TextureRenderData& outTextureRenderData);
+
+private:
+	static bool CreateTexture(uint8_t* pixels, TextureData& outData, TextureRenderData& outTextureRenderData);
 };
\ No newline at end of file
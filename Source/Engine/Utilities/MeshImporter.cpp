@@ -5,8 +5,10 @@
 #include "Engine.h"
 #include "EngineName.h"
 #include "ECS/Systems/MaterialSystem.h"
+#include "MeshOptimization.h"
 #include "Rendering/RenderingInterface.h"
 
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
@@ -89,6 +91,12 @@ namespace Utilities
 
 			if (!skeletonData.boneInfoMap.contains(boneName))
 			{
+				if (skeletonData.boneInfoCount >= MAX_BONES)
+				{
+					std::cerr << "Failed to add bone " << mesh->mBones[boneIndex]->mName.C_Str() << " to the skeleton, it has more than " << MAX_BONES << " bones!" << std::endl;
+					continue;
+				}
+
 				BoneInfo newBone{};
 				newBone.id = skeletonData.boneInfoCount++;
 				newBone.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[boneIndex]->mOffsetMatrix);
@@ -159,7 +167,7 @@ namespace Utilities
 		}
 	}
 
-	void ProcessMesh(aiMesh* assimpMesh, MeshData& outMeshData, size_t vertexOffset, size_t& globalIndexOffset)
+	void ProcessMesh(aiMesh* assimpMesh, MeshData& outMeshData, size_t vertexOffset)
 	{
 		for (size_t i = 0; i < assimpMesh->mNumVertices; i++)
 		{
@@ -200,6 +208,8 @@ namespace Utilities
 		}
 
 		MeshIndexData meshIndexData{};
+		meshIndexData.vertexOffset = static_cast<int32_t>(vertexOffset);
+		meshIndexData.vertexCount = assimpMesh->mNumVertices;
 
 		for (unsigned int i = 0; i < assimpMesh->mNumFaces; i++)
 		{
@@ -207,16 +217,20 @@ namespace Utilities
 
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 			{
-				meshIndexData.indices.push_back(face.mIndices[j] + static_cast<uint32_t>(vertexOffset));
+				meshIndexData.indices.push_back(face.mIndices[j]);
 				meshIndexData.count++;
 			}
 		}
 
 		outMeshData.meshIndices.push_back(meshIndexData);
 		outMeshData.indicesCount += meshIndexData.count;
-		globalIndexOffset += meshIndexData.count;
 
 
+		if (assimpMesh->HasBones())
+		{
+			outMeshData.isSkinned = true;
+		}
+
 		std::unordered_map<EngineName, uint32_t> bonesMap;
 		uint32_t boneCount = 0;
 		for (int32_t boneIndex = 0; boneIndex < assimpMesh->mNumBones; ++boneIndex)
@@ -229,6 +243,13 @@ namespace Utilities
 			auto it = bonesMap.find(eBoneName);
 			if (it == bonesMap.end())
 			{
+				// The skinning shaders only hold MAX_BONES transforms and the vertices store the ids on 8 bits
+				if (boneCount >= static_cast<uint32_t>(MAX_BONES))
+				{
+					std::cerr << "Failed to import bone " << boneName << ", the mesh has more than " << MAX_BONES << " bones!" << std::endl;
+					continue;
+				}
+
 				boneID = boneCount++;
 				bonesMap.emplace(boneName, boneID);
 			}
@@ -242,7 +263,8 @@ namespace Utilities
 
 			for (int32_t weightIndex = 0; weightIndex < numWeights; ++weightIndex)
 			{
-				int32_t vertexId = weights[weightIndex].mVertexId;
+				// The weights index the assimp mesh, not the merged vertex array
+				const size_t vertexId = vertexOffset + weights[weightIndex].mVertexId;
 				float weight = weights[weightIndex].mWeight;
 
 				for (int32_t i = 0; i < MAX_BONE_INFLUENCE; ++i)
@@ -258,56 +280,64 @@ namespace Utilities
 		}
 	}
 
-	void ProcessNodeForModel(aiNode* node, const aiScene* scene, MeshData& meshData, size_t& globalVertexOffset, size_t& globalIndexOffset)
+	void ProcessNodeForModel(aiNode* node, const aiScene* scene, const std::vector<Material>& sceneMaterials, MeshData& meshData, size_t& globalVertexOffset)
 	{
 		for (size_t i = 0; i < node->mNumMeshes; ++i)
 		{
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 			meshData.verticesCount += mesh->mNumVertices;
-			meshData.offset.push_back(globalIndexOffset);
 			meshData.meshesCount++;
 
-			ProcessMesh(mesh, meshData, globalVertexOffset, globalIndexOffset);
+			ProcessMesh(mesh, meshData, globalVertexOffset);
 
-			/*
-			* Supporting materials from the mesh is very frustrating especially when a lot of people don't
-			* properly set the materials. So each mesh will have the base engine textures.
-			*/
-			if (scene->HasMaterials())
-			{
-				for (int32_t i = 0; i < scene->mNumMaterials; ++i)
-				{
-					meshData.materials.push_back(GameEngine->GetRenderingSystem()->GetMaterialSystem()->CreatePBRMaterial(std::nullopt, true));
-				}
-			}
+			// The submeshes are indexed like the materials, each one gets the material of its source material
+			const size_t materialIndex = std::min<size_t>(mesh->mMaterialIndex, sceneMaterials.size() - 1);
+			meshData.materials.push_back(sceneMaterials[materialIndex]);
 
-			globalVertexOffset += meshData.verticesCount;
+			globalVertexOffset += mesh->mNumVertices;
 		}
 
 		for (size_t i = 0; i < node->mNumChildren; ++i)
 		{
-			ProcessNodeForModel(node->mChildren[i], scene, meshData, globalVertexOffset, globalIndexOffset);
+			ProcessNodeForModel(node->mChildren[i], scene, sceneMaterials, meshData, globalVertexOffset);
 		}
 	}
 
 	void ProcessNodeForModel(aiNode* node, const aiScene* scene, MeshData& meshData)
 	{
 		size_t globalVertexOffset = 0;
-		size_t globalIndexOffset = 0;
 
-		ProcessNodeForModel(node, scene, meshData, globalVertexOffset, globalIndexOffset);
+		/*
+		* Supporting materials from the mesh is very frustrating especially when a lot of people don't
+		* properly set the materials. So each source material gets the base engine textures, the identical
+		* materials are shared through their material key, across models too.
+		*/
+		MaterialSystem* materialSystem = GameEngine->GetRenderingSystem()->GetMaterialSystem();
+		std::vector<Material> sceneMaterials(std::max(scene->mNumMaterials, 1u));
+		for (Material& material : sceneMaterials)
+		{
+			material = materialSystem->CreatePBRMaterial();
+		}
+
+		ProcessNodeForModel(node, scene, sceneMaterials, meshData, globalVertexOffset);
 	}
 }
 
+constexpr uint32_t MODEL_IMPORT_FLAGS = aiProcess_Triangulate
+	| aiProcess_JoinIdenticalVertices
+	| aiProcess_GenSmoothNormals
+	| aiProcess_FlipUVs
+	| aiProcess_CalcTangentSpace
+	| aiProcess_ConvertToLeftHanded;
+
+constexpr uint32_t SKELETON_IMPORT_FLAGS = aiProcess_Triangulate
+	| aiProcess_OptimizeGraph
+	| aiProcess_ConvertToLeftHanded;
+
 void MeshImporter::ImportModel(const std::string& path, MeshData& outMeshData)
 {
 	Assimp::Importer import;
-	const aiScene * scene = import.ReadFile(path,
-		aiProcess_Triangulate
-		| aiProcess_GenSmoothNormals
-		| aiProcess_FlipUVs
-		| aiProcess_CalcTangentSpace
-		| aiProcess_ConvertToLeftHanded);
+	const aiScene * scene = import.ReadFile(path, MODEL_IMPORT_FLAGS);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
@@ -315,16 +345,30 @@ void MeshImporter::ImportModel(const std::string& path, MeshData& outMeshData)
 		return;
 	}
 
-	Utilities::ProcessNodeForModel(scene->mRootNode, scene, outMeshData);
+	ProcessModelScene(scene, outMeshData);
+}
+
+void MeshImporter::ImportModel(const std::vector<uint8_t>& data, const std::string& extension, MeshData& outMeshData)
+{
+	// Assimp needs the extension without the dot to pick the right importer
+	const std::string hint = extension.empty() ? "" : extension.substr(1);
+
+	Assimp::Importer import;
+	const aiScene * scene = import.ReadFileFromMemory(data.data(), data.size(), MODEL_IMPORT_FLAGS, hint.c_str());
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+		return;
+	}
+
+	ProcessModelScene(scene, outMeshData);
 }
 
 void MeshImporter::ImportSkeleton(const std::string& path, SkeletonData& outSkeletonData)
 {
 	Assimp::Importer import;
-	const aiScene * scene = import.ReadFile(path,
-		aiProcess_Triangulate |
-		aiProcess_OptimizeGraph |
-		aiProcess_ConvertToLeftHanded);
+	const aiScene * scene = import.ReadFile(path, SKELETON_IMPORT_FLAGS);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
@@ -332,8 +376,23 @@ void MeshImporter::ImportSkeleton(const std::string& path, SkeletonData& outSkel
 		return;
 	}
 
-	ProcessMeshForSkeleton(scene->mRootNode, scene, outSkeletonData);
-	ReadBoneHierarchyData(scene->mRootNode, outSkeletonData, outSkeletonData.rootBone);
+	ProcessSkeletonScene(scene, outSkeletonData);
+}
+
+void MeshImporter::ImportSkeleton(const std::vector<uint8_t>& data, const std::string& extension, SkeletonData& outSkeletonData)
+{
+	const std::string hint = extension.empty() ? "" : extension.substr(1);
+
+	Assimp::Importer import;
+	const aiScene * scene = import.ReadFileFromMemory(data.data(), data.size(), SKELETON_IMPORT_FLAGS, hint.c_str());
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+		return;
+	}
+
+	ProcessSkeletonScene(scene, outSkeletonData);
 }
 
 bool MeshImporter::ImportAnimation(const std::string& path, const SkeletonData& skeletonData, AnimationData& outAnimationData)
@@ -347,6 +406,81 @@ bool MeshImporter::ImportAnimation(const std::string& path, const SkeletonData&
 		return false;
 	}
 
+	return ProcessAnimationScene(scene, skeletonData, outAnimationData);
+}
+
+bool MeshImporter::ImportAnimation(const std::vector<uint8_t>& data, const std::string& extension, const SkeletonData& skeletonData, AnimationData& outAnimationData)
+{
+	const std::string hint = extension.empty() ? "" : extension.substr(1);
+
+	Assimp::Importer import;
+	const aiScene * scene = import.ReadFileFromMemory(data.data(), data.size(), aiProcess_Triangulate | aiProcess_ConvertToLeftHanded, hint.c_str());
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+		return false;
+	}
+
+	return ProcessAnimationScene(scene, skeletonData, outAnimationData);
+}
+
+void MeshImporter::GatherTextureReferences(const std::string& path, std::vector<std::string>& outTextures)
+{
+	// Only the materials are needed so no post processing
+	Assimp::Importer import;
+	const aiScene * scene = import.ReadFile(path, 0);
+
+	if (!scene || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+		return;
+	}
+
+	for (uint32_t i = 0; i < scene->mNumMaterials; ++i)
+	{
+		const aiMaterial* material = scene->mMaterials[i];
+		for (uint32_t type = aiTextureType_NONE + 1; type <= AI_TEXTURE_TYPE_MAX; ++type)
+		{
+			const aiTextureType textureType = static_cast<aiTextureType>(type);
+			for (uint32_t j = 0; j < material->GetTextureCount(textureType); ++j)
+			{
+				aiString texturePath;
+				if (material->GetTexture(textureType, j, &texturePath) == AI_SUCCESS)
+				{
+					outTextures.push_back(texturePath.C_Str());
+				}
+			}
+		}
+	}
+}
+
+void MeshImporter::ProcessModelScene(const aiScene* scene, MeshData& outMeshData)
+{
+	Utilities::ProcessNodeForModel(scene->mRootNode, scene, outMeshData);
+	MeshOptimization::OptimizeMesh(outMeshData);
+
+	// The static vertex positions are quantized relative to these
+	if (!outMeshData.vertices.empty())
+	{
+		outMeshData.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		outMeshData.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+		for (const Vertex& vertex : outMeshData.vertices)
+		{
+			outMeshData.boundsMin = glm::min(outMeshData.boundsMin, vertex.position);
+			outMeshData.boundsMax = glm::max(outMeshData.boundsMax, vertex.position);
+		}
+	}
+}
+
+void MeshImporter::ProcessSkeletonScene(const aiScene* scene, SkeletonData& outSkeletonData)
+{
+	ProcessMeshForSkeleton(scene->mRootNode, scene, outSkeletonData);
+	ReadBoneHierarchyData(scene->mRootNode, outSkeletonData, outSkeletonData.rootBone);
+}
+
+bool MeshImporter::ProcessAnimationScene(const aiScene* scene, const SkeletonData& skeletonData, AnimationData& outAnimationData)
+{
 	// Only supporting 1 animtion per import
 	if (scene->mNumAnimations > 0)
 	{
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
@@ -15,10 +16,19 @@ class MeshImporter
 {
 public:
 	static void ImportModel(const std::string& path, MeshData& outMeshData);
+	static void ImportModel(const std::vector<uint8_t>& data, const std::string& extension, MeshData& outMeshData);
 	static void ImportSkeleton(const std::string& path, SkeletonData& outSkeletonData);
+	static void ImportSkeleton(const std::vector<uint8_t>& data, const std::string& extension, SkeletonData& outSkeletonData);
 	static bool ImportAnimation(const std::string& path, const SkeletonData& skeletonData, AnimationData& outAnimationData);
+	static bool ImportAnimation(const std::vector<uint8_t>& data, const std::string& extension, const SkeletonData& skeletonData, AnimationData& outAnimationData);
+
+	// File names of the textures referenced by the model's materials, used to record the model's dependencies when cooking
+	static void GatherTextureReferences(const std::string& path, std::vector<std::string>& outTextures);
 
 private:
+	static void ProcessModelScene(const aiScene* scene, MeshData& outMeshData);
+	static void ProcessSkeletonScene(const aiScene* scene, SkeletonData& outSkeletonData);
+	static bool ProcessAnimationScene(const aiScene* scene, const SkeletonData& skeletonData, AnimationData& outAnimationData);
 	static void ProcessMeshForSkeleton(aiNode* node, const aiScene* scene, SkeletonData& skeletonData);
 	static void ReadBoneHierarchyData(aiNode* src, SkeletonData& skeletonData, BoneNode& root);
 };
\ No newline at end of file
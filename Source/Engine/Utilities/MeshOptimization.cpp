@@ -0,0 +1,251 @@
+#include "MeshOptimization.h"
+#include "AssetManager/Model/MeshData.h"
+
+#include <algorithm>
+#include <limits>
+#include <meshoptimizer.h>
+
+namespace
+{
+	uint32_t GetAlignedIndicesSize(uint32_t count, bool use16BitIndices)
+	{
+		// vkCmdBindIndexBuffer needs the offset aligned to the index size, 4 covers both
+		const uint32_t indexSize = use16BitIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+		return (count * indexSize + 3u) & ~3u;
+	}
+}
+
+void MeshOptimization::OptimizeMesh(MeshData& meshData, const MeshLodSettings& lodSettings)
+{
+	std::vector<Vertex> optimizedVertices;
+	optimizedVertices.reserve(meshData.vertices.size());
+
+	std::vector<uint32_t> remap;
+	std::vector<Vertex> weldedVertices;
+
+	for (MeshIndexData& submesh : meshData.meshIndices)
+	{
+		const Vertex* submeshVertices = meshData.vertices.data() + submesh.vertexOffset;
+		const size_t indexCount = submesh.indices.size();
+
+		if (indexCount == 0)
+		{
+			submesh.vertexOffset = static_cast<int32_t>(optimizedVertices.size());
+			submesh.vertexCount = 0;
+			continue;
+		}
+
+		// Weld, the whole Vertex is compared (bones included) and the unreferenced vertices are dropped
+		remap.resize(submesh.vertexCount);
+		const size_t uniqueCount = meshopt_generateVertexRemap(remap.data(), submesh.indices.data(), indexCount, submeshVertices, submesh.vertexCount, sizeof(Vertex));
+
+		weldedVertices.resize(uniqueCount);
+		meshopt_remapIndexBuffer(submesh.indices.data(), submesh.indices.data(), indexCount, remap.data());
+		meshopt_remapVertexBuffer(weldedVertices.data(), submeshVertices, submesh.vertexCount, sizeof(Vertex), remap.data());
+
+		meshopt_optimizeVertexCache(submesh.indices.data(), submesh.indices.data(), indexCount, uniqueCount);
+
+		meshopt_optimizeOverdraw(submesh.indices.data(),
+			submesh.indices.data(),
+			indexCount,
+			&weldedVertices[0].position.x,
+			uniqueCount,
+			sizeof(Vertex),
+			OVERDRAW_THRESHOLD);
+
+		GenerateLods(submesh, weldedVertices, lodSettings);
+
+		// The bounds of skinned meshlets would be wrong as soon as the mesh animates
+		if (!meshData.isSkinned && submesh.count / 3 >= MESHLET_MAX_TRIANGLES * MESHLET_MIN_COUNT)
+		{
+			BuildMeshlets(submesh, weldedVertices);
+		}
+
+		// Fetch remap, the vertices are written in the order the full resolution triangles first use them.
+		// The LODs only collapse onto existing vertices so they are covered by the same remap
+		remap.resize(uniqueCount);
+		const size_t vertexCount = meshopt_optimizeVertexFetchRemap(remap.data(), submesh.indices.data(), indexCount, uniqueCount);
+
+		meshopt_remapIndexBuffer(submesh.indices.data(), submesh.indices.data(), indexCount, remap.data());
+		for (MeshLod& lod : submesh.lods)
+		{
+			meshopt_remapIndexBuffer(lod.indices.data(), lod.indices.data(), lod.count, remap.data());
+		}
+
+		const size_t offset = optimizedVertices.size();
+		optimizedVertices.resize(offset + vertexCount);
+		meshopt_remapVertexBuffer(optimizedVertices.data() + offset, weldedVertices.data(), uniqueCount, sizeof(Vertex), remap.data());
+
+		submesh.vertexOffset = static_cast<int32_t>(offset);
+		submesh.vertexCount = static_cast<uint32_t>(vertexCount);
+	}
+
+	meshData.vertices = std::move(optimizedVertices);
+	meshData.verticesCount = static_cast<int32_t>(meshData.vertices.size());
+
+	ComputeLodErrors(meshData);
+	AssignIndexLayout(meshData);
+}
+
+void MeshOptimization::GenerateLods(MeshIndexData& submesh, const std::vector<Vertex>& vertices, const MeshLodSettings& lodSettings)
+{
+	const float* positions = &vertices[0].position.x;
+
+	// The simplifier reports its error relative to the mesh extents
+	const float errorScale = meshopt_simplifyScale(positions, vertices.size(), sizeof(Vertex));
+
+	size_t previousCount = submesh.count;
+	for (float targetRatio : lodSettings.targetRatios)
+	{
+		const size_t targetCount = static_cast<size_t>(submesh.count * targetRatio) / 3 * 3;
+		if (targetCount < 3)
+		{
+			break;
+		}
+
+		MeshLod lod{};
+		lod.indices.resize(submesh.count);
+
+		// Every LOD starts from the full resolution so the errors don't stack up. The borders are locked
+		// so the seams between the submeshes stay closed
+		float error = 0.0f;
+		const size_t count = meshopt_simplify(lod.indices.data(),
+			submesh.indices.data(),
+			submesh.count,
+			positions,
+			vertices.size(),
+			sizeof(Vertex),
+			targetCount,
+			lodSettings.maxError,
+			meshopt_SimplifyLockBorder,
+			&error);
+
+		// The error bound was hit before the simplifier could remove enough triangles
+		if (count == 0 || count > previousCount * LOD_MIN_REDUCTION)
+		{
+			break;
+		}
+
+		lod.indices.resize(count);
+		lod.count = static_cast<uint32_t>(count);
+		lod.error = error * errorScale;
+
+		meshopt_optimizeVertexCache(lod.indices.data(), lod.indices.data(), count, vertices.size());
+
+		previousCount = count;
+		submesh.lods.emplace_back(std::move(lod));
+	}
+}
+
+void MeshOptimization::BuildMeshlets(MeshIndexData& submesh, const std::vector<Vertex>& vertices)
+{
+	const float* positions = &vertices[0].position.x;
+
+	const size_t maxMeshlets = meshopt_buildMeshletsBound(submesh.count, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+	std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+	std::vector<uint32_t> meshletVertices(maxMeshlets * MESHLET_MAX_VERTICES);
+	std::vector<uint8_t> meshletTriangles(maxMeshlets * MESHLET_MAX_TRIANGLES * 3);
+
+	const size_t meshletCount = meshopt_buildMeshlets(meshlets.data(),
+		meshletVertices.data(),
+		meshletTriangles.data(),
+		submesh.indices.data(),
+		submesh.count,
+		positions,
+		vertices.size(),
+		sizeof(Vertex),
+		MESHLET_MAX_VERTICES,
+		MESHLET_MAX_TRIANGLES,
+		MESHLET_CONE_WEIGHT);
+
+	std::vector<uint32_t> meshletIndices;
+	meshletIndices.reserve(submesh.count);
+
+	const size_t paddedCount = (meshletCount + 3) & ~size_t(3);
+	MeshletBounds& bounds = submesh.meshletBounds;
+	bounds.centerX.assign(paddedCount, 0.0f);
+	bounds.centerY.assign(paddedCount, 0.0f);
+	bounds.centerZ.assign(paddedCount, 0.0f);
+	bounds.radius.assign(paddedCount, 0.0f);
+	bounds.coneAxisX.assign(paddedCount, 0.0f);
+	bounds.coneAxisY.assign(paddedCount, 0.0f);
+	bounds.coneAxisZ.assign(paddedCount, 0.0f);
+	bounds.coneCutoff.assign(paddedCount, 1.0f);
+
+	submesh.meshlets.resize(meshletCount);
+	for (size_t i = 0; i < meshletCount; ++i)
+	{
+		const meshopt_Meshlet& meshlet = meshlets[i];
+
+		// The meshlet triangles index the meshlet's own vertex list, they go back to submesh indices here
+		submesh.meshlets[i].firstIndex = static_cast<uint32_t>(meshletIndices.size());
+		submesh.meshlets[i].indexCount = meshlet.triangle_count * 3;
+		for (uint32_t j = 0; j < meshlet.triangle_count * 3; ++j)
+		{
+			meshletIndices.push_back(meshletVertices[meshlet.vertex_offset + meshletTriangles[meshlet.triangle_offset + j]]);
+		}
+
+		const meshopt_Bounds meshletBounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset],
+			&meshletTriangles[meshlet.triangle_offset],
+			meshlet.triangle_count,
+			positions,
+			vertices.size(),
+			sizeof(Vertex));
+
+		bounds.centerX[i] = meshletBounds.center[0];
+		bounds.centerY[i] = meshletBounds.center[1];
+		bounds.centerZ[i] = meshletBounds.center[2];
+		bounds.radius[i] = meshletBounds.radius;
+		bounds.coneAxisX[i] = meshletBounds.cone_axis[0];
+		bounds.coneAxisY[i] = meshletBounds.cone_axis[1];
+		bounds.coneAxisZ[i] = meshletBounds.cone_axis[2];
+		bounds.coneCutoff[i] = meshletBounds.cone_cutoff;
+	}
+
+	submesh.indices = std::move(meshletIndices);
+}
+
+void MeshOptimization::ComputeLodErrors(MeshData& meshData)
+{
+	size_t lodCount = 1;
+	for (const MeshIndexData& submesh : meshData.meshIndices)
+	{
+		lodCount = std::max(lodCount, submesh.lods.size() + 1);
+	}
+
+	meshData.lodErrors.assign(lodCount, 0.0f);
+	for (size_t lodIndex = 1; lodIndex < lodCount; ++lodIndex)
+	{
+		// The selection expects the errors to only grow with the LOD index
+		float error = meshData.lodErrors[lodIndex - 1];
+		for (const MeshIndexData& submesh : meshData.meshIndices)
+		{
+			if (!submesh.lods.empty())
+			{
+				error = std::max(error, submesh.lods[std::min(lodIndex, submesh.lods.size()) - 1].error);
+			}
+		}
+
+		meshData.lodErrors[lodIndex] = error;
+	}
+}
+
+void MeshOptimization::AssignIndexLayout(MeshData& meshData)
+{
+	uint32_t byteOffset = 0;
+	for (MeshIndexData& submesh : meshData.meshIndices)
+	{
+		submesh.use16BitIndices = submesh.vertexCount <= std::numeric_limits<uint16_t>::max() + 1u;
+
+		submesh.indexByteOffset = byteOffset;
+		byteOffset += GetAlignedIndicesSize(submesh.count, submesh.use16BitIndices);
+
+		for (MeshLod& lod : submesh.lods)
+		{
+			lod.indexByteOffset = byteOffset;
+			byteOffset += GetAlignedIndicesSize(lod.count, submesh.use16BitIndices);
+		}
+	}
+
+	meshData.indexBufferSize = byteOffset;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MeshData;
+struct MeshIndexData;
+struct Vertex;
+
+// Lower the threshold to favor the vertex cache over overdraw, 1.05 allows the cache efficiency to drop by 5%
+constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+// A LOD has to remove at least 15% of the previous LOD's triangles to be kept
+constexpr float LOD_MIN_REDUCTION = 0.85f;
+
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+// Has to be a multiple of 4
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+// How much the meshlet building favors tight normal cones over tight spheres
+constexpr float MESHLET_CONE_WEIGHT = 0.25f;
+// Submeshes smaller than this many meshlets are culled as a whole
+constexpr size_t MESHLET_MIN_COUNT = 4;
+
+struct MeshLodSettings
+{
+	// Fraction of the full resolution triangles each LOD aims for
+	std::vector<float> targetRatios = { 0.5f, 0.25f, 0.125f };
+	// Largest error the simplifier may introduce, relative to the mesh extents
+	float maxError = 0.05f;
+};
+
+/// <summary>
+/// Optimization stage run on every imported model, paid once per load instead of on every frame.
+/// Each submesh is welded, reordered for the post transform cache, then for overdraw, gets its LOD chain
+/// and meshlets and finally its vertices are remapped in first use order for fetch locality.
+/// </summary>
+class MeshOptimization
+{
+public:
+	static void OptimizeMesh(MeshData& meshData, const MeshLodSettings& lodSettings = MeshLodSettings{});
+
+private:
+	// Quadric error simplification of the full resolution indices, one LOD per target ratio until the error bound is hit
+	static void GenerateLods(MeshIndexData& submesh, const std::vector<Vertex>& vertices, const MeshLodSettings& lodSettings);
+	static void ComputeLodErrors(MeshData& meshData);
+
+	// Reorders the full resolution triangles meshlet by meshlet, each meshlet is then a contiguous index range
+	static void BuildMeshlets(MeshIndexData& submesh, const std::vector<Vertex>& vertices);
+
+	// Lays out the index buffer, submeshes with less than 65536 vertices get 16 bit indices
+	static void AssignIndexLayout(MeshData& meshData);
+};
@@ -0,0 +1,133 @@
+#include "VertexPacking.h"
+#include "AssetManager/Animation/BoneData.h"
+#include "AssetManager/Model/MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+void VertexPacking::PackStaticPositions(const MeshData& meshData, std::vector<StaticPosition>& outPositions)
+{
+	const glm::vec3 center = (meshData.boundsMin + meshData.boundsMax) * 0.5f;
+	const glm::vec3 invExtent = 1.0f / GetQuantizationExtent(meshData);
+
+	outPositions.resize(meshData.vertices.size());
+	for (size_t i = 0; i < meshData.vertices.size(); ++i)
+	{
+		const Vertex& vertex = meshData.vertices[i];
+		StaticPosition& packed = outPositions[i];
+
+		const glm::vec3 position = (vertex.position - center) * invExtent;
+		packed.position[0] = static_cast<int16_t>(glm::packSnorm1x16(position.x));
+		packed.position[1] = static_cast<int16_t>(glm::packSnorm1x16(position.y));
+		packed.position[2] = static_cast<int16_t>(glm::packSnorm1x16(position.z));
+		packed.position[3] = static_cast<int16_t>(glm::packSnorm1x16(GetBitangentSign(vertex.normal, vertex.tangent, vertex.biTangent)));
+	}
+}
+
+static_assert(MAX_BONES <= 256, "The skinned vertices store the bone ids on 8 bits");
+
+void VertexPacking::PackSkinnedPositions(const MeshData& meshData, std::vector<SkinnedPosition>& outPositions)
+{
+	outPositions.resize(meshData.vertices.size());
+	for (size_t i = 0; i < meshData.vertices.size(); ++i)
+	{
+		const Vertex& vertex = meshData.vertices[i];
+		SkinnedPosition& packed = outPositions[i];
+
+		packed.position[0] = glm::packHalf1x16(vertex.position.x);
+		packed.position[1] = glm::packHalf1x16(vertex.position.y);
+		packed.position[2] = glm::packHalf1x16(vertex.position.z);
+		packed.position[3] = glm::packHalf1x16(GetBitangentSign(vertex.normal, vertex.tangent, vertex.biTangent));
+
+		// The weights are renormalized after quantization so they still add up to 1
+		int32_t weightSum = 0;
+		int32_t heaviestInfluence = 0;
+		for (int32_t j = 0; j < MAX_BONE_INFLUENCE; ++j)
+		{
+			const bool isUsed = vertex.boneIDs[j] >= 0;
+			packed.boneIDs[j] = isUsed ? static_cast<uint8_t>(vertex.boneIDs[j]) : 0;
+			packed.weights[j] = isUsed ? glm::packUnorm1x8(vertex.weights[j]) : 0;
+
+			weightSum += packed.weights[j];
+			if (packed.weights[j] > packed.weights[heaviestInfluence])
+			{
+				heaviestInfluence = j;
+			}
+		}
+
+		if (weightSum > 0)
+		{
+			packed.weights[heaviestInfluence] = static_cast<uint8_t>(std::clamp(packed.weights[heaviestInfluence] + 255 - weightSum, 0, 255));
+		}
+	}
+}
+
+void VertexPacking::PackAttributes(const MeshData& meshData, std::vector<VertexAttributes>& outAttributes)
+{
+	outAttributes.resize(meshData.vertices.size());
+	for (size_t i = 0; i < meshData.vertices.size(); ++i)
+	{
+		const Vertex& vertex = meshData.vertices[i];
+		VertexAttributes& packed = outAttributes[i];
+
+		PackNormalTangent(vertex.normal, vertex.tangent, packed.normalTangent);
+
+		packed.uv[0] = glm::packHalf1x16(vertex.uv.x);
+		packed.uv[1] = glm::packHalf1x16(vertex.uv.y);
+	}
+}
+
+glm::mat4 VertexPacking::GetDequantizationMatrix(const MeshData& meshData)
+{
+	if (meshData.isSkinned)
+	{
+		return glm::mat4(1.0f);
+	}
+
+	const glm::vec3 center = (meshData.boundsMin + meshData.boundsMax) * 0.5f;
+	return glm::scale(glm::translate(glm::mat4(1.0f), center), GetQuantizationExtent(meshData));
+}
+
+glm::vec2 VertexPacking::EncodeOctahedral(const glm::vec3& direction)
+{
+	const glm::vec3 n = direction / (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z));
+	glm::vec2 encoded = glm::vec2(n.x, n.y);
+
+	// The lower hemisphere is folded over the diagonals
+	if (n.z < 0.0f)
+	{
+		const glm::vec2 signs = glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * signs;
+	}
+
+	return encoded;
+}
+
+void VertexPacking::PackNormalTangent(const glm::vec3& normal, const glm::vec3& tangent, int16_t outNormalTangent[4])
+{
+	// Meshes without normals or tangents get a valid direction instead of NaNs
+	const glm::vec2 encodedNormal = glm::dot(normal, normal) > 0.0f ? EncodeOctahedral(normal) : glm::vec2(0.0f);
+	const glm::vec2 encodedTangent = glm::dot(tangent, tangent) > 0.0f ? EncodeOctahedral(tangent) : glm::vec2(0.0f);
+
+	outNormalTangent[0] = static_cast<int16_t>(glm::packSnorm1x16(encodedNormal.x));
+	outNormalTangent[1] = static_cast<int16_t>(glm::packSnorm1x16(encodedNormal.y));
+	outNormalTangent[2] = static_cast<int16_t>(glm::packSnorm1x16(encodedTangent.x));
+	outNormalTangent[3] = static_cast<int16_t>(glm::packSnorm1x16(encodedTangent.y));
+}
+
+float VertexPacking::GetBitangentSign(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& biTangent)
+{
+	return glm::dot(glm::cross(normal, tangent), biTangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+glm::vec3 VertexPacking::GetQuantizationExtent(const MeshData& meshData)
+{
+	// Flat meshes would divide by 0 on the flat axis
+	const glm::vec3 extent = (meshData.boundsMax - meshData.boundsMin) * 0.5f;
+	return glm::vec3(
+		extent.x > 0.0f ? extent.x : 1.0f,
+		extent.y > 0.0f ? extent.y : 1.0f,
+		extent.z > 0.0f ? extent.z : 1.0f);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct MeshData;
+struct SkinnedPosition;
+struct StaticPosition;
+struct VertexAttributes;
+
+/// <summary>
+/// Converts the imported vertices to the compact layouts uploaded to the GPU. The decoding side lives in the vertex shaders.
+/// </summary>
+class VertexPacking
+{
+public:
+	static void PackStaticPositions(const MeshData& meshData, std::vector<StaticPosition>& outPositions);
+	static void PackSkinnedPositions(const MeshData& meshData, std::vector<SkinnedPosition>& outPositions);
+	static void PackAttributes(const MeshData& meshData, std::vector<VertexAttributes>& outAttributes);
+
+	// Maps the quantized static positions back to mesh space, meant to be multiplied on the right of the model matrix
+	static glm::mat4 GetDequantizationMatrix(const MeshData& meshData);
+
+	// Maps a unit vector to the [-1, 1] square, 2 components instead of 3 with an even error distribution
+	static glm::vec2 EncodeOctahedral(const glm::vec3& direction);
+
+private:
+	static void PackNormalTangent(const glm::vec3& normal, const glm::vec3& tangent, int16_t outNormalTangent[4]);
+	static float GetBitangentSign(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& biTangent);
+	static glm::vec3 GetQuantizationExtent(const MeshData& meshData);
+};
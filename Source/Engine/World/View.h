@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Camera/Camera.h"
+#include "Rendering/Culling/FrustumCulling.h"
+
 #include <entt/entity/registry.hpp>
 
 class AnimationSystem;
@@ -10,9 +12,15 @@ struct View
 {
 	Camera* camera;
 	
+	// Models inside the camera's frustum
 	std::vector<entt::entity> entitiesInView;
 	std::vector<entt::entity> lightsInView;
 
+	// Every model, the shadow casters can be outside the camera's frustum and still cast into it
+	std::vector<entt::entity> shadowCasters;
+	// World bounds of the shadow casters, same order
+	BoundingBoxes casterBounds;
+
 	entt::registry* registry;
 
 	AnimationSystem* animationSystem = nullptr;
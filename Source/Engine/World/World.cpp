@@ -13,13 +13,16 @@
 #include "Engine.h"
 #include "Input/InputSystem.h"
 #include "Rendering/AbstractData.h"
+#include "Rendering/Culling/Frustum.h"
+#include "Rendering/Culling/FrustumCulling.h"
 #include "Rendering/Descriptors/DescriptorInfo.h"
-#include "Rendering/Descriptors/Semantics.h"
 #include "Rendering/Light/Light.h"
 #include "Rendering/RenderingInterface.h"
 #include "TaskManager.h"
+#include "ThreadPool.h"
 #include "View.h"
 
+#include <algorithm>
 #include <SDL3/SDL.h>
 
 void World::Initialize()
@@ -71,15 +74,15 @@ void World::CreateCharacter(const glm::vec3& pos)
 	uint32_t handles[3];
 	assetManager.QueryAssets(handles, "Animations\\Skeleton", "Textures\\PolygonDarkFantasy_Texture_01_B", "Animations\\Pointing");
 
+	// Reads the character and everything it was cooked with in one go instead of one file at a time
+	assetManager.LoadBundle(handles[0]);
+
 	Model* model = assetManager.LoadAsset<Model>(handles[0]);
-	const MeshData& mesh = model->GetMeshData();
 
-	AnimatorComponent anim = animationSystem->CreateAnimator(handles[2], { "Data\\Import\\Animations\\Pointing.fbx" });
+	AnimatorComponent anim = animationSystem->CreateAnimator(handles[2], { handles[2] });
 
-	MaterialDescriptorBindingResource resource{};
-	resource.semantic = Semantics::AlbedoSampler;
-	resource.textureAssetHandle = handles[1];
-	renderingSystem->GetMaterialSystem()->SetTextures(mesh.materials[0].materialInstanceHandle, { resource });
+	// The imported material is shared, editing its textures would retexture every model using it
+	model->SetMaterial(0, renderingSystem->GetMaterialSystem()->CreatePBRMaterial(handles[1]));
 
 	entt::entity hero = registry.create();
 	registry.emplace<Transform>(hero, Transform{ .position = pos, .scale = glm::vec3(0.5f) });
@@ -96,12 +99,17 @@ void World::CreateFloor()
 	assetManager.QueryAssets(handles, "Meshes\\Plane", "Textures\\Floor");
 
 	Model* model = assetManager.LoadAsset<Model>(handles[0]);
-	const MeshData& mesh = model->GetMeshData();
 
-	MaterialDescriptorBindingResource resource{};
-	resource.semantic = Semantics::AlbedoSampler;
-	resource.textureAssetHandle = handles[1];
-	renderingSystem->GetMaterialSystem()->SetTextures(mesh.materials[0].materialInstanceHandle, { resource });
+	// Its own material so the duller shading doesn't leak to other users of the texture
+	MaterialSystem* materialSystem = renderingSystem->GetMaterialSystem();
+	const Material floorMaterial = materialSystem->CreatePBRMaterial(handles[1], true);
+
+	MaterialParameters floorParameters{};
+	floorParameters.specularStrength = 0.1f;
+	floorParameters.shininess = 4.0f;
+	materialSystem->SetParameters(floorMaterial.materialInstanceHandle, floorParameters);
+
+	model->SetMaterial(0, floorMaterial);
 
 	entt::entity hero = registry.create();
 	registry.emplace<Transform>(hero, Transform{
@@ -128,13 +136,57 @@ void World::UnInitialize()
 
 void World::GetWorldView(View* view)
 {
-	auto entitiesInView = registry.view<const Transform, const ModelComponent>();
+	AssetManager& assetManager = AssetManager::Get();
+
+	// The model lookups stay on the main thread, the culling jobs only read what is gathered here
+	std::vector<const Transform*> transforms;
+	std::vector<const MeshData*> meshes;
 
-	entitiesInView.each([&](const auto entity, const Transform& transform, const ModelComponent& model)
+	auto models = registry.view<const Transform, const ModelComponent>();
+	models.each([&](const auto entity, const Transform& transform, const ModelComponent& model)
 		{
-			view->entitiesInView.push_back(entity);
+			view->shadowCasters.push_back(entity);
+			transforms.push_back(&transform);
+			meshes.push_back(&assetManager.LoadAsset<Model>(model.handle)->GetMeshData());
 		});
 
+	const uint32_t modelCount = static_cast<uint32_t>(view->shadowCasters.size());
+	view->casterBounds.Resize(modelCount);
+
+	std::vector<uint8_t> visibility(view->casterBounds.centerX.size());
+	const Frustum frustum = Frustum::FromViewProjection(mainCam.data.projection * mainCam.data.view);
+
+	auto cullChunk = [&](uint32_t chunk)
+		{
+			const uint32_t first = chunk * CULLING_CHUNK_SIZE;
+			const uint32_t count = std::min(CULLING_CHUNK_SIZE, modelCount - first);
+
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				FrustumCulling::ComputeWorldBounds(meshes[i]->boundsMin, meshes[i]->boundsMax, transforms[i]->ComputeModel(), view->casterBounds, i);
+			}
+
+			FrustumCulling::CullBoxes(view->casterBounds, first, count, frustum, visibility.data() + first);
+		};
+
+	const uint32_t chunkCount = (modelCount + CULLING_CHUNK_SIZE - 1) / CULLING_CHUNK_SIZE;
+	if (chunkCount > 1)
+	{
+		ThreadPool::Get().ParallelFor(chunkCount, cullChunk);
+	}
+	else if (chunkCount == 1)
+	{
+		cullChunk(0);
+	}
+
+	for (uint32_t i = 0; i < modelCount; ++i)
+	{
+		if (visibility[i] != 0)
+		{
+			view->entitiesInView.push_back(view->shadowCasters[i]);
+		}
+	}
+
 	auto lightsInView = registry.view<const Light>();
 	lightsInView.each([&](const auto entity, const Light& light)
 		{
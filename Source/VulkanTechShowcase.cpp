@@ -1,12 +1,25 @@
 #pragma once
 
+#include "AssetManager/AssetManager.h"
 #include "Engine.h"
 
 #include <cstdint>
 #include <iostream>
+#include <string>
 
 int32_t main(int32_t argCount, char* argVars[])
 {
+	// Cooking only needs the import folders, no window or renderer
+	if (argCount > 1 && std::string(argVars[1]) == "-cook")
+	{
+		return AssetManager::Get().CookAssetPacks() ? 0 : 1;
+	}
+
+	if (argCount > 1 && std::string(argVars[1]) == "-manifest")
+	{
+		return AssetManager::Get().WriteManifests() ? 0 : 1;
+	}
+
 	Engine engine;
 	if (engine.Initialize())
 	{